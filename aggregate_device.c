@@ -0,0 +1,337 @@
+/*
+ *  aggregate_device.c
+ *  AudioSwitcher
+ *
+ *  MIT License, see license.txt
+ */
+
+#include "aggregate_device.h"
+#include <mach/mach_time.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static UInt32 getAggregateUInt32Property(AudioDeviceID deviceID, AudioObjectPropertySelector selector, AudioObjectPropertyScope scope) {
+    AudioObjectPropertyAddress propertyAddress = {selector, scope, kAudioObjectPropertyElementMain};
+    UInt32 value = 0;
+    UInt32 dataSize = sizeof(value);
+    AudioObjectGetPropertyData(deviceID, &propertyAddress, 0, NULL, &dataSize, &value);
+    return value;
+}
+
+static void setDictionaryString(CFMutableDictionaryRef dictionary, CFStringRef key, const char *value) {
+    CFStringRef string = CFStringCreateWithCString(kCFAllocatorDefault, value, kCFStringEncodingUTF8);
+    CFDictionarySetValue(dictionary, key, string);
+    CFRelease(string);
+}
+
+static void setDictionaryInt(CFMutableDictionaryRef dictionary, CFStringRef key, int value) {
+    CFNumberRef number = CFNumberCreate(kCFAllocatorDefault, kCFNumberIntType, &value);
+    CFDictionarySetValue(dictionary, key, number);
+    CFRelease(number);
+}
+
+static int getDictionaryInt(CFDictionaryRef dictionary, CFStringRef key) {
+    CFNumberRef number = CFDictionaryGetValue(dictionary, key);
+    int value = 0;
+    if (number != NULL) {
+        CFNumberGetValue(number, kCFNumberIntType, &value);
+    }
+    return value;
+}
+
+static bool cfStringEquals(CFStringRef string, const char *value) {
+    char buffer[256];
+    return string != NULL && CFStringGetCString(string, buffer, sizeof(buffer), kCFStringEncodingUTF8) && strcmp(buffer, value) == 0;
+}
+
+// The first sub-device provides the clock; every other one is resampled to
+// follow it.
+static CFDictionaryRef createComposition(const ASAggregateRequest *request, const char *uid, char subUIDs[][256]) {
+    CFMutableDictionaryRef composition = CFDictionaryCreateMutable(kCFAllocatorDefault, 0, &kCFTypeDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks);
+    CFMutableArrayRef subDevices = CFArrayCreateMutable(kCFAllocatorDefault, request->subDeviceCount, &kCFTypeArrayCallBacks);
+
+    setDictionaryString(composition, CFSTR(kAudioAggregateDeviceNameKey), request->name);
+    setDictionaryString(composition, CFSTR(kAudioAggregateDeviceUIDKey), uid);
+    setDictionaryInt(composition, CFSTR(kAudioAggregateDeviceIsPrivateKey), request->isPrivate);
+    setDictionaryInt(composition, CFSTR(kAudioAggregateDeviceIsStackedKey), request->isStacked);
+    setDictionaryString(composition, CFSTR(kAudioAggregateDeviceMainSubDeviceKey), subUIDs[0]);
+
+    for (int i = 0; i < request->subDeviceCount; i++) {
+        CFMutableDictionaryRef subDevice = CFDictionaryCreateMutable(kCFAllocatorDefault, 0, &kCFTypeDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks);
+        setDictionaryString(subDevice, CFSTR(kAudioSubDeviceUIDKey), subUIDs[i]);
+        setDictionaryInt(subDevice, CFSTR(kAudioSubDeviceDriftCompensationKey), i > 0);
+        CFArrayAppendValue(subDevices, subDevice);
+        CFRelease(subDevice);
+    }
+    CFDictionarySetValue(composition, CFSTR(kAudioAggregateDeviceSubDeviceListKey), subDevices);
+    CFRelease(subDevices);
+    return composition;
+}
+
+// Whether an existing aggregate already has the requested sub-devices, in
+// order, with the same clock source and kind.
+static bool matchesComposition(AudioDeviceID aggregateID, const ASAggregateRequest *request, char subUIDs[][256]) {
+    AudioObjectPropertyAddress propertyAddress = {kAudioAggregateDevicePropertyFullSubDeviceList, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain};
+    CFArrayRef subDevices = NULL;
+    CFStringRef mainSubDevice = NULL;
+    CFDictionaryRef composition = NULL;
+    UInt32 dataSize = sizeof(subDevices);
+    bool matches = false;
+
+    if (AudioObjectGetPropertyData(aggregateID, &propertyAddress, 0, NULL, &dataSize, &subDevices) != noErr || subDevices == NULL) {
+        return false;
+    }
+    if (CFArrayGetCount(subDevices) == request->subDeviceCount) {
+        matches = true;
+        for (int i = 0; i < request->subDeviceCount && matches; i++) {
+            matches = cfStringEquals(CFArrayGetValueAtIndex(subDevices, i), subUIDs[i]);
+        }
+    }
+    CFRelease(subDevices);
+
+    propertyAddress.mSelector = kAudioAggregateDevicePropertyMainSubDevice;
+    dataSize = sizeof(mainSubDevice);
+    if (matches && AudioObjectGetPropertyData(aggregateID, &propertyAddress, 0, NULL, &dataSize, &mainSubDevice) == noErr) {
+        matches = cfStringEquals(mainSubDevice, subUIDs[0]);
+        CFRelease(mainSubDevice);
+    }
+
+    propertyAddress.mSelector = kAudioAggregateDevicePropertyComposition;
+    dataSize = sizeof(composition);
+    if (matches && AudioObjectGetPropertyData(aggregateID, &propertyAddress, 0, NULL, &dataSize, &composition) == noErr) {
+        matches = getDictionaryInt(composition, CFSTR(kAudioAggregateDeviceIsStackedKey)) == request->isStacked &&
+                  getDictionaryInt(composition, CFSTR(kAudioAggregateDeviceIsPrivateKey)) == request->isPrivate;
+        CFRelease(composition);
+    }
+    return matches;
+}
+
+// The description of an existing aggregate, in the form
+// AudioHardwareCreateAggregateDevice takes, or NULL when it cannot be read.
+static CFDictionaryRef copyComposition(AudioDeviceID aggregateID) {
+    AudioObjectPropertyAddress propertyAddress = {kAudioAggregateDevicePropertyComposition, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain};
+    CFDictionaryRef composition = NULL;
+    UInt32 dataSize = sizeof(composition);
+
+    if (AudioObjectGetPropertyData(aggregateID, &propertyAddress, 0, NULL, &dataSize, &composition) != noErr) {
+        return NULL;
+    }
+    return composition;
+}
+
+// The HAL builds the aggregate asynchronously; it is usable once all of its
+// sub-devices are active.  The run loop is turned while waiting, as the HAL
+// delivers the changes through it.
+static OSStatus waitForAggregate(AudioDeviceID aggregateID, int subDeviceCount) {
+    AudioObjectPropertyAddress propertyAddress = {kAudioAggregateDevicePropertyActiveSubDeviceList, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain};
+    mach_timebase_info_data_t timebase;
+
+    mach_timebase_info(&timebase);
+    UInt64 deadline = mach_absolute_time() + (UInt64)getSwitchTimeout() * 1000000ULL * timebase.denom / timebase.numer;
+    do {
+        UInt32 dataSize = 0;
+        if (AudioObjectGetPropertyDataSize(aggregateID, &propertyAddress, 0, NULL, &dataSize) == noErr &&
+            dataSize / sizeof(AudioObjectID) >= (UInt32)subDeviceCount) {
+            return noErr;
+        }
+        CFRunLoopRunInMode(kCFRunLoopDefaultMode, 0.001, false);
+    } while (mach_absolute_time() < deadline);
+    return kASPropertyChangeTimeoutError;
+}
+
+// Creates the aggregate, or leaves it alone when one with the same name and
+// composition exists.  A different composition under the same name replaces
+// the old aggregate.  Its UID is taken by the old one until that is gone,
+// so the old composition is kept and created again if the new one is
+// rejected.
+int createAggregateDevice(const ASAggregateRequest *request, ASOutputType outputRequested, AudioDeviceID *aggregateID) {
+    char subUIDs[MAX_AGGREGATE_SUB_DEVICES][256];
+    char uid[256];
+    CFDictionaryRef previous = NULL;
+    const char *state = "created";
+    ASDeviceType subDeviceType = request->isStacked ? kAudioTypeOutput : kAudioTypeAll;
+    OSStatus status;
+
+    if (request->subDeviceCount == 0) {
+        printf("Please specify the devices of the aggregate with --sub.\n");
+        return 1;
+    }
+
+    for (int i = 0; i < request->subDeviceCount; i++) {
+        AudioDeviceID subDeviceID = getRequestedDeviceIDFromUIDSubstring((char *)request->subDevices[i], subDeviceType);
+        if (subDeviceID == kAudioDeviceUnknown) {
+            printf("Could not find an audio device with UID \"%s\" of type %s.  Nothing was changed.\n", request->subDevices[i], deviceTypeName(subDeviceType));
+            return 1;
+        }
+        const char *subUID = getDeviceUID(subDeviceID);
+        strncpy(subUIDs[i], subUID, sizeof(subUIDs[i]) - 1);
+        subUIDs[i][sizeof(subUIDs[i]) - 1] = '\0';
+        if (subUID[0] != '\0') free((void *)subUID);
+
+        for (int j = 0; j < i; j++) {
+            if (strcmp(subUIDs[i], subUIDs[j]) == 0) {
+                printf("\"%s\" and \"%s\" are the same device.  Nothing was changed.\n", request->subDevices[j], request->subDevices[i]);
+                return 1;
+            }
+        }
+    }
+
+    snprintf(uid, sizeof(uid), "%s%s", AGGREGATE_UID_PREFIX, request->name);
+    *aggregateID = getRequestedDeviceIDFromUID(uid, kAudioTypeAll);
+    if (*aggregateID != kAudioDeviceUnknown) {
+        if (matchesComposition(*aggregateID, request, subUIDs)) {
+            showAggregateDevice(*aggregateID, "unchanged", outputRequested);
+            return 0;
+        }
+        previous = copyComposition(*aggregateID);
+        if (previous == NULL) {
+            printf("Could not read the composition of aggregate device \"%s\" to replace it.  Nothing was changed.\n", request->name);
+            return 1;
+        }
+        status = AudioHardwareDestroyAggregateDevice(*aggregateID);
+        if (status != noErr) {
+            printf("Could not replace aggregate device \"%s\". Error: %d (%s)\n", request->name, status, describeStatus(status));
+            CFRelease(previous);
+            return 1;
+        }
+        state = "replaced";
+    }
+
+    CFDictionaryRef composition = createComposition(request, uid, subUIDs);
+    status = AudioHardwareCreateAggregateDevice(composition, aggregateID);
+    CFRelease(composition);
+    if (status != noErr) {
+        printf("Could not create aggregate device \"%s\". Error: %d (%s)\n", request->name, status, describeStatus(status));
+        if (previous != NULL) {
+            AudioDeviceID restoredID;
+            status = AudioHardwareCreateAggregateDevice(previous, &restoredID);
+            if (status == noErr) {
+                printf("The previous aggregate device \"%s\" was restored.\n", request->name);
+            } else {
+                printf("The previous aggregate device \"%s\" could not be restored. Error: %d (%s)\n", request->name, status, describeStatus(status));
+            }
+            CFRelease(previous);
+        }
+        return 1;
+    }
+    if (previous != NULL) {
+        CFRelease(previous);
+    }
+
+    status = waitForAggregate(*aggregateID, request->subDeviceCount);
+    if (status != noErr) {
+        printf("Aggregate device \"%s\" did not become ready within %u ms.\n", request->name, getSwitchTimeout());
+        return 2;
+    }
+    showAggregateDevice(*aggregateID, state, outputRequested);
+    return 0;
+}
+
+// Destroys an aggregate made by --create-aggregate, given by its name, or
+// any aggregate given by its exact UID.  Destroying one that does not exist
+// succeeds, so setups can be torn down unconditionally.
+int destroyAggregateDevice(const char *nameOrUID, ASOutputType outputRequested) {
+    char uid[256];
+    OSStatus status;
+
+    snprintf(uid, sizeof(uid), "%s%s", AGGREGATE_UID_PREFIX, nameOrUID);
+    AudioDeviceID aggregateID = getRequestedDeviceIDFromUID(uid, kAudioTypeAll);
+    if (aggregateID == kAudioDeviceUnknown) {
+        aggregateID = getRequestedDeviceIDFromUID((char *)nameOrUID, kAudioTypeAll);
+    }
+    if (aggregateID != kAudioDeviceUnknown &&
+        getAggregateUInt32Property(aggregateID, kAudioDevicePropertyTransportType, kAudioObjectPropertyScopeGlobal) != kAudioDeviceTransportTypeAggregate) {
+        printf("\"%s\" is not an aggregate device.  Nothing was changed.\n", nameOrUID);
+        return 1;
+    }
+
+    if (aggregateID != kAudioDeviceUnknown) {
+        status = AudioHardwareDestroyAggregateDevice(aggregateID);
+        if (status != noErr) {
+            printf("Could not destroy aggregate device \"%s\". Error: %d (%s)\n", nameOrUID, status, describeStatus(status));
+            return 1;
+        }
+    }
+
+    const char *state = aggregateID != kAudioDeviceUnknown ? "destroyed" : "absent";
+    switch (outputRequested) {
+        case kFormatCLI:
+            printf("%s,,%u,%s\n", nameOrUID, aggregateID, state);
+            break;
+        case kFormatJSON:
+            printf("{\"name\": \"%s\", \"id\": \"%u\", \"state\": \"%s\"}\n", nameOrUID, aggregateID, state);
+            break;
+        default:
+            printf("Aggregate device \"%s\" %s\n", nameOrUID, aggregateID != kAudioDeviceUnknown ? "destroyed" : "does not exist");
+            break;
+    }
+    return 0;
+}
+
+// Reports the aggregate with its clock source and the latency of the
+// combined device, which includes the delays added to line its sub-devices
+// up with the slowest one.
+void showAggregateDevice(AudioDeviceID aggregateID, const char *state, ASOutputType outputRequested) {
+    AudioObjectPropertyAddress propertyAddress = {kAudioAggregateDevicePropertyMainSubDevice, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain};
+    AudioObjectPropertyScope scope = isAnOutputDevice(aggregateID) ? kAudioObjectPropertyScopeOutput : kAudioObjectPropertyScopeInput;
+    CFStringRef clockUID = NULL;
+    char name[256] = "";
+    char clockName[256] = "";
+    Float64 sampleRate = 0.0;
+    UInt32 dataSize = sizeof(clockUID);
+
+    getDeviceName(aggregateID, name);
+    if (AudioObjectGetPropertyData(aggregateID, &propertyAddress, 0, NULL, &dataSize, &clockUID) == noErr && clockUID != NULL) {
+        char clockUIDString[256];
+        if (CFStringGetCString(clockUID, clockUIDString, sizeof(clockUIDString), kCFStringEncodingUTF8)) {
+            getDeviceName(getRequestedDeviceIDFromUID(clockUIDString, kAudioTypeAll), clockName);
+        }
+        CFRelease(clockUID);
+    }
+
+    propertyAddress.mSelector = kAudioAggregateDevicePropertyActiveSubDeviceList;
+    dataSize = 0;
+    AudioObjectGetPropertyDataSize(aggregateID, &propertyAddress, 0, NULL, &dataSize);
+    UInt32 subDeviceCount = dataSize / sizeof(AudioObjectID);
+
+    propertyAddress.mSelector = kAudioDevicePropertyNominalSampleRate;
+    dataSize = sizeof(sampleRate);
+    AudioObjectGetPropertyData(aggregateID, &propertyAddress, 0, NULL, &dataSize, &sampleRate);
+    UInt32 bufferFrames = getAggregateUInt32Property(aggregateID, kAudioDevicePropertyBufferFrameSize, kAudioObjectPropertyScopeGlobal);
+    UInt32 latency = getAggregateUInt32Property(aggregateID, kAudioDevicePropertyLatency, scope);
+    UInt32 safetyOffset = getAggregateUInt32Property(aggregateID, kAudioDevicePropertySafetyOffset, scope);
+    Float64 totalMs = sampleRate > 0.0 ? (bufferFrames + latency + safetyOffset) * 1000.0 / sampleRate : 0.0;
+
+    const char *uid = getDeviceUID(aggregateID);
+    switch (outputRequested) {
+        case kFormatCLI:
+            printf("%s,%s,%u,%s,%u,%s,%.0f,%u,%u,%u,%.2f\n", name, uid, aggregateID, state, subDeviceCount, clockName, sampleRate, bufferFrames, latency, safetyOffset, totalMs);
+            break;
+        case kFormatJSON:
+            printf("{\"name\": \"%s\", \"uid\": \"%s\", \"id\": \"%u\", \"state\": \"%s\", \"sub_devices\": %u, \"clock_device\": \"%s\", \"sample_rate\": %.0f, \"buffer_frames\": %u, \"latency_frames\": %u, \"safety_offset_frames\": %u, \"total_latency_ms\": %.2f}\n", name, uid, aggregateID, state, subDeviceCount, clockName, sampleRate, bufferFrames, latency, safetyOffset, totalMs);
+            break;
+        default:
+            printf("Aggregate device \"%s\" %s: %u devices clocked by \"%s\", %.0f Hz, latency %u frames, safety offset %u frames (%.2f ms)\n", name, state, subDeviceCount, clockName, sampleRate, latency, safetyOffset, totalMs);
+            break;
+    }
+    if (uid[0] != '\0') free((void *)uid);
+    fflush(stdout);
+}
+
+// A private aggregate goes away with the process that made it, so it is
+// kept until this process is interrupted or terminated.
+int holdPrivateAggregate(AudioDeviceID aggregateID) {
+    sigset_t signals;
+    int received;
+
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGHUP);
+    sigprocmask(SIG_BLOCK, &signals, NULL);
+    sigwait(&signals, &received);
+
+    return AudioHardwareDestroyAggregateDevice(aggregateID) == noErr ? 0 : 1;
+}
@@ -0,0 +1,34 @@
+/*
+ *  aggregate_device.h
+ *  AudioSwitcher
+ *
+ *  Building aggregate and multi-output devices from the command line, as
+ *  Audio MIDI Setup does.  Aggregates made here get a UID derived from
+ *  their name, so creating the same configuration again is a no-op and a
+ *  changed one replaces the old device.
+ *
+ *  MIT License, see license.txt
+ */
+
+#ifndef AGGREGATE_DEVICE_H
+#define AGGREGATE_DEVICE_H
+
+#include "audio_switch.h"
+
+#define MAX_AGGREGATE_SUB_DEVICES 16
+#define AGGREGATE_UID_PREFIX "SwitchAudioSource.aggregate."
+
+typedef struct {
+	const char *name;
+	const char *subDevices[MAX_AGGREGATE_SUB_DEVICES];	// UIDs or UID substrings, the first is the clock source
+	int subDeviceCount;
+	bool isPrivate;		// only exists while this process runs
+	bool isStacked;		// multi-output: every sub-device plays the same output
+} ASAggregateRequest;
+
+int createAggregateDevice(const ASAggregateRequest *request, ASOutputType outputRequested, AudioDeviceID *aggregateID);
+int destroyAggregateDevice(const char *nameOrUID, ASOutputType outputRequested);
+void showAggregateDevice(AudioDeviceID aggregateID, const char *state, ASOutputType outputRequested);
+int holdPrivateAggregate(AudioDeviceID aggregateID);
+
+#endif
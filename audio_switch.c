@@ -28,208 +28,271 @@ OTHER DEALINGS IN THE SOFTWARE.
  */
 
 #include "audio_switch.h"
+#include "device_snapshot.h"
+#include "device_shm.h"
+#include "debounced_cycle.h"
+#include "device_top.h"
+#include "device_hog.h"
+#include "aggregate_device.h"
+#include "device_records.h"
+#include "startup_profile.h"
+#include "switch_journal.h"
+#include "device_data_source.h"
+#include "sample_rate_match.h"
+#include "input_meter.h"
+#include "round_trip_latency.h"
+#include "device_name_index.h"
 #include <dns_sd.h>
+#include <dlfcn.h>
 #include <arpa/inet.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <mach/mach_time.h>
 #include <CoreAudio/CoreAudio.h>
+#include <AudioToolbox/AudioServices.h>
 #include <stdio.h>
 #include <string.h>
 
 #define MAX_DEVICES 64
-#define MAX_DEVICE_UID_LENGTH 64
+#define MAX_VOLUME_ELEMENTS 8
+#define VOLUME_RAMP_TICK_NANOS 5000000ULL
+#define MAX_VOLUME_RAMP_MS 60000
+#define PROPERTY_CHANGE_TIMEOUT_MS 2000
+#define MAX_SWITCH_TIMEOUT_MS 60000
+#define MAX_INTERVAL_MS 60000
+#define MAX_PREWARM_HOLD_MS 60000
+#define MAX_RESOLVE_ATTEMPTS 5
+
+static struct option longOptions[] = {
+    {"uid-exact", required_argument, NULL, 'U'},
+    {"ramp", required_argument, NULL, kOptionRamp},
+    {"all-devices", no_argument, NULL, kOptionAllDevices},
+    {"match", required_argument, NULL, kOptionMatch},
+    {"buffer-frames", required_argument, NULL, kOptionBufferFrames},
+    {"sample-rate", required_argument, NULL, kOptionSampleRate},
+    {"tuning", no_argument, NULL, kOptionTuning},
+    {"timeout", required_argument, NULL, kOptionTimeout},
+    {"fields", required_argument, NULL, kOptionFields},
+    {"publish", no_argument, NULL, kOptionPublish},
+    {"shm", no_argument, NULL, kOptionShm},
+    {"record", required_argument, NULL, kOptionRecord},
+    {"replay", required_argument, NULL, kOptionReplay},
+    {"previous", no_argument, NULL, kOptionPrevious},
+    {"debounce", required_argument, NULL, kOptionDebounce},
+    {"preview-hook", required_argument, NULL, kOptionPreviewHook},
+    {"top", no_argument, NULL, kOptionTop},
+    {"interval", required_argument, NULL, kOptionInterval},
+    {"prewarm", optional_argument, NULL, kOptionPrewarm},
+    {"hog", required_argument, NULL, kOptionHog},
+    {"release-hog", no_argument, NULL, kOptionReleaseHog},
+    {"create-aggregate", required_argument, NULL, kOptionCreateAggregate},
+    {"sub", required_argument, NULL, kOptionSubDevice},
+    {"multi-output", no_argument, NULL, kOptionMultiOutput},
+    {"private", no_argument, NULL, kOptionPrivate},
+    {"select", no_argument, NULL, kOptionSelect},
+    {"destroy-aggregate", required_argument, NULL, kOptionDestroyAggregate},
+    {"decode", no_argument, NULL, kOptionDecode},
+    {"startup-profile", no_argument, NULL, kOptionStartupProfile},
+    {"history", no_argument, NULL, kOptionHistory},
+    {"since", required_argument, NULL, kOptionSince},
+    {"data-sources", no_argument, NULL, kOptionDataSources},
+    {"data-source", required_argument, NULL, kOptionDataSource},
+    {"match-rate", optional_argument, NULL, kOptionMatchRate},
+    {"meter", optional_argument, NULL, kOptionMeter},
+    {"measure-latency", no_argument, NULL, kOptionMeasureLatency},
+    {"out", required_argument, NULL, kOptionOutputDevice},
+    {"in", required_argument, NULL, kOptionInputDevice},
+    {"complete", required_argument, NULL, kOptionComplete},
+    {NULL, 0, NULL, 0}
+};
+
+// buffer size and sample rate applied by setOneDevice before switching
+static ASDeviceTuning deviceTuning = {0, 0.0};
+// how long setOneDevice waits for the new default to be reported, and how
+// long the last switch took from the request to that confirmation
+static UInt32 switchTimeoutMs = PROPERTY_CHANGE_TIMEOUT_MS;
+static UInt64 lastSwitchNanos = 0;
+// how long setOneDevice keeps a silent IO running on the new device once it
+// is running (negative to not prewarm), and how long it took to start
+static SInt32 prewarmHoldMs = -1;
+static UInt64 lastPrewarmNanos = 0;
+// whether setOneDevice takes hog mode on the new device before switching
+static bool hogOnSwitch = false;
+
+static UInt64 hostTimeToNanos(UInt64 hostTime, mach_timebase_info_data_t timebase) {
+    return hostTime * timebase.numer / timebase.denom;
+}
+
+static UInt64 nanosToHostTime(UInt64 nanos, mach_timebase_info_data_t timebase) {
+    return nanos * timebase.denom / timebase.numer;
+}
+
+
+static const char *(*macOSStatusErrorString)(OSStatus) = NULL;
+
+static void loadStatusDescriptions(void) {
+    void *coreServices = dlopen("/System/Library/Frameworks/CoreServices.framework/CoreServices", RTLD_LAZY | RTLD_LOCAL);
+    if (coreServices != NULL) {
+        macOSStatusErrorString = (const char *(*)(OSStatus))dlsym(coreServices, "GetMacOSStatusErrorString");
+    }
+}
 
+// Names an error status.  The names come from CoreServices, which is only
+// loaded the first time an error is reported rather than at every launch;
+// without it the status is shown as its four-character code.
+const char * describeStatus(OSStatus status) {
+    static pthread_once_t loadOnce = PTHREAD_ONCE_INIT;
+    static __thread char fourCharCode[8];
+
+    pthread_once(&loadOnce, loadStatusDescriptions);
+    if (macOSStatusErrorString != NULL) {
+        const char *name = macOSStatusErrorString(status);
+        if (name != NULL && name[0] != '\0') return name;
+    }
+    for (int i = 0; i < 4; i++) {
+        char c = (char)((UInt32)status >> (24 - 8 * i));
+        fourCharCode[i] = (c >= 0x20 && c < 0x7f) ? c : '?';
+    }
+    fourCharCode[4] = '\0';
+    return fourCharCode;
+}
 
 void showUsage(const char * appName) {
-    printf("Usage: %s [-a] [-c] [-t type] [-n] -s device_name | -i device_id | -u device_uid\n"
+    printf("Usage: %s [-a] [-c] [-t type] [-n] -s device_name | -i device_id | -u device_uid | -U device_uid\n"
            "  -a             : shows all devices\n"
-           "  -c             : shows current device\n\n"
-           "  -f format      : output format (cli/human/json). Defaults to human.\n"
+           "  -c             : shows current device\n"
+           "  --shm          : with -c, reads the device published by --publish instead of asking the system\n"
+           "  --publish      : keeps running, publishing the current devices to shared memory for --shm readers\n\n"
+           "  --top          : continuously shows the IO cycle usage, buffer size and overloads of every device (all types unless -t is given)\n"
+           "  --interval ms  : with --top, the refresh interval, at most 60000.  Defaults to 1000.  With --meter, defaults to 100.\n"
+           "  --meter[=s]    : shows the peak and rms level of every channel of the input device given with\n"
+           "                   -s/-i/-u/-U, or the current one, each --interval, for s seconds (at most 86400) or until interrupted.\n"
+           "                   Does not switch to the device.\n"
+           "  --measure-latency : plays a short noise burst on the output and records it on the input to measure\n"
+           "                   the round trip latency, and compares it with the latency the devices report\n"
+           "  --out device   : with --measure-latency, the output device by name or uid.  Defaults to the current one.\n"
+           "  --in device    : with --measure-latency, the input device by name or uid.  Defaults to the current one.\n"
+           "  -f format      : output format (cli/human/json/binary/msgpack). Defaults to human.\n"
+           "                   binary and msgpack apply to -a and -c, and leave out AirPlay receivers.\n"
+           "  --decode       : reads binary (or with -f msgpack, msgpack) records from stdin and prints them as json\n"
+           "  --fields list  : with -a, the comma separated attributes to show (name,type,id,uid,transport,\n"
+           "                   input_channels,output_channels,sample_rate,latency,alive,running,hidden,\n"
+           "                   aggregate,data_source,hog_owner,data_sources or all).  Defaults to name,type,id,uid.\n"
+           "  --complete prefix : prints the names of devices of the type given with -t that start with prefix,\n"
+           "                   one per line, for shell completion.  With --fields uid, their uids instead.\n"
+           "                   Answered from a cached index without asking the audio system when it is fresh.\n"
+           "  --startup-profile : reports time to main, to the first audio system call and in total on stderr\n"
+           "  --history      : shows the switches, cycles and mutes made by any SwitchAudioSource, oldest first.\n"
+           "                   Filtered by -t, --match text (process, device uid or operation) and --since time\n"
+           "                   (seconds, or with a unit: 15m, 2h, 1d).\n"
+           "  --record file  : records every query made to the audio system into a trace file\n"
+           "  --replay file  : answers queries from a recorded trace instead of the audio system\n"
            "  -t type        : device type (input/output/system/all).  Defaults to output.\n"
            "  -m mute        : sets the mute status (mute/unmute/toggle).  For input/output only.\n"
+           "  --all-devices  : with -m, applies the mute status to every device of the given type\n"
+           "  --match name   : with --all-devices, only devices whose name contains the given text\n"
+           "  -v level       : shows (get) or sets (0.0-1.0) the volume of the current device.  For input/output only.\n"
+           "  --ramp ms      : with -v, fades to the new volume over the given number of milliseconds\n"
+           "  --buffer-frames n : when switching, sets the I/O buffer size of the new device in frames\n"
+           "  --sample-rate hz  : when switching, sets the nominal sample rate of the new device\n"
+           "  --tuning       : shows sample rate, buffer size and latency of the current device\n"
+           "  --match-rate[=hz] : after switching, and while --publish, --top or --hog keep running, sets the default\n"
+           "                   input and output to a common sample rate: hz when both support it, otherwise the\n"
+           "                   highest one they share.  On its own, matches the current defaults.\n"
+           "  --data-sources : shows the data sources (ports) of the current device, such as speakers and headphones\n"
+           "  --data-source name : selects the data source with the given name on the device given with -s/-i/-u/-U\n"
+           "                   (switching to it) or the current device\n"
+           "  --prewarm[=ms] : when switching, starts the new device and waits until it is running, optionally\n"
+           "                   keeping it running silently for ms more, at most 60000\n"
+           "  --hog self     : hogs the device given with -s/-i/-u/-U (switching to it) or the current device,\n"
+           "                   so no other process can use it, until this process is interrupted\n"
+           "  --release-hog  : releases hog mode taken with --hog on the given or current device\n"
+           "  --create-aggregate name : creates (or updates) an aggregate device of the devices given with --sub\n"
+           "  --sub uid      : with --create-aggregate, a device by uid or a substring of the uid.  Repeat for each\n"
+           "                   device; the first one is the clock source, the others are drift corrected.\n"
+           "  --multi-output : with --create-aggregate, creates a multi-output device instead\n"
+           "  --private      : with --create-aggregate, the device only exists until this process is interrupted\n"
+           "  --select       : with --create-aggregate, also makes the new device the default of the given type\n"
+           "  --destroy-aggregate name : destroys an aggregate device made with --create-aggregate, or given by uid\n"
+           "  --timeout ms   : how long to wait for a switch to be confirmed, at most 60000.  Defaults to 2000.\n"
            "  -n             : cycles the audio device to the next one\n"
+           "  --previous     : cycles the audio device to the previous one\n"
+           "  --debounce ms  : with -n/--previous, presses within ms (at most 10000) of each other add up and only the final device is switched to\n"
+           "  --preview-hook cmd : with --debounce, runs cmd with the type and name of the pending device after each press\n"
            "  -i device_id   : sets the audio device to the given device by id\n"
            "  -u device_uid  : sets the audio device to the given device by uid or a substring of the uid\n"
+           "  -U device_uid  : sets the audio device to the given device by its exact uid (also --uid-exact)\n"
            "  -s device_name : sets the audio device to the given device by name\n\n",appName);
 }
 
-AudioDeviceID getAirPlayDeviceIDWithName(const char *deviceUIDPrefix) {
-    AudioObjectPropertyAddress propertyAddress = {
-        kAudioHardwarePropertyDevices,
-        kAudioObjectPropertyScopeGlobal,
-        kAudioObjectPropertyElementMaster
-    };
-
-    UInt32 dataSize = 0;
-    OSStatus status = AudioObjectGetPropertyDataSize(kAudioObjectSystemObject, &propertyAddress, 0, NULL, &dataSize);
-    if (status != noErr) return kAudioDeviceUnknown;
-
-    UInt32 deviceCount = dataSize / sizeof(AudioDeviceID);
-    AudioDeviceID deviceIDs[deviceCount];
-    status = AudioObjectGetPropertyData(kAudioObjectSystemObject, &propertyAddress, 0, NULL, &dataSize, deviceIDs);
-    if (status != noErr) return kAudioDeviceUnknown;
-
-    AudioDeviceID targetDeviceID = kAudioDeviceUnknown;
-    for (UInt32 i = 0; i < deviceCount; i++) {
-        CFStringRef deviceUIDRef = NULL;
-        dataSize = sizeof(deviceUIDRef);
-        propertyAddress.mSelector = kAudioDevicePropertyDeviceUID;
-        status = AudioObjectGetPropertyData(deviceIDs[i], &propertyAddress, 0, NULL, &dataSize, &deviceUIDRef);
-        if (status == noErr) {
-            if (CFStringFind(deviceUIDRef, CFStringCreateWithCString(kCFAllocatorDefault, deviceUIDPrefix, kCFStringEncodingUTF8), 0).location != kCFNotFound) {
-                targetDeviceID = deviceIDs[i];
-                CFRelease(deviceUIDRef);
-                break;
-            }
-            CFRelease(deviceUIDRef);
-        }
+// The device named by --out or --in, by name or else by exact uid, or the
+// current one of the type when none was given.
+static AudioDeviceID getLatencyDevice(char *requested, ASDeviceType typeRequested) {
+    if (requested == NULL) {
+        return getCurrentlySelectedDeviceID(typeRequested);
     }
-
-    return targetDeviceID;
-}
-
-AudioDeviceID getAirPlayDeviceIDWithDeviceId(const char *deviceId) {
-    AudioDeviceID deviceIDs[MAX_DEVICES];
-    UInt32 dataSize = sizeof(deviceIDs);
-    AudioObjectPropertyAddress propertyAddress = {
-        kAudioHardwarePropertyDevices,
-        kAudioObjectPropertyScopeGlobal,
-        kAudioObjectPropertyElementMaster
-    };
-
-    OSStatus status = AudioObjectGetPropertyData(kAudioObjectSystemObject, &propertyAddress, 0, NULL, &dataSize, deviceIDs);
-    if (status != noErr) {
-        printf("Error getting audio device IDs: %d\n", status);
-        return kAudioDeviceUnknown;
+    AudioDeviceID deviceID = getRequestedDeviceID(requested, typeRequested);
+    if (deviceID == kAudioDeviceUnknown) {
+        deviceID = getRequestedDeviceIDFromUID(requested, typeRequested);
     }
-
-    int deviceCount = dataSize / sizeof(AudioDeviceID);
-
-    for (int i = 0; i < deviceCount; i++) {
-        CFStringRef deviceUID;
-        dataSize = sizeof(deviceUID);
-        propertyAddress.mSelector = kAudioDevicePropertyDeviceUID;
-        status = AudioObjectGetPropertyData(deviceIDs[i], &propertyAddress, 0, NULL, &dataSize, &deviceUID);
-        if (status != noErr) {
-            printf("Error getting device UID for device %d: %d\n", i, status);
-            continue;
-        }
-
-        char deviceUIDCString[MAX_DEVICE_UID_LENGTH];
-        CFStringGetCString(deviceUID, deviceUIDCString, sizeof(deviceUIDCString), kCFStringEncodingUTF8);
-        CFRelease(deviceUID);
-
-        // Check if the device supports AirPlay output
-        UInt32 transportType;
-        dataSize = sizeof(transportType);
-        propertyAddress.mSelector = kAudioDevicePropertyTransportType;
-        status = AudioObjectGetPropertyData(deviceIDs[i], &propertyAddress, 0, NULL, &dataSize, &transportType);
-        if (status != noErr) {
-            printf("Error getting transport type for device %d: %d\n", i, status);
-            continue;
-        }
-
-        if (transportType == kAudioDeviceTransportTypeAirPlay && strcmp(deviceUIDCString, deviceId) == 0) {
-            return deviceIDs[i];
-        }
+    if (deviceID == kAudioDeviceUnknown) {
+        printf("Could not find an audio device named \"%s\" of type %s.\n", requested, deviceTypeName(typeRequested));
     }
-
-    return kAudioDeviceUnknown;
+    return deviceID;
 }
 
+// Reads a whole number of at most maximum that is all of text, as the
+// numeric options take.
+static bool parseWholeNumber(const char *text, unsigned long maximum, unsigned long *value) {
+    char *end;
 
-
-// 设置AirPlay设备为输出设备，传入deviceId
-OSStatus setOutputDeviceToAirPlayWithDeviceId(const char *deviceId) {
-    AudioDeviceID targetDeviceID = getAirPlayDeviceIDWithDeviceId(deviceId);
-    if (targetDeviceID == kAudioDeviceUnknown) {
-        printf("AirPlay device with ID %s not found.\n", deviceId);
-        return kAudioHardwareBadDeviceError;
-    }
-
-    AudioObjectPropertyAddress propertyAddress = {
-        kAudioHardwarePropertyDefaultOutputDevice,
-        kAudioObjectPropertyScopeGlobal,
-        kAudioObjectPropertyElementMaster
-    };
-
-    UInt32 dataSize = sizeof(targetDeviceID);
-    OSStatus status = AudioObjectSetPropertyData(kAudioObjectSystemObject, &propertyAddress, 0, NULL, dataSize, &targetDeviceID);
-    if (status != noErr) {
-        printf("Error setting output device to AirPlay: %d\n", status);
-    } else {
-        printf("Output device set to device with ID %s\n", deviceId);
-    }
-
-    return status;
+    if (text[0] < '0' || text[0] > '9') return false;
+    *value = strtoul(text, &end, 10);
+    return *end == '\0' && *value <= maximum;
 }
 
-
 int runAudioSwitch(int argc, const char * argv[]) {
-	AudioObjectPropertyAddress addr;
-	UInt32 propsize;
-
-	// target all available audio devices
-	addr.mSelector = kAudioHardwarePropertyDevices;
-	addr.mScope = kAudioObjectPropertyScopeWildcard;
-	addr.mElement = kAudioObjectPropertyElementWildcard;
-
-	// get size of available data
-	AudioObjectGetPropertyDataSize(kAudioObjectSystemObject, &addr, 0, NULL, &propsize);
-
-	int nDevices = propsize / sizeof(AudioDeviceID);
-	AudioDeviceID *devids = malloc(propsize);
-
-	// get actual device id array data
-	AudioObjectGetPropertyData(kAudioObjectSystemObject, &addr, 0, NULL, &propsize, devids);
-
-	// target device transport type property
-	addr.mSelector = kAudioDevicePropertyTransportType;
-	addr.mScope = kAudioObjectPropertyScopeGlobal;
-	addr.mElement = kAudioObjectPropertyElementMaster;
-
-	unsigned int transportType = 0;
-	propsize = sizeof(transportType);
-	for (int i=0; i<nDevices; i++) {
-	  AudioObjectGetPropertyData(devids[i], &addr, 0, NULL, &propsize, &transportType);
-
-
-	  printf("%u %u\n", kAudioDeviceTransportTypeAirPlay, transportType);
-
-	  if (kAudioDeviceTransportTypeAirPlay == transportType) {
-	      // Found AirPlay audio device
-	      // ugh so  we don't reach here until i actually go and click to connect to airplay
-	      // apple can list the device but we won't see it here until it's ... discovered
-	      // this is why you can see it via listAirPlayDevices
-	      // but not connect to it...
-	      printf("id: %d\n", devids[i]);
-	  }
-	}
-
-	free(devids);
-
-	// https://joris.kluivers.nl/blog/2012/07/25/per-application-airplay-in-mountain-lion/
-	// https://stackoverflow.com/questions/14020222/the-way-to-find-out-if-airplay-audio-device-is-in-use-password-protected-by-cor
-	// https://openairplay.github.io/airplay-spec/service_discovery.html
-	// https://openairplay.github.io/airplay-spec/audio/rtsp_requests/announce.html
-
-	return 0;
-
-
     char requestedDeviceName[256];
-    char printableDeviceName[256];
-    int requestedDeviceID;
     char requestedDeviceUID[256];
+    // room for a whole UID after its label
+    char printableDeviceName[sizeof("Device with UID: ") + sizeof(requestedDeviceUID)];
+    int requestedDeviceID;
     AudioDeviceID chosenDeviceID = kAudioDeviceUnknown;
     ASDeviceType typeRequested = kAudioTypeUnknown;
     ASOutputType outputRequested = kFormatHuman;
     ASMuteType muteRequested = kToggleMute;
+    Float32 volumeRequested = -1.0;
+    UInt32 rampMs = 0;
+    bool allDevices = false;
+    bool useSharedState = false;
+    UInt32 debounceMs = 0;
+    UInt32 intervalMs = 0;
+    bool meterRequested = false;
+    UInt32 meterSeconds = 0;
+    UInt32 sinceSeconds = 0;
+    const char *previewHook = NULL;
+    const char *dataSourceRequested = NULL;
+    char *latencyOutputName = NULL;
+    char *latencyInputName = NULL;
+    const char *completePrefix = NULL;
+    bool hogRequested = false;
+    ASAggregateRequest aggregateRequest;
+    bool selectAggregate = false;
+    bool releaseHog = false;
+    UInt32 fieldsRequested = kDefaultDeviceFields;
+    ASDeviceTuning tuningRequested = {0, 0.0};
+    char namePattern[256] = "";
     int function = 0;
     int result = 0;
 
+    memset(&aggregateRequest, 0, sizeof(aggregateRequest));
+
     int c;
-    while ((c = getopt(argc, (char **)argv, "hacm:nt:f:i:u:s:")) != -1) {
+    while ((c = getopt_long(argc, (char **)argv, "hacm:v:nt:f:i:u:U:s:", longOptions, NULL)) != -1) {
         switch (c) {
             case 'f':
                 // format
@@ -239,6 +302,10 @@ int runAudioSwitch(int argc, const char * argv[]) {
                     outputRequested = kFormatJSON;
                 } else if (strcmp(optarg, "human") == 0) {
                     outputRequested = kFormatHuman;
+                } else if (strcmp(optarg, "binary") == 0) {
+                    outputRequested = kFormatBinary;
+                } else if (strcmp(optarg, "msgpack") == 0) {
+                    outputRequested = kFormatMsgPack;
                 } else {
                     printf("Unknown format %s\n", optarg);
                     showUsage(argv[0]);
@@ -276,6 +343,260 @@ int runAudioSwitch(int argc, const char * argv[]) {
                 }
                 break;
 
+            case 'v':
+                // get or set the volume of the interface selected with -t
+                function = kFunctionVolume;
+                if (strcmp(optarg, "get") != 0) {
+                    char *end;
+                    volumeRequested = strtof(optarg, &end);
+                    if (*end != '\0' || volumeRequested < 0.0 || volumeRequested > 1.0) {
+                        printf("Invalid volume \"%s\" specified.\n", optarg);
+                        showUsage(argv[0]);
+                        return 1;
+                    }
+                }
+                break;
+
+            case kOptionRamp: {
+                // ramp duration for volume changes
+                char *end;
+                unsigned long ramp = strtoul(optarg, &end, 10);
+                if (optarg[0] < '0' || optarg[0] > '9' || *end != '\0' || ramp > MAX_VOLUME_RAMP_MS) {
+                    printf("Invalid ramp \"%s\" specified.  Give it in milliseconds, at most %d.\n", optarg, MAX_VOLUME_RAMP_MS);
+                    return 1;
+                }
+                rampMs = (UInt32)ramp;
+                break;
+            }
+
+            case kOptionAllDevices:
+                // mute every matching device instead of the current one
+                allDevices = true;
+                break;
+
+            case kOptionMatch:
+                // restrict --all-devices to names containing the pattern
+                allDevices = true;
+                strncpy(namePattern, optarg, sizeof(namePattern) - 1);
+                break;
+
+            case kOptionBufferFrames:
+                tuningRequested.bufferFrames = (UInt32)strtoul(optarg, NULL, 10);
+                if (tuningRequested.bufferFrames == 0) {
+                    printf("Invalid buffer size \"%s\" specified.\n", optarg);
+                    return 1;
+                }
+                break;
+
+            case kOptionSampleRate:
+                tuningRequested.sampleRate = strtod(optarg, NULL);
+                if (tuningRequested.sampleRate <= 0.0) {
+                    printf("Invalid sample rate \"%s\" specified.\n", optarg);
+                    return 1;
+                }
+                break;
+
+            case kOptionTuning:
+                // show buffer size, sample rate and latency of the current device
+                function = kFunctionShowTuning;
+                break;
+
+            case kOptionFields:
+                fieldsRequested = parseDeviceFields(optarg);
+                if (fieldsRequested == 0) {
+                    printf("Invalid field list \"%s\" specified.\n", optarg);
+                    showUsage(argv[0]);
+                    return 1;
+                }
+                break;
+
+            case kOptionPublish:
+                function = kFunctionPublish;
+                break;
+
+            case kOptionShm:
+                useSharedState = true;
+                break;
+
+            case kOptionRecord:
+                if (startHALTrace(optarg, kHALTraceRecord) != 0) return 1;
+                break;
+
+            case kOptionReplay:
+                if (startHALTrace(optarg, kHALTraceReplay) != 0) return 1;
+                break;
+
+            case kOptionPrevious:
+                function = kFunctionCyclePrevious;
+                break;
+
+            case kOptionDebounce: {
+                unsigned long debounce;
+                if (!parseWholeNumber(optarg, MAX_DEBOUNCE_MS, &debounce)) {
+                    printf("Invalid debounce \"%s\" specified.  Give it in milliseconds, at most %d.\n", optarg, MAX_DEBOUNCE_MS);
+                    return 1;
+                }
+                debounceMs = (UInt32)debounce;
+                break;
+            }
+
+            case kOptionPreviewHook:
+                previewHook = optarg;
+                break;
+
+            case kOptionTop:
+                function = kFunctionTop;
+                break;
+
+            case kOptionInterval: {
+                unsigned long interval;
+                if (!parseWholeNumber(optarg, MAX_INTERVAL_MS, &interval) || interval == 0) {
+                    printf("Invalid interval \"%s\" specified.  Give it in milliseconds, from 1 to %d.\n", optarg, MAX_INTERVAL_MS);
+                    return 1;
+                }
+                intervalMs = (UInt32)interval;
+                break;
+            }
+
+            case kOptionPrewarm: {
+                unsigned long hold = 0;
+                if (optarg && !parseWholeNumber(optarg, MAX_PREWARM_HOLD_MS, &hold)) {
+                    printf("Invalid prewarm time \"%s\" specified.  Give it in milliseconds, at most %d.\n", optarg, MAX_PREWARM_HOLD_MS);
+                    return 1;
+                }
+                setPrewarm((SInt32)hold);
+                break;
+            }
+
+            case kOptionMeter: {
+                // without a duration it runs until interrupted
+                unsigned long seconds = 0;
+                if (optarg && (!parseWholeNumber(optarg, MAX_METER_SECONDS, &seconds) || seconds == 0)) {
+                    printf("Invalid meter duration \"%s\" specified.  Give it in seconds, from 1 to %d.\n", optarg, MAX_METER_SECONDS);
+                    return 1;
+                }
+                meterRequested = true;
+                meterSeconds = (UInt32)seconds;
+                break;
+            }
+
+            case kOptionMeasureLatency:
+                function = kFunctionMeasureLatency;
+                break;
+
+            case kOptionOutputDevice:
+                latencyOutputName = optarg;
+                break;
+
+            case kOptionInputDevice:
+                latencyInputName = optarg;
+                break;
+
+            case kOptionComplete:
+                function = kFunctionComplete;
+                completePrefix = optarg;
+                break;
+
+            case kOptionMatchRate:
+                if (optarg && strtod(optarg, NULL) <= 0.0) {
+                    printf("Invalid sample rate \"%s\" specified.\n", optarg);
+                    return 1;
+                }
+                setRateMatching(true, optarg ? strtod(optarg, NULL) : 0.0);
+                break;
+
+            case kOptionHog:
+                hogRequested = parseHogTarget(optarg);
+                if (!hogRequested) {
+                    printf("Hog mode can only be held by the process that takes it, which locks every other process out; use --hog self and keep it running for as long as the device should stay hogged.\n");
+                    return 1;
+                }
+                break;
+
+            case kOptionReleaseHog:
+                releaseHog = true;
+                break;
+
+            case kOptionCreateAggregate:
+                function = kFunctionCreateAggregate;
+                aggregateRequest.name = optarg;
+                break;
+
+            case kOptionSubDevice:
+                if (aggregateRequest.subDeviceCount == MAX_AGGREGATE_SUB_DEVICES) {
+                    printf("At most %d devices can be aggregated.\n", MAX_AGGREGATE_SUB_DEVICES);
+                    return 1;
+                }
+                aggregateRequest.subDevices[aggregateRequest.subDeviceCount++] = optarg;
+                break;
+
+            case kOptionMultiOutput:
+                aggregateRequest.isStacked = true;
+                break;
+
+            case kOptionPrivate:
+                aggregateRequest.isPrivate = true;
+                break;
+
+            case kOptionSelect:
+                selectAggregate = true;
+                break;
+
+            case kOptionDestroyAggregate:
+                function = kFunctionDestroyAggregate;
+                aggregateRequest.name = optarg;
+                break;
+
+            case kOptionDecode:
+                function = kFunctionDecode;
+                break;
+
+            case kOptionStartupProfile:
+                startStartupProfile();
+                break;
+
+            case kOptionHistory:
+                function = kFunctionHistory;
+                break;
+
+            case kOptionSince: {
+                // seconds, or a number of minutes, hours or days: 90, 15m, 2h, 1d
+                char *end;
+                unsigned long since = strtoul(optarg, &end, 10);
+                unsigned long unit = 1;
+                switch (*end) {
+                    case 'm': unit = 60; end++; break;
+                    case 'h': unit = 3600; end++; break;
+                    case 'd': unit = 86400; end++; break;
+                    case 's': end++; break;
+                    default: break;
+                }
+                if (optarg[0] < '0' || optarg[0] > '9' || *end != '\0' || since == 0 || since > 0xffffffffUL / unit) {
+                    printf("Invalid time \"%s\" specified.  Give it in seconds, or with a unit, as in 15m, 2h or 1d.\n", optarg);
+                    return 1;
+                }
+                sinceSeconds = (UInt32)(since * unit);
+                break;
+            }
+
+            case kOptionDataSources:
+                function = kFunctionShowDataSources;
+                break;
+
+            case kOptionDataSource:
+                dataSourceRequested = optarg;
+                break;
+
+            case kOptionTimeout: {
+                unsigned long timeout;
+                if (!parseWholeNumber(optarg, MAX_SWITCH_TIMEOUT_MS, &timeout) || timeout == 0) {
+                    printf("Invalid timeout \"%s\" specified.  Give it in milliseconds, from 1 to %d.\n", optarg, MAX_SWITCH_TIMEOUT_MS);
+                    return 1;
+                }
+                setSwitchTimeout((UInt32)timeout);
+                break;
+            }
+
             case 'n':
                 // cycle to the next audio device
                 function = kFunctionCycleNext;
@@ -293,6 +614,13 @@ int runAudioSwitch(int argc, const char * argv[]) {
                 strcpy(requestedDeviceUID, optarg);
                 break;
 
+            case 'U':
+                // set the requestedDeviceUID, matched exactly
+                function = kFunctionSetDeviceByExactUID;
+                strncpy(requestedDeviceUID, optarg, sizeof(requestedDeviceUID) - 1);
+                requestedDeviceUID[sizeof(requestedDeviceUID) - 1] = '\0';
+                break;
+
             case 's':
                 // set the requestedDeviceName
                 function = kFunctionSetDeviceByName;
@@ -318,21 +646,20 @@ int runAudioSwitch(int argc, const char * argv[]) {
         }
     }
 
+    setStartupProfileFormat(outputRequested);
+
+    if (function == kFunctionComplete) {
+        return showCompletions(completePrefix, typeRequested, fieldsRequested == kFieldUID);
+    }
+
     if (function == kFunctionShowAll) {
-        switch(typeRequested) {
-            case kAudioTypeInput:
-            case kAudioTypeOutput:
-                showAllDevices(typeRequested, outputRequested);
-                break;
-            case kAudioTypeSystemOutput:
-                showAllDevices(kAudioTypeOutput, outputRequested);
-                setOutputDeviceToAirPlayWithDeviceId("D4A33D6F8BDC");
-                break;
-            default:
-                showAllDevices(kAudioTypeInput, outputRequested);
-                showAllDevices(kAudioTypeOutput, outputRequested);
-        }
-        return 0;
+        return showAllDevices(typeRequested == kAudioTypeSystemOutput ? kAudioTypeOutput : typeRequested, outputRequested, fieldsRequested);
+    }
+    if (function == kFunctionHistory) {
+        return showHistory(typeRequested, namePattern, sinceSeconds, outputRequested);
+    }
+    if (function == kFunctionDecode) {
+        return decodeRecords(stdin, outputRequested == kFormatMsgPack ? kFormatMsgPack : kFormatBinary);
     }
     if (function == kFunctionShowHelp) {
         showUsage(argv[0]);
@@ -340,17 +667,92 @@ int runAudioSwitch(int argc, const char * argv[]) {
     }
     if (function == kFunctionShowCurrent) {
         if (typeRequested == kAudioTypeUnknown) typeRequested = kAudioTypeOutput;
-        showCurrentlySelectedDeviceID(typeRequested, outputRequested);
-        return 0;
+        // fall back to asking the system when no publisher is running
+        if (useSharedState && showSharedCurrentDevice(typeRequested, outputRequested) == 0) {
+            return 0;
+        }
+        return showCurrentlySelectedDeviceID(typeRequested, outputRequested);
+    }
+    if (function == kFunctionPublish) {
+        watchDefaultSampleRates(outputRequested);
+        return publishDeviceState();
+    }
+    if (function == kFunctionTop) {
+        watchDefaultSampleRates(outputRequested);
+        return showDeviceTop(typeRequested, outputRequested, intervalMs);
     }
 
+    // the meter listens, so it resolves among input devices
+    if (meterRequested && typeRequested == kAudioTypeUnknown) typeRequested = kAudioTypeInput;
     if (typeRequested == kAudioTypeUnknown) typeRequested = kAudioTypeOutput;
 
-    if (function == kFunctionCycleNext) {
-        result = cycleNext(typeRequested);
+    if (function == kFunctionShowTuning) {
+        if (typeRequested == kAudioTypeAll) {
+            showDeviceTuning(getCurrentlySelectedDeviceID(kAudioTypeInput), kAudioTypeInput, outputRequested);
+            typeRequested = kAudioTypeOutput;
+        }
+        showDeviceTuning(getCurrentlySelectedDeviceID(typeRequested), typeRequested, outputRequested);
+        return 0;
+    }
+
+    if (function == kFunctionShowDataSources) {
+        if (typeRequested == kAudioTypeAll) {
+            showDataSources(getCurrentlySelectedDeviceID(kAudioTypeInput), kAudioTypeInput, outputRequested);
+            typeRequested = kAudioTypeOutput;
+        }
+        showDataSources(getCurrentlySelectedDeviceID(typeRequested), typeRequested, outputRequested);
+        return 0;
+    }
+
+    if (function == kFunctionMeasureLatency) {
+        AudioDeviceID outputID = getLatencyDevice(latencyOutputName, kAudioTypeOutput);
+        AudioDeviceID inputID = getLatencyDevice(latencyInputName, kAudioTypeInput);
+        if (outputID == kAudioDeviceUnknown || inputID == kAudioDeviceUnknown) {
+            return 1;
+        }
+        return measureRoundTripLatency(outputID, inputID, outputRequested);
+    }
+
+    setDeviceTuning(tuningRequested);
+
+    if (function == kFunctionDestroyAggregate) {
+        return destroyAggregateDevice(aggregateRequest.name, outputRequested);
+    }
+    if (function == kFunctionCreateAggregate) {
+        AudioDeviceID aggregateID = kAudioDeviceUnknown;
+        result = createAggregateDevice(&aggregateRequest, outputRequested, &aggregateID);
+        if (result == 0 && selectAggregate) {
+            if (typeRequested == kAudioTypeAll) typeRequested = kAudioTypeOutput;
+            result = setDevice(aggregateID, typeRequested);
+            if (result == 0) {
+                showSwitchResult(aggregateID, typeRequested, aggregateRequest.name, outputRequested);
+            }
+            result = matchRatesAfterSwitch(result, outputRequested);
+        }
+        if (result == 0 && aggregateRequest.isPrivate) {
+            watchDefaultSampleRates(outputRequested);
+            result = holdPrivateAggregate(aggregateID);
+        }
         return result;
     }
 
+    if (function == kFunctionCycleNext || function == kFunctionCyclePrevious) {
+        setJournalOperation(kJournalCycle);
+    }
+    if (function == kFunctionCycleNext && debounceMs == 0) {
+        result = cycleNext(typeRequested, outputRequested);
+        return matchRatesAfterSwitch(result, outputRequested);
+    }
+    if (function == kFunctionCycleNext || function == kFunctionCyclePrevious) {
+        return matchRatesAfterSwitch(cycleDebounced(typeRequested, function == kFunctionCycleNext ? 1 : -1, debounceMs, previewHook, outputRequested), outputRequested);
+    }
+
+    // anything resolved from here on is checked against device list changes
+    // before and after it is written
+    UInt64 resolvedGeneration = trackDeviceListGeneration();
+    ASDeviceResolver resolver = NULL;
+    char *resolverQuery = NULL;
+
     if (function == kFunctionSetDeviceByID) {
         chosenDeviceID = (AudioDeviceID)requestedDeviceID;
         sprintf(printableDeviceName, "Device with ID: %d", chosenDeviceID);
@@ -364,6 +766,8 @@ int runAudioSwitch(int argc, const char * argv[]) {
             return 1;
         }
         strcpy(printableDeviceName, requestedDeviceName);
+        resolver = getRequestedDeviceID;
+        resolverQuery = requestedDeviceName;
     }
 
     if (function == kFunctionSetDeviceByUID) {
@@ -374,6 +778,54 @@ int runAudioSwitch(int argc, const char * argv[]) {
             return 1;
         }
         sprintf(printableDeviceName, "Device with UID: %s", getDeviceUID(chosenDeviceID));
+        resolver = getRequestedDeviceIDFromUIDSubstring;
+        resolverQuery = requestedDeviceUID;
+    }
+
+    if (function == kFunctionSetDeviceByExactUID) {
+        chosenDeviceID = getRequestedDeviceIDFromUID(requestedDeviceUID, typeRequested);
+        if (chosenDeviceID == kAudioDeviceUnknown) {
+            printf("Could not find an audio device with UID \"%s\" of type %s.  Nothing was changed.\n", requestedDeviceUID, deviceTypeName(typeRequested));
+            return 1;
+        }
+        snprintf(printableDeviceName, sizeof(printableDeviceName), "Device with UID: %s", requestedDeviceUID);
+        resolver = getRequestedDeviceIDFromUID;
+        resolverQuery = requestedDeviceUID;
+    }
+
+    if (meterRequested) {
+        if (typeRequested != kAudioTypeInput) {
+            printf("Only input devices can be metered; use -t input.\n");
+            return 1;
+        }
+        if (chosenDeviceID == kAudioDeviceUnknown) chosenDeviceID = getCurrentlySelectedDeviceID(kAudioTypeInput);
+        return showInputMeter(chosenDeviceID, meterSeconds, intervalMs, outputRequested);
+    }
+
+    if ((hogRequested || releaseHog) && typeRequested == kAudioTypeAll) {
+        printf("Hog mode applies to a single device; specify -t input, output or system.\n");
+        return 1;
+    }
+    if (releaseHog) {
+        if (chosenDeviceID == kAudioDeviceUnknown) chosenDeviceID = getCurrentlySelectedDeviceID(typeRequested);
+        return releaseDeviceHog(chosenDeviceID, outputRequested);
+    }
+    if (dataSourceRequested != NULL && typeRequested == kAudioTypeAll) {
+        printf("Data sources belong to a single device; specify -t input, output or system.\n");
+        return 1;
+    }
+    if (dataSourceRequested != NULL && function == 0) {
+        result = setDeviceDataSource(getCurrentlySelectedDeviceID(typeRequested), typeRequested, dataSourceRequested, outputRequested);
+        if (result != 0 || !hogRequested) {
+            return result;
+        }
+    }
+    if (isRateMatching() && function == 0 && !hogRequested) {
+        return matchDefaultSampleRates(outputRequested);
+    }
+    if (hogRequested && function == 0) {
+        watchDefaultSampleRates(outputRequested);
+        return holdDeviceHog(getCurrentlySelectedDeviceID(typeRequested), outputRequested);
     }
 
     if (function == kFunctionMute) {
@@ -381,24 +833,32 @@ int runAudioSwitch(int argc, const char * argv[]) {
         bool anyStatusError = false;
         if (typeRequested == kAudioTypeUnknown) typeRequested = kAudioTypeInput;
 
+        if (allDevices) {
+            if (typeRequested == kAudioTypeSystemOutput) {
+                printf("audio device \"%s\" may not be muted\n", deviceTypeName(typeRequested));
+                return 1;
+            }
+            return setMuteForAllDevices(typeRequested, muteRequested, namePattern, outputRequested);
+        }
+
         switch(typeRequested) {
             case kAudioTypeInput:
             case kAudioTypeOutput:
                 status = setMute(typeRequested, muteRequested);
                 if(status != noErr) {
-                    printf("Failed setting mute state. Error: %d (%s)", status, GetMacOSStatusErrorString(status));
+                    printf("Failed setting mute state. Error: %d (%s)", status, describeStatus(status));
                     return 1;
                 }
                 break;
             case kAudioTypeAll:
                 status = setMute(kAudioTypeInput, muteRequested);
                 if(status != noErr) {
-                    printf("Failed setting mute state for input. Error: %d (%s)", status, GetMacOSStatusErrorString(status));
+                    printf("Failed setting mute state for input. Error: %d (%s)", status, describeStatus(status));
                     anyStatusError = true;
                 }
                 status = setMute(kAudioTypeOutput, muteRequested);
                 if(status != noErr) {
-                    printf("Failed setting mute state for output. Error: %d (%s)", status, GetMacOSStatusErrorString(status));
+                    printf("Failed setting mute state for output. Error: %d (%s)", status, describeStatus(status));
                     anyStatusError = true;
                 }
                 if (anyStatusError) {
@@ -413,10 +873,40 @@ int runAudioSwitch(int argc, const char * argv[]) {
         return 0;
     }
 
+    if (function == kFunctionVolume) {
+        OSStatus status;
+        bool anyStatusError = false;
+        ASDeviceType types[2] = {typeRequested, kAudioTypeUnknown};
+
+        if (typeRequested == kAudioTypeSystemOutput) {
+            printf("audio device \"%s\" does not have a volume control\n", deviceTypeName(typeRequested));
+            return 1;
+        }
+        if (typeRequested == kAudioTypeAll) {
+            types[0] = kAudioTypeInput;
+            types[1] = kAudioTypeOutput;
+        }
+
+        for (int i = 0; i < 2 && types[i] != kAudioTypeUnknown; i++) {
+            if (volumeRequested < 0.0) {
+                if (showVolume(types[i], outputRequested) != noErr) {
+                    anyStatusError = true;
+                }
+                continue;
+            }
+            status = setVolume(types[i], volumeRequested, rampMs);
+            if (status != noErr) {
+                printf("Failed setting %s volume. Error: %d (%s)\n", deviceTypeName(types[i]), status, describeStatus(status));
+                anyStatusError = true;
+            }
+        }
+        return anyStatusError ? 1 : 0;
+    }
+
 
     if (typeRequested == kAudioTypeAll && function == kFunctionSetDeviceByName) {
         // special case for all - process each one separately
-        result = setAllDevicesByName(requestedDeviceName);
+        result = matchRatesAfterSwitch(setAllDevicesByName(requestedDeviceName, outputRequested), outputRequested);
     } else {
         // require a chose
         if (!chosenDeviceID) {
@@ -426,8 +916,28 @@ int runAudioSwitch(int argc, const char * argv[]) {
         }
 
         // choose the requested audio device
-        result = setDevice(chosenDeviceID, typeRequested);
-        printf("%s audio device set to \"%s\"\n", deviceTypeName(typeRequested), printableDeviceName);
+        setHogOnSwitch(hogRequested);
+        result = setResolvedDevice(&chosenDeviceID, typeRequested, resolver, resolverQuery, resolvedGeneration);
+        if (result != 0) {
+            return result;
+        }
+        showSwitchResult(chosenDeviceID, typeRequested, printableDeviceName, outputRequested);
+
+        if (dataSourceRequested != NULL) {
+            result = setDeviceDataSource(chosenDeviceID, typeRequested, dataSourceRequested, outputRequested);
+            if (result != 0) {
+                return result;
+            }
+        }
+        if (result == 0 && (tuningRequested.bufferFrames || tuningRequested.sampleRate > 0.0)) {
+            showDeviceTuning(chosenDeviceID, typeRequested, outputRequested);
+        }
+        result = matchRatesAfterSwitch(result, outputRequested);
+        if (result == 0 && hogRequested) {
+            // already hogged by setOneDevice, this keeps it
+            watchDefaultSampleRates(outputRequested);
+            result = holdDeviceHog(chosenDeviceID, outputRequested);
+        }
     }
 
 
@@ -468,40 +978,38 @@ const char * getDeviceUID(AudioDeviceID deviceID) {
     return "";
 }
 
-AudioDeviceID getRequestedDeviceIDFromUIDSubstring(char * requestedDeviceUID, ASDeviceType typeRequested) {
+bool isDeviceOfType(AudioDeviceID deviceID, ASDeviceType typeRequested) {
+    switch(typeRequested) {
+        case kAudioTypeInput:
+            return isAnInputDevice(deviceID);
+        case kAudioTypeOutput:
+            return isAnOutputDevice(deviceID);
+        case kAudioTypeSystemOutput:
+            return getDeviceType(deviceID) == kAudioTypeOutput;
+        default:
+            return true;
+    }
+}
+
+// Scans every device of the requested type, matching its UID either
+// exactly or as a substring.  UIDs are compared as UTF-8.
+static AudioDeviceID findDeviceByUID(const char * requestedDeviceUID, ASDeviceType typeRequested, bool exact) {
     AudioObjectPropertyAddress propertyAddress = {kAudioHardwarePropertyDevices, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMaster};
-    UInt32 propertySize;
-    AudioDeviceID dev_array[64];
-    int numberOfDevices = 0;
+    AudioDeviceID dev_array[MAX_DEVICES];
+    UInt32 propertySize = sizeof(dev_array);
 
-    AudioObjectGetPropertyDataSize(kAudioObjectSystemObject, &propertyAddress, 0, NULL, &propertySize);
-    AudioObjectGetPropertyData(kAudioObjectSystemObject, &propertyAddress, 0, NULL, &propertySize, dev_array);
-    numberOfDevices = (propertySize / sizeof(AudioDeviceID));
+    if (AudioObjectGetPropertyData(kAudioObjectSystemObject, &propertyAddress, 0, NULL, &propertySize, dev_array) != noErr) {
+        return kAudioDeviceUnknown;
+    }
+    int numberOfDevices = (propertySize / sizeof(AudioDeviceID));
 
     for(int i = 0; i < numberOfDevices; ++i) {
-        switch(typeRequested) {
-            case kAudioTypeInput:
-                if (!isAnInputDevice(dev_array[i])) continue;
-                break;
-
-            case kAudioTypeOutput:
-                if (!isAnOutputDevice(dev_array[i])) continue;
-                break;
-
-            case kAudioTypeSystemOutput:
-                if (getDeviceType(dev_array[i]) != kAudioTypeOutput) continue;
-                break;
-            default: break;
-        }
+        if (!isDeviceOfType(dev_array[i], typeRequested)) continue;
 
-        char deviceUID[256];
-        propertyAddress.mSelector = kAudioDevicePropertyDeviceUID;
-        propertyAddress.mScope = kAudioObjectPropertyScopeGlobal;
-        propertyAddress.mElement = dev_array[i];
-        propertySize = sizeof(deviceUID);
-        AudioObjectGetPropertyData(dev_array[i], &propertyAddress, 0, NULL, &propertySize, &deviceUID);
-
-        if (strstr(deviceUID, requestedDeviceUID) != NULL) {
+        const char *deviceUID = getDeviceUID(dev_array[i]);
+        bool matched = exact ? strcmp(deviceUID, requestedDeviceUID) == 0 : strstr(deviceUID, requestedDeviceUID) != NULL;
+        if (deviceUID[0] != '\0') free((void *)deviceUID);
+        if (matched) {
             return dev_array[i];
         }
     }
@@ -509,6 +1017,33 @@ AudioDeviceID getRequestedDeviceIDFromUIDSubstring(char * requestedDeviceUID, AS
     return kAudioDeviceUnknown;
 }
 
+AudioDeviceID getRequestedDeviceIDFromUIDSubstring(char * requestedDeviceUID, ASDeviceType typeRequested) {
+    return findDeviceByUID(requestedDeviceUID, typeRequested, false);
+}
+
+// Resolves an exact UID with a single kAudioHardwarePropertyTranslateUIDToDevice
+// query, falling back to a scan on systems that do not support it.
+AudioDeviceID getRequestedDeviceIDFromUID(char * requestedDeviceUID, ASDeviceType typeRequested) {
+    AudioObjectPropertyAddress propertyAddress = {kAudioHardwarePropertyTranslateUIDToDevice, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain};
+    AudioDeviceID deviceID = kAudioDeviceUnknown;
+    UInt32 dataSize = sizeof(deviceID);
+
+    CFStringRef uid = CFStringCreateWithCString(kCFAllocatorDefault, requestedDeviceUID, kCFStringEncodingUTF8);
+    if (uid == NULL) {
+        return kAudioDeviceUnknown;
+    }
+    OSStatus status = AudioObjectGetPropertyData(kAudioObjectSystemObject, &propertyAddress, sizeof(uid), &uid, &dataSize, &deviceID);
+    CFRelease(uid);
+
+    if (status == kAudioHardwareUnknownPropertyError) {
+        return findDeviceByUID(requestedDeviceUID, typeRequested, true);
+    }
+    if (status != noErr || deviceID == kAudioDeviceUnknown || !isDeviceOfType(deviceID, typeRequested)) {
+        return kAudioDeviceUnknown;
+    }
+    return deviceID;
+}
+
 AudioDeviceID getCurrentlySelectedDeviceID(ASDeviceType typeRequested) {
     AudioObjectPropertyAddress address;
     address.mSelector = kAudioHardwarePropertyDefaultOutputDevice;
@@ -587,7 +1122,7 @@ bool isAnOutputDevice(AudioDeviceID deviceID) {
 bool isAnInputDevice(AudioDeviceID deviceID) {
     AudioObjectPropertyAddress propertyAddress = {kAudioDevicePropertyStreams, kAudioDevicePropertyScopeInput, kAudioObjectPropertyElementMaster};
     UInt32 dataSize = 0;
-    OSStatus result = AudioObjectGetPropertyDataSize(deviceID, &propertyAddress, sizeof(AudioClassDescription), kAudioDevicePropertyScopeInput, &dataSize);
+    OSStatus result = AudioObjectGetPropertyDataSize(deviceID, &propertyAddress, 0, NULL, &dataSize);
     if (result == noErr && dataSize > 0) {
         return kAudioTypeInput;
     }
@@ -605,7 +1140,7 @@ char *deviceTypeName(ASDeviceType device_type) {
 
 }
 
-void showCurrentlySelectedDeviceID(ASDeviceType typeRequested, ASOutputType outputRequested) {
+int showCurrentlySelectedDeviceID(ASDeviceType typeRequested, ASOutputType outputRequested) {
     AudioDeviceID currentDeviceID = kAudioDeviceUnknown;
     char currentDeviceName[256];
 
@@ -622,9 +1157,26 @@ void showCurrentlySelectedDeviceID(ASDeviceType typeRequested, ASOutputType outp
         case kFormatJSON:
             printf("{\"name\": \"%s\", \"type\": \"%s\", \"id\": \"%u\", \"uid\": \"%s\"}\n",currentDeviceName,deviceTypeName(typeRequested),currentDeviceID,getDeviceUID(currentDeviceID));
             break;
+        case kFormatBinary:
+        case kFormatMsgPack: {
+            ASDeviceInfo info;
+            ASRecordWriter writer;
+            const char *uid = getDeviceUID(currentDeviceID);
+
+            memset(&info, 0, sizeof(info));
+            info.deviceID = currentDeviceID;
+            snprintf(info.name, sizeof(info.name), "%s", currentDeviceName);
+            snprintf(info.uid, sizeof(info.uid), "%s", uid);
+            if (uid[0] != '\0') free((void *)uid);
+
+            initRecordWriter(&writer, outputRequested);
+            writeDeviceRecord(&writer, kRecordCurrent, &info, kDefaultDeviceFields, typeRequested);
+            return flushRecordWriter(&writer);
+        }
         default:
             break;
     }
+    return 0;
 }
 
 AudioDeviceID getRequestedDeviceID(char * requestedDeviceName, ASDeviceType typeRequested) {
@@ -676,95 +1228,448 @@ AudioDeviceID getRequestedDeviceID(char * requestedDeviceName, ASDeviceType type
     return kAudioDeviceUnknown;
 }
 
-AudioDeviceID getNextDeviceID(AudioDeviceID currentDeviceID, ASDeviceType typeRequested) {
-    AudioObjectPropertyAddress addr;
-    AudioDeviceID dev_array[64];
-    int numberOfDevices = 0;
-    AudioDeviceID first_dev = kAudioDeviceUnknown;
-    int found = -1;
+AudioDeviceID getNextDeviceID(AudioDeviceID currentDeviceID, ASDeviceType typeRequested) {
+    AudioObjectPropertyAddress addr;
+    AudioDeviceID dev_array[64];
+    int numberOfDevices = 0;
+    AudioDeviceID first_dev = kAudioDeviceUnknown;
+    int found = -1;
+
+    addr.mSelector = kAudioHardwarePropertyDevices;
+    addr.mScope = kAudioObjectPropertyScopeGlobal;
+    addr.mElement = kAudioObjectPropertyElementMaster;
+    UInt32 propertySize = 0;
+    OSStatus err = AudioObjectGetPropertyDataSize(kAudioObjectSystemObject, &addr, 0, NULL, &propertySize);
+    if (err != noErr) {
+        return kAudioDeviceUnknown;
+    }
+
+    err = AudioObjectGetPropertyData(kAudioObjectSystemObject, &addr, 0, NULL, &propertySize, dev_array);
+    if (err != noErr) {
+        return kAudioDeviceUnknown;
+    }
+    numberOfDevices = (propertySize / sizeof(AudioDeviceID));
+
+    for(int i = 0; i < numberOfDevices; ++i) {
+        switch(typeRequested) {
+            case kAudioTypeInput:
+                if (!isAnInputDevice(dev_array[i])) continue;
+                break;
+
+            case kAudioTypeOutput:
+                if (!isAnOutputDevice(dev_array[i])) continue;
+                break;
+
+            case kAudioTypeSystemOutput:
+                if (getDeviceType(dev_array[i]) != kAudioTypeOutput) continue;
+                break;
+
+            default:
+                break;
+        }
+
+        if (first_dev == kAudioDeviceUnknown) {
+            first_dev = dev_array[i];
+        }
+        if (found >= 0) {
+            return dev_array[i];
+        }
+        if (dev_array[i] == currentDeviceID) {
+            found = i;
+        }
+    }
+
+    return first_dev;
+}
+
+int setDevice(AudioDeviceID newDeviceID, ASDeviceType typeRequested) {
+    return setOneDevice(newDeviceID, typeRequested);
+}
+
+// Switches to a device resolved while the device list was at
+// resolvedGeneration.  If the list changes before or during the write, the
+// device may have gone or been replaced, so it is resolved again from the
+// query and written again, up to MAX_RESOLVE_ATTEMPTS times.  The HAL can
+// deliver the list notification after the write returns, so the list itself
+// is read back once the write is done and the device must still be in it.
+// Devices given by id (no resolver) are written once.
+int setResolvedDevice(AudioDeviceID *chosenDeviceID, ASDeviceType typeRequested, ASDeviceResolver resolver, char * query, UInt64 resolvedGeneration) {
+    int result = 1;
+
+    for (int attempt = 1; ; attempt++) {
+        UInt64 generation = getDeviceListGeneration();
+        if (generation == resolvedGeneration || resolver == NULL) {
+            result = setDevice(*chosenDeviceID, typeRequested);
+            if (resolver == NULL || (getDeviceListGeneration() == generation && isDeviceListed(*chosenDeviceID))) {
+                return result;
+            }
+        }
+
+        if (attempt >= MAX_RESOLVE_ATTEMPTS) {
+            printf("The %s device list kept changing while switching.  Gave up after %d attempts.\n", deviceTypeName(typeRequested), attempt);
+            return result != 0 ? result : 1;
+        }
+
+        resolvedGeneration = getDeviceListGeneration();
+        *chosenDeviceID = resolver(query, typeRequested);
+        if (*chosenDeviceID == kAudioDeviceUnknown) {
+            printf("The requested %s device disappeared while switching.\n", deviceTypeName(typeRequested));
+            return 1;
+        }
+    }
+}
+
+int setOneDevice(AudioDeviceID newDeviceID, ASDeviceType typeRequested) {
+    AudioObjectPropertyAddress addr;
+    UInt32 propertySize = sizeof(UInt32);
+    OSStatus status;
+
+    addr.mScope = kAudioObjectPropertyScopeGlobal;
+    addr.mElement = kAudioObjectPropertyElementMaster;
+
+    switch(typeRequested) {
+        case kAudioTypeInput:
+            addr.mSelector = kAudioHardwarePropertyDefaultInputDevice;
+            break;
+        case kAudioTypeOutput:
+            addr.mSelector = kAudioHardwarePropertyDefaultOutputDevice;
+            break;
+        case kAudioTypeSystemOutput:
+            addr.mSelector = kAudioHardwarePropertyDefaultSystemOutputDevice;
+            break;
+        default:
+            addr.mSelector = kAudioHardwarePropertyDefaultOutputDevice;
+            break;
+    }
+
+    // configure the device before it becomes the default, so nothing plays
+    // through it in the old configuration and a rejected setting leaves the
+    // previous default in place
+    status = applyDeviceTuning(newDeviceID, deviceTuning);
+    if (status != noErr) {
+        printf("Could not configure %s device %u. Error: %d (%s).  Nothing was changed.\n", deviceTypeName(typeRequested), newDeviceID, status, describeStatus(status));
+        return 1;
+    }
+    // likewise hog it first, so no other process starts IO on it once it is
+    // the default
+    if (hogOnSwitch) {
+        status = claimDeviceHog(newDeviceID);
+        if (status != noErr) {
+            printf("Could not hog %s device %u (held by process %d). Error: %d (%s).  Nothing was changed.\n", deviceTypeName(typeRequested), newDeviceID, getDeviceHogOwner(newDeviceID), status, describeStatus(status));
+            return 1;
+        }
+    }
+
+    AudioDeviceID previousDeviceID = getCurrentlySelectedDeviceID(typeRequested);
+    status = setPropertyAndWait(kAudioObjectSystemObject, &addr, propertySize, &newDeviceID, switchTimeoutMs, &lastSwitchNanos);
+    journalSwitch(typeRequested, previousDeviceID, newDeviceID, status, lastSwitchNanos);
+
+    if (status != noErr && hogOnSwitch) {
+        releaseOwnDeviceHog(newDeviceID);
+    }
+    if (status == kASPropertyChangeTimeoutError) {
+        printf("Switching %s device to %u was not confirmed within %u ms.\n", deviceTypeName(typeRequested), newDeviceID, switchTimeoutMs);
+        return 2;
+    }
+    if (status != noErr) {
+        printf("Failed to set %s device. Error: %d (%s)\n", deviceTypeName(typeRequested), status, describeStatus(status));
+        return 1;
+    }
+    noteDefaultDeviceSwitched(typeRequested);
+
+    if (prewarmHoldMs >= 0) {
+        status = prewarmDevice(newDeviceID, (UInt32)prewarmHoldMs, &lastPrewarmNanos);
+        if (status != noErr) {
+            printf("The %s device did not start running. Error: %d (%s)\n", deviceTypeName(typeRequested), status, describeStatus(status));
+            return status == kASPropertyChangeTimeoutError ? 2 : 1;
+        }
+    }
+
+    return 0;
+}
+
+void setPrewarm(SInt32 holdMs) {
+    prewarmHoldMs = holdMs;
+}
+
+typedef struct {
+    UInt64 startTime;
+    volatile UInt64 firstCycleTime;
+} ASPrewarmState;
+
+static OSStatus prewarmIOProc(AudioObjectID deviceID, const AudioTimeStamp *now, const AudioBufferList *inputData, const AudioTimeStamp *inputTime, AudioBufferList *outputData, const AudioTimeStamp *outputTime, void *clientData) {
+    ASPrewarmState *state = (ASPrewarmState *)clientData;
+
+    if (outputData != NULL) {
+        for (UInt32 i = 0; i < outputData->mNumberBuffers; i++) {
+            memset(outputData->mBuffers[i].mData, 0, outputData->mBuffers[i].mDataByteSize);
+        }
+    }
+    if (state->firstCycleTime == 0) {
+        __atomic_store_n(&state->firstCycleTime, mach_absolute_time(), __ATOMIC_RELEASE);
+    }
+    return noErr;
+}
+
+// Starts IO on the device with a proc that renders silence and waits for its
+// first cycle, which is when a sleeping USB or Bluetooth device has actually
+// woken up.  The IO is kept running for holdMs more, so the first sound of
+// the next app is not clipped, then stopped.
+OSStatus prewarmDevice(AudioDeviceID deviceID, UInt32 holdMs, UInt64 *readyNanos) {
+    ASPrewarmState state = {0, 0};
+    AudioDeviceIOProcID procID = NULL;
+    mach_timebase_info_data_t timebase;
+    OSStatus status;
+
+    mach_timebase_info(&timebase);
+    status = AudioDeviceCreateIOProcID(deviceID, prewarmIOProc, &state, &procID);
+    if (status != noErr) {
+        return status;
+    }
+
+    state.startTime = mach_absolute_time();
+    status = AudioDeviceStart(deviceID, procID);
+    if (status == noErr) {
+        UInt64 deadline = state.startTime + nanosToHostTime((UInt64)switchTimeoutMs * 1000000ULL, timebase);
+        while (__atomic_load_n(&state.firstCycleTime, __ATOMIC_ACQUIRE) == 0 && mach_absolute_time() < deadline) {
+            usleep(500);
+        }
+
+        UInt64 firstCycleTime = __atomic_load_n(&state.firstCycleTime, __ATOMIC_ACQUIRE);
+        if (firstCycleTime == 0) {
+            status = kASPropertyChangeTimeoutError;
+        } else {
+            *readyNanos = hostTimeToNanos(firstCycleTime - state.startTime, timebase);
+            if (holdMs > 0) {
+                usleep(holdMs * 1000);
+            }
+        }
+        AudioDeviceStop(deviceID, procID);
+    }
+
+    AudioDeviceDestroyIOProcID(deviceID, procID);
+    return status;
+}
+
+void setSwitchTimeout(UInt32 timeoutMs) {
+    switchTimeoutMs = timeoutMs;
+}
+
+UInt32 getSwitchTimeout(void) {
+    return switchTimeoutMs;
+}
+
+void setHogOnSwitch(bool hog) {
+    hogOnSwitch = hog;
+}
+
+UInt64 getLastSwitchNanos(void) {
+    return lastSwitchNanos;
+}
+
+// Reports a completed switch.  The human format keeps the traditional
+// message; cli and json add the measured request-to-confirmation time.
+void showSwitchResult(AudioDeviceID deviceID, ASDeviceType typeRequested, const char * printableDeviceName, ASOutputType outputRequested) {
+    double confirmedMs = getLastSwitchNanos() / 1000000.0;
+    double readyMs = lastPrewarmNanos / 1000000.0;
+    bool prewarmed = prewarmHoldMs >= 0;
+
+    switch(outputRequested) {
+        case kFormatCLI:
+            printf("%s,%s,%u,%.3f", printableDeviceName, deviceTypeName(typeRequested), deviceID, confirmedMs);
+            if (prewarmed) printf(",%.3f", readyMs);
+            printf("\n");
+            break;
+        case kFormatJSON:
+            printf("{\"name\": \"%s\", \"type\": \"%s\", \"id\": \"%u\", \"confirmed_ms\": %.3f", printableDeviceName, deviceTypeName(typeRequested), deviceID, confirmedMs);
+            if (prewarmed) printf(", \"ready_ms\": %.3f", readyMs);
+            printf("}\n");
+            break;
+        default:
+            printf("%s audio device set to \"%s\"\n", deviceTypeName(typeRequested), printableDeviceName);
+            if (prewarmed) printf("%s audio device running after %.1f ms\n", deviceTypeName(typeRequested), readyMs);
+            break;
+    }
+}
+
+void setDeviceTuning(ASDeviceTuning tuning) {
+    deviceTuning = tuning;
+}
+
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+} ASPropertyWaiter;
+
+static OSStatus propertyWaiterListener(AudioObjectID objectID, UInt32 numberAddresses, const AudioObjectPropertyAddress *addresses, void *clientData) {
+    ASPropertyWaiter *waiter = (ASPropertyWaiter *)clientData;
+    pthread_mutex_lock(&waiter->mutex);
+    pthread_cond_broadcast(&waiter->cond);
+    pthread_mutex_unlock(&waiter->mutex);
+    return noErr;
+}
+
+// Sets a property and blocks until the HAL reports the new value, or fails
+// with kASPropertyChangeTimeoutError once timeoutMs has passed.  The value
+// is re-read on every change notification as well as on entry, since the
+// notification may fire before the listener is registered.  latencyNanos,
+// if given, gets the time from just before the write to the confirmation,
+// so registering the listener is not counted.
+OSStatus setPropertyAndWait(AudioObjectID objectID, const AudioObjectPropertyAddress *address, UInt32 dataSize, const void *data, UInt32 timeoutMs, UInt64 *latencyNanos) {
+    ASPropertyWaiter waiter;
+    mach_timebase_info_data_t timebase;
+    struct timeval now;
+    struct timespec deadline;
+    UInt8 current[64];
+    OSStatus status;
 
-    addr.mSelector = kAudioHardwarePropertyDevices;
-    addr.mScope = kAudioObjectPropertyScopeGlobal;
-    addr.mElement = kAudioObjectPropertyElementMaster;
-    UInt32 propertySize = 0;
-    OSStatus err = AudioObjectGetPropertyDataSize(kAudioObjectSystemObject, &addr, 0, NULL, &propertySize);
-    if (err != noErr) {
-        return kAudioDeviceUnknown;
+    if (dataSize > sizeof(current)) {
+        return kAudioHardwareIllegalOperationError;
     }
 
-    err = AudioObjectGetPropertyData(kAudioObjectSystemObject, &addr, 0, NULL, &propertySize, dev_array);
-    if (err != noErr) {
-        return kAudioDeviceUnknown;
+    pthread_mutex_init(&waiter.mutex, NULL);
+    pthread_cond_init(&waiter.cond, NULL);
+    AudioObjectAddPropertyListener(objectID, address, propertyWaiterListener, &waiter);
+
+    gettimeofday(&now, NULL);
+    deadline.tv_sec = now.tv_sec + timeoutMs / 1000;
+    deadline.tv_nsec = now.tv_usec * 1000 + (timeoutMs % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
     }
-    numberOfDevices = (propertySize / sizeof(AudioDeviceID));
 
-    for(int i = 0; i < numberOfDevices; ++i) {
-        switch(typeRequested) {
-            case kAudioTypeInput:
-                if (!isAnInputDevice(dev_array[i])) continue;
-                break;
+    mach_timebase_info(&timebase);
+    UInt64 startTime = mach_absolute_time();
+    status = AudioObjectSetPropertyData(objectID, address, 0, NULL, dataSize, data);
+
+    pthread_mutex_lock(&waiter.mutex);
+    while (status == noErr) {
+        UInt32 currentSize = dataSize;
+        status = AudioObjectGetPropertyData(objectID, address, 0, NULL, &currentSize, current);
+        if (status != noErr || memcmp(current, data, dataSize) == 0) break;
+        if (pthread_cond_timedwait(&waiter.cond, &waiter.mutex, &deadline) != 0) {
+            status = kASPropertyChangeTimeoutError;
+        }
+    }
+    pthread_mutex_unlock(&waiter.mutex);
+    if (latencyNanos != NULL) {
+        *latencyNanos = hostTimeToNanos(mach_absolute_time() - startTime, timebase);
+    }
 
-            case kAudioTypeOutput:
-                if (!isAnOutputDevice(dev_array[i])) continue;
-                break;
+    AudioObjectRemovePropertyListener(objectID, address, propertyWaiterListener, &waiter);
+    pthread_cond_destroy(&waiter.cond);
+    pthread_mutex_destroy(&waiter.mutex);
+    return status;
+}
 
-            case kAudioTypeSystemOutput:
-                if (getDeviceType(dev_array[i]) != kAudioTypeOutput) continue;
-                break;
+static bool isSampleRateAvailable(AudioDeviceID deviceID, Float64 sampleRate) {
+    AudioObjectPropertyAddress propertyAddress = {kAudioDevicePropertyAvailableNominalSampleRates, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain};
+    AudioValueRange ranges[32];
+    UInt32 dataSize = sizeof(ranges);
 
-            default:
-                break;
+    if (AudioObjectGetPropertyData(deviceID, &propertyAddress, 0, NULL, &dataSize, ranges) != noErr) {
+        return false;
+    }
+    for (UInt32 i = 0; i < dataSize / sizeof(AudioValueRange); i++) {
+        if (sampleRate >= ranges[i].mMinimum && sampleRate <= ranges[i].mMaximum) {
+            return true;
         }
+    }
+    return false;
+}
 
-        if (first_dev == kAudioDeviceUnknown) {
-            first_dev = dev_array[i];
-        }
-        if (found >= 0) {
-            return dev_array[i];
+// Validates the requested buffer size and sample rate against what the
+// device supports, then applies each one that differs from the current value
+// and waits for the device to confirm it.
+OSStatus applyDeviceTuning(AudioDeviceID deviceID, ASDeviceTuning tuning) {
+    AudioObjectPropertyAddress propertyAddress = {kAudioDevicePropertyBufferFrameSizeRange, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain};
+    OSStatus status;
+    UInt32 dataSize;
+
+    if (tuning.bufferFrames) {
+        AudioValueRange range = {0, 0};
+        dataSize = sizeof(range);
+        status = AudioObjectGetPropertyData(deviceID, &propertyAddress, 0, NULL, &dataSize, &range);
+        if (status != noErr) {
+            return status;
         }
-        if (dev_array[i] == currentDeviceID) {
-            found = i;
+        if (tuning.bufferFrames < range.mMinimum || tuning.bufferFrames > range.mMaximum) {
+            printf("Buffer size %u is outside the supported range %.0f-%.0f.\n", tuning.bufferFrames, range.mMinimum, range.mMaximum);
+            return kAudioHardwareIllegalOperationError;
         }
     }
+    if (tuning.sampleRate > 0.0 && !isSampleRateAvailable(deviceID, tuning.sampleRate)) {
+        printf("Sample rate %.0f is not supported by the device.\n", tuning.sampleRate);
+        return kAudioHardwareIllegalOperationError;
+    }
 
-    return first_dev;
+    // the buffer size is expressed in frames, so change the rate first
+    if (tuning.sampleRate > 0.0) {
+        Float64 currentRate = 0.0;
+        propertyAddress.mSelector = kAudioDevicePropertyNominalSampleRate;
+        dataSize = sizeof(currentRate);
+        AudioObjectGetPropertyData(deviceID, &propertyAddress, 0, NULL, &dataSize, &currentRate);
+        if (currentRate != tuning.sampleRate) {
+            status = setPropertyAndWait(deviceID, &propertyAddress, sizeof(tuning.sampleRate), &tuning.sampleRate, PROPERTY_CHANGE_TIMEOUT_MS, NULL);
+            if (status != noErr) {
+                return status;
+            }
+        }
+    }
+    if (tuning.bufferFrames) {
+        UInt32 currentFrames = 0;
+        propertyAddress.mSelector = kAudioDevicePropertyBufferFrameSize;
+        dataSize = sizeof(currentFrames);
+        AudioObjectGetPropertyData(deviceID, &propertyAddress, 0, NULL, &dataSize, &currentFrames);
+        if (currentFrames != tuning.bufferFrames) {
+            status = setPropertyAndWait(deviceID, &propertyAddress, sizeof(tuning.bufferFrames), &tuning.bufferFrames, PROPERTY_CHANGE_TIMEOUT_MS, NULL);
+            if (status != noErr) {
+                return status;
+            }
+        }
+    }
+    return noErr;
 }
 
-int setDevice(AudioDeviceID newDeviceID, ASDeviceType typeRequested) {
-    return setOneDevice(newDeviceID, typeRequested);
+static UInt32 getDeviceUInt32Property(AudioDeviceID deviceID, AudioObjectPropertySelector selector, AudioObjectPropertyScope scope) {
+    AudioObjectPropertyAddress propertyAddress = {selector, scope, kAudioObjectPropertyElementMain};
+    UInt32 value = 0;
+    UInt32 dataSize = sizeof(value);
+    AudioObjectGetPropertyData(deviceID, &propertyAddress, 0, NULL, &dataSize, &value);
+    return value;
 }
 
-int setOneDevice(AudioDeviceID newDeviceID, ASDeviceType typeRequested) {
-    AudioObjectPropertyAddress addr;
-    UInt32 propertySize = sizeof(UInt32);
-    OSStatus status;
+void showDeviceTuning(AudioDeviceID deviceID, ASDeviceType typeRequested, ASOutputType outputRequested) {
+    AudioObjectPropertyAddress propertyAddress = {kAudioDevicePropertyNominalSampleRate, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain};
+    AudioObjectPropertyScope scope = getScopeForDeviceType(typeRequested);
+    char deviceName[256] = "";
+    Float64 sampleRate = 0.0;
+    UInt32 dataSize = sizeof(sampleRate);
 
-    addr.mScope = kAudioObjectPropertyScopeGlobal;
-    addr.mElement = kAudioObjectPropertyElementMaster;
+    getDeviceName(deviceID, deviceName);
+    AudioObjectGetPropertyData(deviceID, &propertyAddress, 0, NULL, &dataSize, &sampleRate);
+    UInt32 bufferFrames = getDeviceUInt32Property(deviceID, kAudioDevicePropertyBufferFrameSize, kAudioObjectPropertyScopeGlobal);
+    UInt32 latency = getDeviceUInt32Property(deviceID, kAudioDevicePropertyLatency, scope);
+    UInt32 safetyOffset = getDeviceUInt32Property(deviceID, kAudioDevicePropertySafetyOffset, scope);
+    Float64 totalMs = sampleRate > 0.0 ? (bufferFrames + latency + safetyOffset) * 1000.0 / sampleRate : 0.0;
 
-    switch(typeRequested) {
-        case kAudioTypeInput:
-            addr.mSelector = kAudioHardwarePropertyDefaultInputDevice;
+    switch(outputRequested) {
+        case kFormatHuman:
+            printf("%s: %.0f Hz, buffer %u frames, latency %u frames, safety offset %u frames (%.2f ms)\n", deviceName, sampleRate, bufferFrames, latency, safetyOffset, totalMs);
             break;
-        case kAudioTypeOutput:
-            addr.mSelector = kAudioHardwarePropertyDefaultOutputDevice;
+        case kFormatCLI:
+            printf("%s,%s,%u,%.0f,%u,%u,%u,%.2f\n", deviceName, deviceTypeName(typeRequested), deviceID, sampleRate, bufferFrames, latency, safetyOffset, totalMs);
             break;
-        case kAudioTypeSystemOutput:
-            addr.mSelector = kAudioHardwarePropertyDefaultSystemOutputDevice;
+        case kFormatJSON:
+            printf("{\"name\": \"%s\", \"type\": \"%s\", \"id\": \"%u\", \"sample_rate\": %.0f, \"buffer_frames\": %u, \"latency_frames\": %u, \"safety_offset_frames\": %u, \"total_latency_ms\": %.2f}\n", deviceName, deviceTypeName(typeRequested), deviceID, sampleRate, bufferFrames, latency, safetyOffset, totalMs);
             break;
         default:
-            addr.mSelector = kAudioHardwarePropertyDefaultOutputDevice;
             break;
     }
-    status = AudioObjectSetPropertyData(kAudioObjectSystemObject, &addr, 0, NULL, propertySize, &newDeviceID);
-    if(status != noErr) {
-        printf("Failed to set %s", deviceTypeName(typeRequested));
-    }
-
-    return 0;
 }
 
-int setAllDevicesByName(char * requestedDeviceName) {
+int setAllDevicesByName(char * requestedDeviceName, ASOutputType outputRequested) {
     int result;
     bool anyStatusError = false;
     AudioDeviceID newDeviceID;
@@ -776,7 +1681,7 @@ int setAllDevicesByName(char * requestedDeviceName) {
         if (result != 0) {
             anyStatusError = true;
         } else {
-            printf("%s audio device set to \"%s\"\n", deviceTypeName(kAudioTypeInput), requestedDeviceName);
+            showSwitchResult(newDeviceID, kAudioTypeInput, requestedDeviceName, outputRequested);
         }
     }
 
@@ -787,7 +1692,7 @@ int setAllDevicesByName(char * requestedDeviceName) {
         if (result != 0) {
             anyStatusError = true;
         } else {
-            printf("%s audio device set to \"%s\"\n", deviceTypeName(kAudioTypeOutput), requestedDeviceName);
+            showSwitchResult(newDeviceID, kAudioTypeOutput, requestedDeviceName, outputRequested);
         }
     }
 
@@ -798,7 +1703,7 @@ int setAllDevicesByName(char * requestedDeviceName) {
         if (result != 0) {
             anyStatusError = true;
         } else {
-            printf("%s audio device set to \"%s\"\n", deviceTypeName(kAudioTypeSystemOutput), requestedDeviceName);
+            showSwitchResult(newDeviceID, kAudioTypeSystemOutput, requestedDeviceName, outputRequested);
         }
     }
 
@@ -809,19 +1714,19 @@ int setAllDevicesByName(char * requestedDeviceName) {
     return 0;
 }
 
-int cycleNext(ASDeviceType typeRequested) {
+int cycleNext(ASDeviceType typeRequested, ASOutputType outputRequested) {
     int result;
     bool anyStatusError = false;
     if (typeRequested == kAudioTypeAll) {
-        result = cycleNextForOneDevice(kAudioTypeInput);
+        result = cycleNextForOneDevice(kAudioTypeInput, outputRequested);
         if (result != 0) {
             anyStatusError = true;
         }
-        result = cycleNextForOneDevice(kAudioTypeOutput);
+        result = cycleNextForOneDevice(kAudioTypeOutput, outputRequested);
         if (result != 0) {
             anyStatusError = true;
         }
-        result = cycleNextForOneDevice(kAudioTypeSystemOutput);
+        result = cycleNextForOneDevice(kAudioTypeSystemOutput, outputRequested);
         if (result != 0) {
             anyStatusError = true;
         }
@@ -832,11 +1737,11 @@ int cycleNext(ASDeviceType typeRequested) {
         return 0;
 
     } else {
-        return cycleNextForOneDevice(typeRequested);
+        return cycleNextForOneDevice(typeRequested, outputRequested);
     }
 }
 
-int cycleNextForOneDevice(ASDeviceType typeRequested) {
+int cycleNextForOneDevice(ASDeviceType typeRequested, ASOutputType outputRequested) {
     char requestedDeviceName[256];
 
     // get current device of requested type
@@ -857,7 +1762,7 @@ int cycleNextForOneDevice(ASDeviceType typeRequested) {
     int result = setDevice(chosenDeviceID, typeRequested);
     if (result == 0) {
         getDeviceName(chosenDeviceID, requestedDeviceName);
-        printf("%s audio device set to \"%s\"\n", deviceTypeName(typeRequested), requestedDeviceName);
+        showSwitchResult(chosenDeviceID, typeRequested, requestedDeviceName, outputRequested);
     }
     return result;
 
@@ -910,71 +1815,444 @@ OSStatus setMute(ASDeviceType typeRequested, ASMuteType muteRequested) {
 
     printf("Setting device %s to %s\n", currentDeviceName, muted ? "muted": "unmuted");
 
-    return AudioObjectSetPropertyData(currentDeviceID, &propertyAddress, 0, NULL, propertySize, &muted);
+    mach_timebase_info_data_t timebase;
+    mach_timebase_info(&timebase);
+    UInt64 startTime = mach_absolute_time();
+    status = AudioObjectSetPropertyData(currentDeviceID, &propertyAddress, 0, NULL, propertySize, &muted);
+    journalMute(typeRequested, currentDeviceID, status, muted, hostTimeToNanos(mach_absolute_time() - startTime, timebase));
+    return status;
 }
 
-void showAllDevices(ASDeviceType typeRequested, ASOutputType outputRequested) {
-    UInt32 propertySize;
-    AudioObjectPropertyAddress propertyAddress;
-    AudioDeviceID dev_array[64];
-    int numberOfDevices = 0;
-    ASDeviceType device_type;
-    char deviceName[256];
+// Sets the mute state of one device scope and reads it back, so that
+// mutedResult holds what the device actually ended up in.
+OSStatus setDeviceMute(AudioDeviceID deviceID, AudioObjectPropertyScope scope, ASMuteType muteRequested, UInt32 *mutedResult) {
+    AudioObjectPropertyAddress propertyAddress = {
+        .mSelector  = kAudioDevicePropertyMute,
+        .mScope     = scope,
+        .mElement   = kAudioObjectPropertyElementMain,
+    };
+    UInt32 muted = (UInt32)muteRequested;
+    UInt32 propertySize = sizeof(muted);
+    OSStatus status;
 
-    propertyAddress.mSelector = kAudioHardwarePropertyDevices;
-    propertyAddress.mScope = kAudioObjectPropertyScopeGlobal;
-    propertyAddress.mElement = kAudioObjectPropertyElementMaster;
+    if (muteRequested == kToggleMute) {
+        status = AudioObjectGetPropertyData(deviceID, &propertyAddress, 0, NULL, &propertySize, &muted);
+        if (status != noErr) {
+            return status;
+        }
+        muted = !muted;
+    }
+
+    mach_timebase_info_data_t timebase;
+    mach_timebase_info(&timebase);
+    UInt64 startTime = mach_absolute_time();
+    status = AudioObjectSetPropertyData(deviceID, &propertyAddress, 0, NULL, sizeof(muted), &muted);
+    if (status == noErr) {
+        propertySize = sizeof(*mutedResult);
+        status = AudioObjectGetPropertyData(deviceID, &propertyAddress, 0, NULL, &propertySize, mutedResult);
+        if (status == noErr && *mutedResult != muted) {
+            status = kAudioHardwareUnspecifiedError;
+        }
+    }
+    journalMute(scope == kAudioObjectPropertyScopeInput ? kAudioTypeInput : kAudioTypeOutput, deviceID, status, muted, hostTimeToNanos(mach_absolute_time() - startTime, timebase));
+    return status;
+}
+
+typedef struct {
+    AudioDeviceID deviceID;
+    ASDeviceType deviceType;
+    ASMuteType muteRequested;
+    pthread_t thread;
+    bool threadStarted;
+    OSStatus status;
+    UInt32 muted;
+} ASMuteTask;
+
+static void *muteTaskThread(void *context) {
+    ASMuteTask *task = (ASMuteTask *)context;
+    task->status = setDeviceMute(task->deviceID, getScopeForDeviceType(task->deviceType), task->muteRequested, &task->muted);
+    return NULL;
+}
+
+static bool hasSettableMute(AudioDeviceID deviceID, ASDeviceType deviceType) {
+    AudioObjectPropertyAddress propertyAddress = {kAudioDevicePropertyMute, getScopeForDeviceType(deviceType), kAudioObjectPropertyElementMain};
+    Boolean settable = false;
+    return AudioObjectHasProperty(deviceID, &propertyAddress) &&
+        AudioObjectIsPropertySettable(deviceID, &propertyAddress, &settable) == noErr && settable;
+}
 
-    propertySize = 0;
-    AudioObjectGetPropertyDataSize(kAudioObjectSystemObject, &propertyAddress, 0, NULL, &propertySize);
-    numberOfDevices = propertySize / sizeof(AudioDeviceID);
+// Mutes every input and/or output device whose name contains namePattern
+// (all of them when it is empty).  Each device scope is written from its own
+// thread so the total time is that of the slowest device rather than the sum.
+int setMuteForAllDevices(ASDeviceType typeRequested, ASMuteType muteRequested, const char * namePattern, ASOutputType outputRequested) {
+    AudioObjectPropertyAddress propertyAddress = {kAudioHardwarePropertyDevices, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMaster};
+    AudioDeviceID dev_array[MAX_DEVICES];
+    ASMuteTask tasks[MAX_DEVICES * 2];
+    UInt32 propertySize = sizeof(dev_array);
+    char deviceName[256];
+    int taskCount = 0;
+    bool anyStatusError = false;
 
-    AudioObjectGetPropertyData(kAudioObjectSystemObject, &propertyAddress, 0, NULL, &propertySize, dev_array);
+    OSStatus status = AudioObjectGetPropertyData(kAudioObjectSystemObject, &propertyAddress, 0, NULL, &propertySize, dev_array);
+    if (status != noErr) {
+        printf("Error getting property data: %d\n", status);
+        return 1;
+    }
+    int numberOfDevices = propertySize / sizeof(AudioDeviceID);
 
     for (int i = 0; i < numberOfDevices; ++i) {
+        if (namePattern[0] != '\0') {
+            deviceName[0] = '\0';
+            getDeviceName(dev_array[i], deviceName);
+            if (strstr(deviceName, namePattern) == NULL) continue;
+        }
+        if ((typeRequested == kAudioTypeInput || typeRequested == kAudioTypeAll) &&
+            isAnInputDevice(dev_array[i]) && hasSettableMute(dev_array[i], kAudioTypeInput)) {
+            tasks[taskCount++] = (ASMuteTask){ .deviceID = dev_array[i], .deviceType = kAudioTypeInput, .muteRequested = muteRequested };
+        }
+        if ((typeRequested == kAudioTypeOutput || typeRequested == kAudioTypeAll) &&
+            isAnOutputDevice(dev_array[i]) && hasSettableMute(dev_array[i], kAudioTypeOutput)) {
+            tasks[taskCount++] = (ASMuteTask){ .deviceID = dev_array[i], .deviceType = kAudioTypeOutput, .muteRequested = muteRequested };
+        }
+    }
+
+    if (taskCount == 0) {
+        printf("Could not find any %s audio device with a mute control.  Nothing was changed.\n", deviceTypeName(typeRequested));
+        return 1;
+    }
+
+    for (int i = 0; i < taskCount; i++) {
+        tasks[i].threadStarted = (pthread_create(&tasks[i].thread, NULL, muteTaskThread, &tasks[i]) == 0);
+        if (!tasks[i].threadStarted) {
+            // fall back to doing this one inline
+            muteTaskThread(&tasks[i]);
+        }
+    }
+    for (int i = 0; i < taskCount; i++) {
+        if (tasks[i].threadStarted) {
+            pthread_join(tasks[i].thread, NULL);
+        }
+    }
+
+    for (int i = 0; i < taskCount; i++) {
+        deviceName[0] = '\0';
+        getDeviceName(tasks[i].deviceID, deviceName);
+        if (tasks[i].status != noErr) {
+            anyStatusError = true;
+        }
+
+        switch(outputRequested) {
+            case kFormatHuman:
+                if (tasks[i].status == noErr) {
+                    printf("%s device %s %s\n", deviceTypeName(tasks[i].deviceType), deviceName, tasks[i].muted ? "muted" : "unmuted");
+                } else {
+                    printf("%s device %s failed. Error: %d (%s)\n", deviceTypeName(tasks[i].deviceType), deviceName, tasks[i].status, describeStatus(tasks[i].status));
+                }
+                break;
+            case kFormatCLI:
+                printf("%s,%s,%u,%s,%d\n", deviceName, deviceTypeName(tasks[i].deviceType), tasks[i].deviceID, tasks[i].muted ? "muted" : "unmuted", tasks[i].status);
+                break;
+            case kFormatJSON:
+                printf("{\"name\": \"%s\", \"type\": \"%s\", \"id\": \"%u\", \"muted\": %s, \"status\": %d}\n", deviceName, deviceTypeName(tasks[i].deviceType), tasks[i].deviceID, tasks[i].muted ? "true" : "false", tasks[i].status);
+                break;
+            default:
+                break;
+        }
+    }
+
+    return anyStatusError ? 1 : 0;
+}
+
+AudioObjectPropertyScope getScopeForDeviceType(ASDeviceType typeRequested) {
+    switch(typeRequested) {
+        case kAudioTypeInput:
+            return kAudioObjectPropertyScopeInput;
+        case kAudioTypeOutput:
+            return kAudioObjectPropertyScopeOutput;
+        default:
+            return kAudioObjectPropertyScopeGlobal;
+    }
+}
+
+// Fills elements with the settable volume controls of a device and selector
+// with the property they are set through.  The virtual main volume comes
+// first: AudioToolbox serves it for devices whose channels it can move
+// together, so it is one write however many channels there are, and keeps
+// their balance.  Without it, the main element of the volume scalar is
+// used, otherwise the preferred stereo channels one by one, a write each.
+int getVolumeElements(AudioDeviceID deviceID, AudioObjectPropertyScope scope, AudioObjectPropertySelector *selector, AudioObjectPropertyElement *elements, int maxElements) {
+    AudioObjectPropertyAddress propertyAddress = {
+        .mSelector  = kAudioHardwareServiceDeviceProperty_VirtualMainVolume,
+        .mScope     = scope,
+        .mElement   = kAudioObjectPropertyElementMain,
+    };
+    Boolean settable = false;
+
+    if (maxElements < 1) return 0;
+    *selector = kAudioHardwareServiceDeviceProperty_VirtualMainVolume;
+    elements[0] = kAudioObjectPropertyElementMain;
+    if (AudioObjectHasProperty(deviceID, &propertyAddress) &&
+        AudioObjectIsPropertySettable(deviceID, &propertyAddress, &settable) == noErr && settable) {
+        return 1;
+    }
+
+    *selector = kAudioDevicePropertyVolumeScalar;
+    propertyAddress.mSelector = kAudioDevicePropertyVolumeScalar;
+    settable = false;
+    if (AudioObjectHasProperty(deviceID, &propertyAddress) &&
+        AudioObjectIsPropertySettable(deviceID, &propertyAddress, &settable) == noErr && settable) {
+        return 1;
+    }
+
+    UInt32 channels[2] = {1, 2};
+    UInt32 dataSize = sizeof(channels);
+    AudioObjectPropertyAddress channelsAddress = {kAudioDevicePropertyPreferredChannelsForStereo, scope, kAudioObjectPropertyElementMain};
+    AudioObjectGetPropertyData(deviceID, &channelsAddress, 0, NULL, &dataSize, channels);
+
+    int elementCount = 0;
+    for (int i = 0; i < 2 && elementCount < maxElements; i++) {
+        propertyAddress.mElement = channels[i];
+        settable = false;
+        if (AudioObjectHasProperty(deviceID, &propertyAddress) &&
+            AudioObjectIsPropertySettable(deviceID, &propertyAddress, &settable) == noErr && settable) {
+            elements[elementCount++] = channels[i];
+        }
+    }
+    return elementCount;
+}
+
+OSStatus getVolume(ASDeviceType typeRequested, Float32 *volume) {
+    AudioDeviceID currentDeviceID = getCurrentlySelectedDeviceID(typeRequested);
+    AudioObjectPropertyElement elements[MAX_VOLUME_ELEMENTS];
+    AudioObjectPropertyScope scope = getScopeForDeviceType(typeRequested);
+    AudioObjectPropertySelector selector;
+
+    int elementCount = getVolumeElements(currentDeviceID, scope, &selector, elements, MAX_VOLUME_ELEMENTS);
+    if (elementCount == 0) {
+        return kAudioHardwareUnknownPropertyError;
+    }
+
+    // per-channel devices report the average of their channels
+    Float32 total = 0.0;
+    for (int i = 0; i < elementCount; i++) {
+        AudioObjectPropertyAddress propertyAddress = {selector, scope, elements[i]};
+        Float32 channelVolume = 0.0;
+        UInt32 dataSize = sizeof(channelVolume);
+        OSStatus status = AudioObjectGetPropertyData(currentDeviceID, &propertyAddress, 0, NULL, &dataSize, &channelVolume);
+        if (status != noErr) {
+            return status;
+        }
+        total += channelVolume;
+    }
+    *volume = total / elementCount;
+    return noErr;
+}
+
+OSStatus setVolume(ASDeviceType typeRequested, Float32 volume, UInt32 rampMs) {
+    AudioDeviceID currentDeviceID = getCurrentlySelectedDeviceID(typeRequested);
+    AudioObjectPropertyElement elements[MAX_VOLUME_ELEMENTS];
+    Float32 startVolumes[MAX_VOLUME_ELEMENTS];
+    AudioObjectPropertyScope scope = getScopeForDeviceType(typeRequested);
+    AudioObjectPropertySelector selector;
+    char currentDeviceName[256];
+
+    getDeviceName(currentDeviceID, currentDeviceName);
+
+    int elementCount = getVolumeElements(currentDeviceID, scope, &selector, elements, MAX_VOLUME_ELEMENTS);
+    if (elementCount == 0) {
+        return kAudioHardwareUnknownPropertyError;
+    }
+
+    for (int i = 0; i < elementCount; i++) {
+        AudioObjectPropertyAddress propertyAddress = {selector, scope, elements[i]};
+        UInt32 dataSize = sizeof(Float32);
+        startVolumes[i] = volume;
+        if (rampMs > 0) {
+            AudioObjectGetPropertyData(currentDeviceID, &propertyAddress, 0, NULL, &dataSize, &startVolumes[i]);
+        }
+    }
+
+    printf("Setting device %s volume to %.3f\n", currentDeviceName, volume);
+
+    return rampVolume(currentDeviceID, scope, selector, elements, startVolumes, elementCount, volume, rampMs);
+}
+
+// Moves every element from its start volume to the target over rampMs.
+// Steps are scheduled against absolute deadlines from the start of the ramp
+// and each step's level is derived from the time actually elapsed, so a late
+// wakeup is absorbed by the next step rather than stretching the ramp.
+OSStatus rampVolume(AudioDeviceID deviceID, AudioObjectPropertyScope scope, AudioObjectPropertySelector selector, const AudioObjectPropertyElement *elements, const Float32 *startVolumes, int elementCount, Float32 volume, UInt32 rampMs) {
+    mach_timebase_info_data_t timebase;
+    Float32 lastVolumes[MAX_VOLUME_ELEMENTS];
+    OSStatus status = noErr;
+
+    mach_timebase_info(&timebase);
+
+    UInt64 tickNanos = VOLUME_RAMP_TICK_NANOS;
+    UInt64 durationNanos = (UInt64)rampMs * 1000000ULL;
+    UInt64 startTime = mach_absolute_time();
+
+    for (int i = 0; i < elementCount; i++) {
+        lastVolumes[i] = -1.0;
+    }
+
+    for (;;) {
+        UInt64 elapsedNanos = hostTimeToNanos(mach_absolute_time() - startTime, timebase);
+        Float32 progress = (elapsedNanos >= durationNanos) ? 1.0 : (Float32)elapsedNanos / (Float32)durationNanos;
+
+        for (int i = 0; i < elementCount; i++) {
+            Float32 stepVolume = startVolumes[i] + (volume - startVolumes[i]) * progress;
+            if (stepVolume == lastVolumes[i]) continue;
+
+            AudioObjectPropertyAddress propertyAddress = {selector, scope, elements[i]};
+            status = AudioObjectSetPropertyData(deviceID, &propertyAddress, 0, NULL, sizeof(stepVolume), &stepVolume);
+            if (status != noErr) {
+                return status;
+            }
+            lastVolumes[i] = stepVolume;
+        }
+
+        if (progress >= 1.0) break;
+
+        UInt64 nextStep = elapsedNanos / tickNanos + 1;
+        mach_wait_until(startTime + nanosToHostTime(nextStep * tickNanos, timebase));
+    }
+
+    return status;
+}
+
+OSStatus showVolume(ASDeviceType typeRequested, ASOutputType outputRequested) {
+    AudioDeviceID currentDeviceID = getCurrentlySelectedDeviceID(typeRequested);
+    char currentDeviceName[256];
+    Float32 volume = 0.0;
+
+    getDeviceName(currentDeviceID, currentDeviceName);
+    OSStatus status = getVolume(typeRequested, &volume);
+    if (status != noErr) {
+        printf("Could not read the volume of %s device \"%s\". Error: %d (%s)\n", deviceTypeName(typeRequested), currentDeviceName, status, describeStatus(status));
+        return status;
+    }
+
+    switch(outputRequested) {
+        case kFormatHuman:
+            printf("%.3f\n", volume);
+            break;
+        case kFormatCLI:
+            printf("%s,%s,%u,%.3f\n", currentDeviceName, deviceTypeName(typeRequested), currentDeviceID, volume);
+            break;
+        case kFormatJSON:
+            printf("{\"name\": \"%s\", \"type\": \"%s\", \"id\": \"%u\", \"volume\": %.3f}\n", currentDeviceName, deviceTypeName(typeRequested), currentDeviceID, volume);
+            break;
+        default:
+            break;
+    }
+    return noErr;
+}
+
+// Prints, or with the record formats appends to writer, a row for every
+// device of the snapshot of typeRequested.
+static void showDevicesOfType(ASDeviceSnapshot *snapshot, ASDeviceType typeRequested, ASOutputType outputRequested, UInt32 fieldsRequested, ASRecordWriter *writer) {
+    char value[1024];
+
+    for (int i = 0; i < snapshot->count; ++i) {
+        AudioDeviceID deviceID = snapshot->devices[i].deviceID;
+        ASDeviceType device_type = typeRequested;
         switch (typeRequested) {
             case kAudioTypeInput:
-                if (!isAnInputDevice(dev_array[i]))
+                if (!isAnInputDevice(deviceID))
                     continue;
                 device_type = kAudioTypeInput;
                 break;
             case kAudioTypeOutput:
-                if (!isAnOutputDevice(dev_array[i]))
+                if (!isAnOutputDevice(deviceID))
                     continue;
                 device_type = kAudioTypeOutput;
                 break;
             case kAudioTypeSystemOutput:
-                device_type = getDeviceType(dev_array[i]);
+                device_type = getDeviceType(deviceID);
                 if (device_type != kAudioTypeOutput)
                     continue;
                 break;
             default:
+                device_type = getDeviceType(deviceID);
                 break;
         }
 
-        getDeviceName(dev_array[i], deviceName);
+        // the human format always leads with the name, and only fetches the
+        // uid when it is asked for
+        UInt32 fields = fieldsRequested;
+        // json consumers also get who, if anyone, has the device to itself
+        // and which ports it can switch between
+        if (outputRequested == kFormatJSON && fieldsRequested == kDefaultDeviceFields) {
+            fields |= kFieldHogOwner | kFieldDataSources;
+        }
+        if (outputRequested == kFormatHuman) {
+            fields = (fields | kFieldName) & ~(fieldsRequested == kDefaultDeviceFields ? kDefaultDeviceFields & ~kFieldName : 0);
+        }
+        ASDeviceInfo *info = getDeviceInfo(snapshot, i, fields);
 
-        switch (outputRequested) {
-            case kFormatHuman:
-                printf("%s\n", deviceName);
-                break;
-            case kFormatCLI:
-                printf("%s,%s,%u,%s\n", deviceName, deviceTypeName(device_type), dev_array[i], getDeviceUID(dev_array[i]));
-                break;
-            case kFormatJSON:
-                printf("{\"name\": \"%s\", \"type\": \"%s\", \"id\": \"%u\", \"uid\": \"%s\"}\n", deviceName, deviceTypeName(device_type), dev_array[i], getDeviceUID(dev_array[i]));
-                break;
-            default:
-                break;
+        if (isRecordFormat(outputRequested)) {
+            writeDeviceRecord(writer, kRecordDevice, info, fields, device_type);
+            continue;
+        }
+
+        bool first = true;
+        for (UInt32 field = 1; field <= fields; field <<= 1) {
+            if (!(fields & field)) continue;
+            formatDeviceField(info, (ASDeviceField)field, device_type, outputRequested == kFormatJSON, value, sizeof(value));
+
+            switch (outputRequested) {
+                case kFormatHuman:
+                    if (field == kFieldName) {
+                        printf("%s", value);
+                    } else {
+                        printf(", %s: %s", deviceFieldName((ASDeviceField)field), value);
+                    }
+                    break;
+                case kFormatCLI:
+                    printf("%s%s", first ? "" : ",", value);
+                    break;
+                case kFormatJSON:
+                    printf("%s\"%s\": %s", first ? "{" : ", ", deviceFieldName((ASDeviceField)field), value);
+                    break;
+                default:
+                    break;
+            }
+            first = false;
         }
+        printf(outputRequested == kFormatJSON ? "}\n" : "\n");
+    }
+}
+
+// With -t all the inputs are listed first, then the outputs; either way the
+// record formats go out in one write.
+int showAllDevices(ASDeviceType typeRequested, ASOutputType outputRequested, UInt32 fieldsRequested) {
+    ASDeviceSnapshot snapshot;
+    ASRecordWriter writer;
+    bool both = (typeRequested == kAudioTypeAll || typeRequested == kAudioTypeUnknown);
+
+    loadDeviceSnapshot(&snapshot);
+    initRecordWriter(&writer, outputRequested);
+
+    if (both) {
+        showDevicesOfType(&snapshot, kAudioTypeInput, outputRequested, fieldsRequested, &writer);
+        typeRequested = kAudioTypeOutput;
+    }
+    showDevicesOfType(&snapshot, typeRequested, outputRequested, fieldsRequested, &writer);
+
+    if (isRecordFormat(outputRequested)) {
+        // AirPlay receivers are not part of the record schema
+        return flushRecordWriter(&writer);
     }
 
   // Add AirPlay devices to the output devices list
-    if (typeRequested == kAudioTypeOutput || typeRequested == kAudioTypeSystemOutput) {
+    // (DNS-SD is not part of a trace, so a replay leaves them out)
+    if ((typeRequested == kAudioTypeOutput || typeRequested == kAudioTypeSystemOutput) && getHALTraceMode() != kHALTraceReplay) {
         // Call the listAirPlayDevices function here and add the AirPlay devices to the output
         // Use the same format as specified in the outputRequested argument
         listAirPlayDevices(outputRequested);
     }
+    return 0;
 }
 
 
@@ -29,11 +29,25 @@ OTHER DEALINGS IN THE SOFTWARE.
  *
  */
 
+#ifndef AUDIO_SWITCH_H
+#define AUDIO_SWITCH_H
+
 #include <unistd.h>
-#include <CoreServices/CoreServices.h>
+#include <CoreFoundation/CoreFoundation.h>
 #include <CoreAudio/CoreAudio.h>
 #include <CoreAudio/AudioHardware.h>
 #include <CoreAudio/AudioHardwareBase.h>
+#include "hal_trace.h"
+
+// The macOS 12 SDK renamed the constants spelled "master" to "main" and
+// deprecated the old spellings, which are all that older SDKs have.
+#ifndef __MAC_12_0
+#define kAudioObjectPropertyElementMain kAudioObjectPropertyElementMaster
+#define kAudioAggregateDevicePropertyMainSubDevice kAudioAggregateDevicePropertyMasterSubDevice
+#define kAudioAggregateDeviceMainSubDeviceKey kAudioAggregateDeviceMasterSubDeviceKey
+#define kAudioHardwareServiceDeviceProperty_VirtualMainVolume kAudioHardwareServiceDeviceProperty_VirtualMasterVolume
+#define kAudioHardwareServiceDeviceProperty_VirtualMainBalance kAudioHardwareServiceDeviceProperty_VirtualMasterBalance
+#endif
 
 
 typedef enum {
@@ -48,6 +62,8 @@ typedef enum {
 	kFormatHuman = 0,
 	kFormatCLI = 1,
 	kFormatJSON = 2,
+	kFormatBinary = 3,
+	kFormatMsgPack = 4,
 } ASOutputType;
 
 typedef enum {
@@ -56,6 +72,11 @@ typedef enum {
 	kToggleMute = 2,
 } ASMuteType;
 
+typedef struct {
+	UInt32 bufferFrames;	// 0 leaves the I/O buffer size alone
+	Float64 sampleRate;		// 0 leaves the nominal sample rate alone
+} ASDeviceTuning;
+
 enum {
 	kFunctionSetDeviceByName = 1,
 	kFunctionShowHelp        = 2,
@@ -65,28 +86,115 @@ enum {
     kFunctionSetDeviceByID   = 6,
     kFunctionSetDeviceByUID  = 7,
 	kFunctionMute            = 8,
+	kFunctionVolume          = 9,
+	kFunctionShowTuning      = 10,
+	kFunctionPublish         = 11,
+	kFunctionSetDeviceByExactUID = 12,
+	kFunctionCyclePrevious   = 13,
+	kFunctionTop             = 14,
+	kFunctionCreateAggregate = 15,
+	kFunctionDestroyAggregate = 16,
+	kFunctionDecode          = 17,
+	kFunctionHistory         = 18,
+	kFunctionShowDataSources = 19,
+	kFunctionMeasureLatency  = 20,
+	kFunctionComplete        = 21,
+};
+
+// returned when the HAL does not report a property change in time
+enum {
+	kASPropertyChangeTimeoutError = 'tout',
+};
+
+// long-only options, numbered past the range of short option characters
+enum {
+	kOptionRamp = 256,
+	kOptionAllDevices,
+	kOptionMatch,
+	kOptionBufferFrames,
+	kOptionSampleRate,
+	kOptionTuning,
+	kOptionTimeout,
+	kOptionFields,
+	kOptionPublish,
+	kOptionShm,
+	kOptionRecord,
+	kOptionReplay,
+	kOptionPrevious,
+	kOptionDebounce,
+	kOptionPreviewHook,
+	kOptionTop,
+	kOptionInterval,
+	kOptionPrewarm,
+	kOptionHog,
+	kOptionReleaseHog,
+	kOptionCreateAggregate,
+	kOptionSubDevice,
+	kOptionMultiOutput,
+	kOptionPrivate,
+	kOptionSelect,
+	kOptionDestroyAggregate,
+	kOptionDecode,
+	kOptionStartupProfile,
+	kOptionHistory,
+	kOptionSince,
+	kOptionDataSources,
+	kOptionDataSource,
+	kOptionMatchRate,
+	kOptionMeter,
+	kOptionMeasureLatency,
+	kOptionOutputDevice,
+	kOptionInputDevice,
+	kOptionComplete,
 };
 
 
 
 void showUsage(const char * appName);
+const char * describeStatus(OSStatus status);
 int runAudioSwitch(int argc, const char * argv[]);
 const char * getDeviceUID(AudioDeviceID deviceID);
 AudioDeviceID getRequestedDeviceIDFromUIDSubstring(char * requestedDeviceUID, ASDeviceType typeRequested);
+AudioDeviceID getRequestedDeviceIDFromUID(char * requestedDeviceUID, ASDeviceType typeRequested);
+bool isDeviceOfType(AudioDeviceID deviceID, ASDeviceType typeRequested);
 AudioDeviceID getCurrentlySelectedDeviceID(ASDeviceType typeRequested);
 void getDeviceName(AudioDeviceID deviceID, char * deviceName);
 ASDeviceType getDeviceType(AudioDeviceID deviceID);
 bool isAnInputDevice(AudioDeviceID deviceID);
 bool isAnOutputDevice(AudioDeviceID deviceID);
 char *deviceTypeName(ASDeviceType device_type);
-void showCurrentlySelectedDeviceID(ASDeviceType typeRequested, ASOutputType outputRequested);
+int showCurrentlySelectedDeviceID(ASDeviceType typeRequested, ASOutputType outputRequested);
 AudioDeviceID getRequestedDeviceID(char * requestedDeviceName, ASDeviceType typeRequested);
 AudioDeviceID getNextDeviceID(AudioDeviceID currentDeviceID, ASDeviceType typeRequested);
+typedef AudioDeviceID (*ASDeviceResolver)(char * query, ASDeviceType typeRequested);
+
 int setDevice(AudioDeviceID newDeviceID, ASDeviceType typeRequested);
+int setResolvedDevice(AudioDeviceID *chosenDeviceID, ASDeviceType typeRequested, ASDeviceResolver resolver, char * query, UInt64 resolvedGeneration);
 int setOneDevice(AudioDeviceID newDeviceID, ASDeviceType typeRequested);
-int setAllDevicesByName(char * requestedDeviceName);
-int cycleNext(ASDeviceType typeRequested);
-int cycleNextForOneDevice(ASDeviceType typeRequested);
+void setSwitchTimeout(UInt32 timeoutMs);
+UInt32 getSwitchTimeout(void);
+void setHogOnSwitch(bool hog);
+UInt64 getLastSwitchNanos(void);
+void setPrewarm(SInt32 holdMs);
+OSStatus prewarmDevice(AudioDeviceID deviceID, UInt32 holdMs, UInt64 *readyNanos);
+void showSwitchResult(AudioDeviceID deviceID, ASDeviceType typeRequested, const char * printableDeviceName, ASOutputType outputRequested);
+void setDeviceTuning(ASDeviceTuning tuning);
+OSStatus setPropertyAndWait(AudioObjectID objectID, const AudioObjectPropertyAddress *address, UInt32 dataSize, const void *data, UInt32 timeoutMs, UInt64 *latencyNanos);
+OSStatus applyDeviceTuning(AudioDeviceID deviceID, ASDeviceTuning tuning);
+void showDeviceTuning(AudioDeviceID deviceID, ASDeviceType typeRequested, ASOutputType outputRequested);
+int setAllDevicesByName(char * requestedDeviceName, ASOutputType outputRequested);
+int cycleNext(ASDeviceType typeRequested, ASOutputType outputRequested);
+int cycleNextForOneDevice(ASDeviceType typeRequested, ASOutputType outputRequested);
 OSStatus setMute(ASDeviceType typeRequested, ASMuteType mute);
-void showAllDevices(ASDeviceType typeRequested, ASOutputType outputRequested);
+OSStatus setDeviceMute(AudioDeviceID deviceID, AudioObjectPropertyScope scope, ASMuteType muteRequested, UInt32 *mutedResult);
+int setMuteForAllDevices(ASDeviceType typeRequested, ASMuteType muteRequested, const char * namePattern, ASOutputType outputRequested);
+AudioObjectPropertyScope getScopeForDeviceType(ASDeviceType typeRequested);
+int getVolumeElements(AudioDeviceID deviceID, AudioObjectPropertyScope scope, AudioObjectPropertySelector *selector, AudioObjectPropertyElement *elements, int maxElements);
+OSStatus getVolume(ASDeviceType typeRequested, Float32 *volume);
+OSStatus setVolume(ASDeviceType typeRequested, Float32 volume, UInt32 rampMs);
+OSStatus rampVolume(AudioDeviceID deviceID, AudioObjectPropertyScope scope, AudioObjectPropertySelector selector, const AudioObjectPropertyElement *elements, const Float32 *startVolumes, int elementCount, Float32 volume, UInt32 rampMs);
+OSStatus showVolume(ASDeviceType typeRequested, ASOutputType outputRequested);
+int showAllDevices(ASDeviceType typeRequested, ASOutputType outputRequested, UInt32 fieldsRequested);
 void listAirPlayDevices();
+
+#endif
@@ -0,0 +1,65 @@
+# bash completion for SwitchAudioSource
+#
+# Source this file from ~/.bashrc, or copy it into a bash_completion.d
+# directory.  Device names and uids come from SwitchAudioSource --complete,
+# which answers from a cached index.
+
+_SwitchAudioSource_devices() {
+    local command="$1" prefix="$2" type="$3" field="$4" device
+    COMPREPLY=()
+    # what was typed may still be escaped or quoted
+    prefix="${prefix//\\/}"
+    prefix="${prefix#[\"\']}"
+    while IFS= read -r device; do
+        COMPREPLY+=("$(printf '%q' "$device")")
+    done < <("$command" --complete "$prefix" -t "$type" --fields "$field" 2>/dev/null)
+}
+
+_SwitchAudioSource() {
+    local cur="${COMP_WORDS[COMP_CWORD]}"
+    local prev="${COMP_WORDS[COMP_CWORD-1]}"
+    local type=output i
+
+    for ((i = 1; i < COMP_CWORD - 1; i++)); do
+        if [[ ${COMP_WORDS[i]} == -t ]]; then
+            type="${COMP_WORDS[i+1]}"
+        fi
+    done
+
+    case "$prev" in
+        -s)
+            _SwitchAudioSource_devices "$1" "$cur" "$type" name
+            ;;
+        -u|-U|--uid-exact|--sub)
+            _SwitchAudioSource_devices "$1" "$cur" "$type" uid
+            ;;
+        --out)
+            _SwitchAudioSource_devices "$1" "$cur" output name
+            ;;
+        --in)
+            _SwitchAudioSource_devices "$1" "$cur" input name
+            ;;
+        -t)
+            COMPREPLY=($(compgen -W "input output system all" -- "$cur"))
+            ;;
+        -f)
+            COMPREPLY=($(compgen -W "human cli json binary msgpack" -- "$cur"))
+            ;;
+        -m)
+            COMPREPLY=($(compgen -W "mute unmute toggle" -- "$cur"))
+            ;;
+        --hog)
+            COMPREPLY=($(compgen -W "self" -- "$cur"))
+            ;;
+        *)
+            COMPREPLY=($(compgen -W "-a -c -f -t -m -v -n -i -u -U -s --all-devices --match --ramp
+                --buffer-frames --sample-rate --tuning --match-rate --data-sources --data-source
+                --prewarm --hog --release-hog --create-aggregate --sub --multi-output --private
+                --select --destroy-aggregate --timeout --previous --debounce --preview-hook
+                --shm --publish --top --interval --meter --measure-latency --out --in --decode
+                --fields --startup-profile --history --since --record --replay --complete" -- "$cur"))
+            ;;
+    esac
+}
+
+complete -F _SwitchAudioSource SwitchAudioSource
@@ -0,0 +1,68 @@
+# fish completion for SwitchAudioSource
+#
+# Copy this file to ~/.config/fish/completions/.  Device names and uids
+# come from SwitchAudioSource --complete, which answers from a cached index.
+
+function __SwitchAudioSource_devices --argument-names type field
+    if test -z "$type"
+        set type output
+        set -l tokens (commandline -opc)
+        for i in (seq 2 (math (count $tokens) - 1))
+            if test "$tokens[$i]" = -t
+                set type $tokens[(math $i + 1)]
+            end
+        end
+    end
+    SwitchAudioSource --complete (commandline -ct) -t $type --fields $field 2>/dev/null
+end
+
+complete -c SwitchAudioSource -f
+complete -c SwitchAudioSource -s a -d 'Show all devices'
+complete -c SwitchAudioSource -s c -d 'Show the current device'
+complete -c SwitchAudioSource -s f -x -a 'human cli json binary msgpack' -d 'Output format'
+complete -c SwitchAudioSource -s t -x -a 'input output system all' -d 'Device type'
+complete -c SwitchAudioSource -s m -x -a 'mute unmute toggle' -d 'Set the mute status'
+complete -c SwitchAudioSource -s v -x -d 'Show or set the volume'
+complete -c SwitchAudioSource -s n -d 'Cycle to the next device'
+complete -c SwitchAudioSource -s i -x -d 'Set the device by id'
+complete -c SwitchAudioSource -s s -x -a '(__SwitchAudioSource_devices "" name)' -d 'Set the device by name'
+complete -c SwitchAudioSource -s u -x -a '(__SwitchAudioSource_devices "" uid)' -d 'Set the device by uid'
+complete -c SwitchAudioSource -s U -l uid-exact -x -a '(__SwitchAudioSource_devices "" uid)' -d 'Set the device by exact uid'
+complete -c SwitchAudioSource -l previous -d 'Cycle to the previous device'
+complete -c SwitchAudioSource -l all-devices -d 'With -m, every device of the type'
+complete -c SwitchAudioSource -l match -x -d 'With --all-devices, names containing text'
+complete -c SwitchAudioSource -l ramp -x -d 'With -v, fade over ms'
+complete -c SwitchAudioSource -l buffer-frames -x -d 'Buffer size of the new device'
+complete -c SwitchAudioSource -l sample-rate -x -d 'Sample rate of the new device'
+complete -c SwitchAudioSource -l tuning -d 'Show sample rate, buffer size and latency'
+complete -c SwitchAudioSource -l match-rate -d 'Keep the default input and output rates equal'
+complete -c SwitchAudioSource -l data-sources -d 'Show the data sources of the device'
+complete -c SwitchAudioSource -l data-source -x -d 'Select a data source'
+complete -c SwitchAudioSource -l prewarm -d 'Start the new device before switching'
+complete -c SwitchAudioSource -l hog -x -a 'self' -d 'Hog the device until the process exits'
+complete -c SwitchAudioSource -l release-hog -d 'Release hog mode'
+complete -c SwitchAudioSource -l create-aggregate -x -d 'Create an aggregate device'
+complete -c SwitchAudioSource -l sub -x -a '(__SwitchAudioSource_devices all uid)' -d 'Device of the aggregate'
+complete -c SwitchAudioSource -l multi-output -d 'Create a multi-output device'
+complete -c SwitchAudioSource -l private -d 'Keep the aggregate only while running'
+complete -c SwitchAudioSource -l select -d 'Make the new aggregate the default'
+complete -c SwitchAudioSource -l destroy-aggregate -x -d 'Destroy an aggregate device'
+complete -c SwitchAudioSource -l timeout -x -d 'How long to wait for a switch'
+complete -c SwitchAudioSource -l debounce -x -d 'Add up presses within ms'
+complete -c SwitchAudioSource -l preview-hook -x -d 'Command run for each pending device'
+complete -c SwitchAudioSource -l shm -d 'Read the published device'
+complete -c SwitchAudioSource -l publish -d 'Publish the current devices'
+complete -c SwitchAudioSource -l top -d 'Show the load of every device'
+complete -c SwitchAudioSource -l interval -x -d 'Refresh interval'
+complete -c SwitchAudioSource -l meter -d 'Show input levels'
+complete -c SwitchAudioSource -l measure-latency -d 'Measure the round trip latency'
+complete -c SwitchAudioSource -l out -x -a '(__SwitchAudioSource_devices output name)' -d 'Output device to measure'
+complete -c SwitchAudioSource -l in -x -a '(__SwitchAudioSource_devices input name)' -d 'Input device to measure'
+complete -c SwitchAudioSource -l decode -d 'Print records read from stdin as json'
+complete -c SwitchAudioSource -l fields -x -d 'Attributes to show'
+complete -c SwitchAudioSource -l startup-profile -d 'Report startup times'
+complete -c SwitchAudioSource -l history -d 'Show past switches'
+complete -c SwitchAudioSource -l since -x -d 'With --history, seconds back'
+complete -c SwitchAudioSource -l record -r -F -d 'Record audio system queries'
+complete -c SwitchAudioSource -l replay -r -F -d 'Answer queries from a trace'
+complete -c SwitchAudioSource -l complete -x -d 'Print device names starting with a prefix'
@@ -0,0 +1,192 @@
+/*
+ *  debounced_cycle.c
+ *  AudioSwitcher
+ *
+ *  MIT License, see license.txt
+ */
+
+#include "debounced_cycle.h"
+#include <fcntl.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+extern char **environ;
+
+typedef struct {
+    ASDeviceType type;
+    int fd;
+    UInt32 pressCount;
+} ASCyclePress;
+
+static UInt64 nowMicros(void) {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return (UInt64)now.tv_sec * 1000000ULL + now.tv_usec;
+}
+
+static int openCycleState(ASDeviceType typeRequested) {
+    char path[1024];
+    const char *directory = getenv("TMPDIR");
+
+    snprintf(path, sizeof(path), "%s/SwitchAudioSource.cycle.%s.%u", directory ? directory : "/tmp", deviceTypeName(typeRequested), (unsigned int)getuid());
+    return open(path, O_RDWR | O_CREAT, 0600);
+}
+
+static void readCycleState(int fd, ASCycleState *state) {
+    if (pread(fd, state, sizeof(*state), 0) != sizeof(*state) || state->magic != CYCLE_STATE_MAGIC) {
+        memset(state, 0, sizeof(*state));
+        state->magic = CYCLE_STATE_MAGIC;
+    }
+}
+
+static void buildRing(ASCycleState *state, ASDeviceType typeRequested) {
+    AudioObjectPropertyAddress propertyAddress = {kAudioHardwarePropertyDevices, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain};
+    AudioDeviceID dev_array[CYCLE_RING_SIZE];
+    UInt32 propertySize = sizeof(dev_array);
+
+    state->ringCount = 0;
+    if (AudioObjectGetPropertyData(kAudioObjectSystemObject, &propertyAddress, 0, NULL, &propertySize, dev_array) != noErr) {
+        return;
+    }
+    for (UInt32 i = 0; i < propertySize / sizeof(AudioDeviceID); i++) {
+        if (isDeviceOfType(dev_array[i], typeRequested)) {
+            state->ring[state->ringCount++] = dev_array[i];
+        }
+    }
+    state->origin = getCurrentlySelectedDeviceID(typeRequested);
+    state->offset = 0;
+}
+
+static AudioDeviceID cycleTarget(const ASCycleState *state) {
+    int originIndex = 0;
+    int count = (int)state->ringCount;
+
+    if (count == 0) return kAudioDeviceUnknown;
+    for (int i = 0; i < count; i++) {
+        if (state->ring[i] == state->origin) originIndex = i;
+    }
+    return state->ring[(((originIndex + state->offset) % count) + count) % count];
+}
+
+static void showPreview(ASDeviceType typeRequested, AudioDeviceID target, const char * previewHook) {
+    char deviceName[256] = "";
+
+    getDeviceName(target, deviceName);
+    printf("next %s audio device: \"%s\"\n", deviceTypeName(typeRequested), deviceName);
+    fflush(stdout);
+
+    // the hook runs in the background of a shell that exits at once, so it
+    // is not left behind as a zombie of this process and cannot hold up
+    // the switch; only the shell is waited for
+    if (previewHook != NULL) {
+        pid_t pid;
+        char *hookArgs[] = {"sh", "-c", "\"$0\" \"$@\" &", (char *)previewHook, deviceTypeName(typeRequested), deviceName, NULL};
+        if (posix_spawn(&pid, "/bin/sh", NULL, NULL, hookArgs, environ) == 0) {
+            waitpid(pid, NULL, 0);
+        }
+    }
+}
+
+// Records one press: starts a new burst if the last press is older than the
+// window, then adds step to the offset and previews where it now points.
+static int pressCycle(ASCyclePress *press, int step, UInt32 windowMs, const char * previewHook) {
+    ASCycleState state;
+    UInt64 now = nowMicros();
+
+    press->fd = openCycleState(press->type);
+    if (press->fd < 0) {
+        printf("Could not open the %s cycle state file.\n", deviceTypeName(press->type));
+        return 1;
+    }
+
+    flock(press->fd, LOCK_EX);
+    readCycleState(press->fd, &state);
+    if (state.ringCount == 0 || now - state.lastPressMicros > (UInt64)windowMs * 1000ULL) {
+        buildRing(&state, press->type);
+    }
+    state.offset += step;
+    state.lastPressMicros = now;
+    press->pressCount = ++state.pressCount;
+    pwrite(press->fd, &state, sizeof(state), 0);
+    flock(press->fd, LOCK_UN);
+
+    AudioDeviceID target = cycleTarget(&state);
+    if (target == kAudioDeviceUnknown) {
+        printf("Could not find next audio device of type %s.  Nothing was changed.\n", deviceTypeName(press->type));
+        close(press->fd);
+        return 1;
+    }
+    if (windowMs > 0) {
+        showPreview(press->type, target, previewHook);
+    }
+    return 0;
+}
+
+// Switches to the burst's target if no later press has arrived.
+static int applyCycle(ASCyclePress *press, ASOutputType outputRequested) {
+    ASCycleState state;
+    char deviceName[256] = "";
+    AudioDeviceID target = kAudioDeviceUnknown;
+
+    flock(press->fd, LOCK_EX);
+    readCycleState(press->fd, &state);
+    if (state.pressCount == press->pressCount) {
+        target = cycleTarget(&state);
+        state.ringCount = 0;
+        pwrite(press->fd, &state, sizeof(state), 0);
+    }
+    flock(press->fd, LOCK_UN);
+    close(press->fd);
+
+    if (target == kAudioDeviceUnknown) {
+        // superseded by a later press, which will do the switch
+        return 0;
+    }
+
+    int result = setDevice(target, press->type);
+    if (result == 0) {
+        getDeviceName(target, deviceName);
+        showSwitchResult(target, press->type, deviceName, outputRequested);
+    }
+    return result;
+}
+
+int cycleDebounced(ASDeviceType typeRequested, int step, UInt32 windowMs, const char * previewHook, ASOutputType outputRequested) {
+    ASCyclePress presses[3];
+    int pressCount = 0;
+    bool anyStatusError = false;
+
+    if (typeRequested == kAudioTypeAll) {
+        presses[pressCount++].type = kAudioTypeInput;
+        presses[pressCount++].type = kAudioTypeOutput;
+        presses[pressCount++].type = kAudioTypeSystemOutput;
+    } else {
+        presses[pressCount++].type = typeRequested;
+    }
+
+    for (int i = 0; i < pressCount; i++) {
+        if (pressCycle(&presses[i], step, windowMs, previewHook) != 0) {
+            // nothing is switched, so the state files of the types already
+            // pressed are closed unapplied
+            while (--i >= 0) {
+                close(presses[i].fd);
+            }
+            return 1;
+        }
+    }
+
+    if (windowMs > 0) {
+        usleep(windowMs * 1000);
+    }
+
+    for (int i = 0; i < pressCount; i++) {
+        if (applyCycle(&presses[i], outputRequested) != 0) {
+            anyStatusError = true;
+        }
+    }
+    return anyStatusError ? 1 : 0;
+}
@@ -0,0 +1,36 @@
+/*
+ *  debounced_cycle.h
+ *  AudioSwitcher
+ *
+ *  Cycling that coalesces rapid presses.  Each invocation adds its step to
+ *  an offset kept in a small per-user state file, previews the device the
+ *  offset now points at, and waits out the debounce window.  Only the
+ *  invocation that is still the latest press when its window ends switches,
+ *  so mashing a hotkey moves straight to the final device instead of
+ *  through every device in between.
+ *
+ *  MIT License, see license.txt
+ */
+
+#ifndef DEBOUNCED_CYCLE_H
+#define DEBOUNCED_CYCLE_H
+
+#include "audio_switch.h"
+
+#define CYCLE_STATE_MAGIC 0x53414359	// 'SACY'
+#define CYCLE_RING_SIZE 64
+#define MAX_DEBOUNCE_MS 10000
+
+typedef struct {
+	UInt32 magic;
+	UInt32 pressCount;			// bumped by every press; the last presser switches
+	UInt64 lastPressMicros;
+	AudioDeviceID origin;		// default device when the burst of presses started
+	SInt32 offset;				// sum of the presses' steps since then
+	UInt32 ringCount;			// 0 when no burst is in progress
+	AudioDeviceID ring[CYCLE_RING_SIZE];
+} ASCycleState;
+
+int cycleDebounced(ASDeviceType typeRequested, int step, UInt32 windowMs, const char * previewHook, ASOutputType outputRequested);
+
+#endif
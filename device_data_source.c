@@ -0,0 +1,159 @@
+/*
+ *  device_data_source.c
+ *  AudioSwitcher
+ *
+ *  MIT License, see license.txt
+ */
+
+#include "device_data_source.h"
+#include <stdio.h>
+#include <string.h>
+
+// The system output device plays through its output ports like any other.
+AudioObjectPropertyScope getDataSourceScope(ASDeviceType typeRequested) {
+    return typeRequested == kAudioTypeInput ? kAudioObjectPropertyScopeInput : kAudioObjectPropertyScopeOutput;
+}
+
+void getDataSourceName(AudioDeviceID deviceID, AudioObjectPropertyScope scope, UInt32 sourceID, char *name, size_t nameSize) {
+    AudioObjectPropertyAddress propertyAddress = {kAudioDevicePropertyDataSourceNameForIDCFString, scope, kAudioObjectPropertyElementMain};
+    CFStringRef sourceName = NULL;
+    AudioValueTranslation translation = {&sourceID, sizeof(sourceID), &sourceName, sizeof(sourceName)};
+    UInt32 dataSize = sizeof(translation);
+
+    name[0] = '\0';
+    if (AudioObjectGetPropertyData(deviceID, &propertyAddress, 0, NULL, &dataSize, &translation) == noErr && sourceName != NULL) {
+        CFStringGetCString(sourceName, name, nameSize, kCFStringEncodingUTF8);
+        CFRelease(sourceName);
+    }
+}
+
+void getCurrentDataSourceName(AudioDeviceID deviceID, AudioObjectPropertyScope scope, char *name, size_t nameSize) {
+    AudioObjectPropertyAddress propertyAddress = {kAudioDevicePropertyDataSource, scope, kAudioObjectPropertyElementMain};
+    UInt32 sourceID = 0;
+    UInt32 dataSize = sizeof(sourceID);
+
+    name[0] = '\0';
+    if (!AudioObjectHasProperty(deviceID, &propertyAddress) ||
+        AudioObjectGetPropertyData(deviceID, &propertyAddress, 0, NULL, &dataSize, &sourceID) != noErr) {
+        return;
+    }
+    getDataSourceName(deviceID, scope, sourceID, name, nameSize);
+}
+
+// Fills list with the data sources of one scope of a device and the one in
+// use.  Returns how many there are, 0 for devices without data sources.
+UInt32 getDataSources(AudioDeviceID deviceID, AudioObjectPropertyScope scope, ASDataSourceList *list) {
+    AudioObjectPropertyAddress propertyAddress = {kAudioDevicePropertyDataSources, scope, kAudioObjectPropertyElementMain};
+    UInt32 dataSize = sizeof(list->ids);
+
+    memset(list, 0, sizeof(*list));
+    if (!AudioObjectHasProperty(deviceID, &propertyAddress) ||
+        AudioObjectGetPropertyData(deviceID, &propertyAddress, 0, NULL, &dataSize, list->ids) != noErr) {
+        return 0;
+    }
+    list->count = dataSize / sizeof(UInt32);
+    for (UInt32 i = 0; i < list->count; i++) {
+        getDataSourceName(deviceID, scope, list->ids[i], list->names[i], sizeof(list->names[i]));
+    }
+
+    propertyAddress.mSelector = kAudioDevicePropertyDataSource;
+    dataSize = sizeof(list->currentID);
+    AudioObjectGetPropertyData(deviceID, &propertyAddress, 0, NULL, &dataSize, &list->currentID);
+    return list->count;
+}
+
+// Data sources are matched by their full name, as devices are by -s.
+bool getRequestedDataSourceID(const ASDataSourceList *list, const char *requestedSourceName, UInt32 *sourceID) {
+    for (UInt32 i = 0; i < list->count; i++) {
+        if (strcmp(requestedSourceName, list->names[i]) == 0) {
+            *sourceID = list->ids[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+// Writes the names of the data sources as a JSON array, or separated by |
+// for the other formats.
+void formatDataSources(const ASDataSourceList *list, bool json, char *buffer, size_t bufferSize) {
+    size_t length = 0;
+
+    buffer[0] = '\0';
+    if (json) length += snprintf(buffer, bufferSize, "[");
+    for (UInt32 i = 0; i < list->count && length < bufferSize; i++) {
+        if (json) {
+            length += snprintf(buffer + length, bufferSize - length, "%s\"%s\"", i ? ", " : "", list->names[i]);
+        } else {
+            length += snprintf(buffer + length, bufferSize - length, "%s%s", i ? "|" : "", list->names[i]);
+        }
+    }
+    if (json && length < bufferSize) snprintf(buffer + length, bufferSize - length, "]");
+}
+
+void showDataSources(AudioDeviceID deviceID, ASDeviceType typeRequested, ASOutputType outputRequested) {
+    ASDataSourceList list;
+    char deviceName[256];
+
+    getDeviceName(deviceID, deviceName);
+    if (getDataSources(deviceID, getDataSourceScope(typeRequested), &list) == 0 && outputRequested == kFormatHuman) {
+        printf("%s audio device \"%s\" has no data sources\n", deviceTypeName(typeRequested), deviceName);
+        return;
+    }
+
+    for (UInt32 i = 0; i < list.count; i++) {
+        bool current = (list.ids[i] == list.currentID);
+        switch (outputRequested) {
+            case kFormatCLI:
+                printf("%s,%s,%s,%u,%d\n", deviceName, deviceTypeName(typeRequested), list.names[i], list.ids[i], current);
+                break;
+            case kFormatJSON:
+                printf("{\"device\": \"%s\", \"type\": \"%s\", \"name\": \"%s\", \"id\": \"%u\", \"current\": %s}\n",
+                       deviceName, deviceTypeName(typeRequested), list.names[i], list.ids[i], current ? "true" : "false");
+                break;
+            default:
+                printf("%s%s\n", list.names[i], current ? " (current)" : "");
+                break;
+        }
+    }
+}
+
+int setDeviceDataSource(AudioDeviceID deviceID, ASDeviceType typeRequested, const char *requestedSourceName, ASOutputType outputRequested) {
+    AudioObjectPropertyScope scope = getDataSourceScope(typeRequested);
+    AudioObjectPropertyAddress propertyAddress = {kAudioDevicePropertyDataSource, scope, kAudioObjectPropertyElementMain};
+    ASDataSourceList list;
+    char deviceName[256];
+    UInt32 sourceID;
+    Boolean settable = false;
+
+    getDeviceName(deviceID, deviceName);
+    getDataSources(deviceID, scope, &list);
+    if (!getRequestedDataSourceID(&list, requestedSourceName, &sourceID)) {
+        printf("Could not find a data source named \"%s\" on %s audio device \"%s\".  Nothing was changed.\n", requestedSourceName, deviceTypeName(typeRequested), deviceName);
+        return 1;
+    }
+    if (AudioObjectIsPropertySettable(deviceID, &propertyAddress, &settable) != noErr || !settable) {
+        printf("The data source of %s audio device \"%s\" cannot be changed.\n", deviceTypeName(typeRequested), deviceName);
+        return 1;
+    }
+
+    if (sourceID != list.currentID) {
+        OSStatus status = setPropertyAndWait(deviceID, &propertyAddress, sizeof(sourceID), &sourceID, getSwitchTimeout(), NULL);
+        if (status != noErr) {
+            printf("Failed setting data source \"%s\". Error: %d (%s)\n", requestedSourceName, status, describeStatus(status));
+            return status == kASPropertyChangeTimeoutError ? 2 : 1;
+        }
+    }
+
+    switch (outputRequested) {
+        case kFormatCLI:
+            printf("%s,%s,%s,%u\n", deviceName, deviceTypeName(typeRequested), requestedSourceName, sourceID);
+            break;
+        case kFormatJSON:
+            printf("{\"device\": \"%s\", \"type\": \"%s\", \"name\": \"%s\", \"id\": \"%u\"}\n", deviceName, deviceTypeName(typeRequested), requestedSourceName, sourceID);
+            break;
+        default:
+            printf("%s data source of \"%s\" set to \"%s\"\n", deviceTypeName(typeRequested), deviceName, requestedSourceName);
+            break;
+    }
+    return 0;
+}
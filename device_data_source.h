@@ -0,0 +1,37 @@
+/*
+ *  device_data_source.h
+ *  AudioSwitcher
+ *
+ *  Data sources are the ports of a single device, such as the internal
+ *  speakers and the headphone jack of a built-in output, or line in and
+ *  the microphone of a built-in input.  Switching between them changes
+ *  kAudioDevicePropertyDataSource of the device rather than the default
+ *  device.
+ *
+ *  MIT License, see license.txt
+ */
+
+#ifndef DEVICE_DATA_SOURCE_H
+#define DEVICE_DATA_SOURCE_H
+
+#include "audio_switch.h"
+
+#define MAX_DATA_SOURCES 8
+
+typedef struct {
+	UInt32 count;
+	UInt32 currentID;
+	UInt32 ids[MAX_DATA_SOURCES];
+	char names[MAX_DATA_SOURCES][64];
+} ASDataSourceList;
+
+AudioObjectPropertyScope getDataSourceScope(ASDeviceType typeRequested);
+void getDataSourceName(AudioDeviceID deviceID, AudioObjectPropertyScope scope, UInt32 sourceID, char *name, size_t nameSize);
+void getCurrentDataSourceName(AudioDeviceID deviceID, AudioObjectPropertyScope scope, char *name, size_t nameSize);
+UInt32 getDataSources(AudioDeviceID deviceID, AudioObjectPropertyScope scope, ASDataSourceList *list);
+bool getRequestedDataSourceID(const ASDataSourceList *list, const char *requestedSourceName, UInt32 *sourceID);
+void formatDataSources(const ASDataSourceList *list, bool json, char *buffer, size_t bufferSize);
+void showDataSources(AudioDeviceID deviceID, ASDeviceType typeRequested, ASOutputType outputRequested);
+int setDeviceDataSource(AudioDeviceID deviceID, ASDeviceType typeRequested, const char *requestedSourceName, ASOutputType outputRequested);
+
+#endif
@@ -0,0 +1,159 @@
+/*
+ *  device_hog.c
+ *  AudioSwitcher
+ *
+ *  MIT License, see license.txt
+ */
+
+#include "device_hog.h"
+#include <errno.h>
+#include <libproc.h>
+#include <mach/mach_time.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HOG_POLL_MICROS 1000
+
+// Hog mode belongs to the process that takes it, which is then the only one
+// allowed to do IO on the device, so it cannot be taken on behalf of another
+// process: that process would be locked out with everyone else.  "self" is
+// the only target.
+bool parseHogTarget(const char *target) {
+    return strcmp(target, "self") == 0;
+}
+
+pid_t getDeviceHogOwner(AudioDeviceID deviceID) {
+    AudioObjectPropertyAddress propertyAddress = {kAudioDevicePropertyHogMode, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain};
+    pid_t owner = kNoHogOwner;
+    UInt32 dataSize = sizeof(owner);
+
+    if (AudioObjectGetPropertyData(deviceID, &propertyAddress, 0, NULL, &dataSize, &owner) != noErr) {
+        return kNoHogOwner;
+    }
+    return owner;
+}
+
+// Setting the hog mode property toggles it for the calling process: it is
+// taken when free and released when this process holds it, whatever value
+// is written.
+OSStatus claimDeviceHog(AudioDeviceID deviceID) {
+    AudioObjectPropertyAddress propertyAddress = {kAudioDevicePropertyHogMode, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain};
+    pid_t self = getpid();
+    pid_t owner = getDeviceHogOwner(deviceID);
+
+    if (owner == self) {
+        return noErr;
+    }
+    if (owner != kNoHogOwner) {
+        return kAudioDevicePermissionsError;
+    }
+    return setPropertyAndWait(deviceID, &propertyAddress, sizeof(self), &self, getSwitchTimeout(), NULL);
+}
+
+OSStatus releaseOwnDeviceHog(AudioDeviceID deviceID) {
+    AudioObjectPropertyAddress propertyAddress = {kAudioDevicePropertyHogMode, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain};
+    pid_t self = getpid();
+
+    if (getDeviceHogOwner(deviceID) != self) {
+        return noErr;
+    }
+    return AudioObjectSetPropertyData(deviceID, &propertyAddress, 0, NULL, sizeof(self), &self);
+}
+
+static void showHogOwner(AudioDeviceID deviceID, pid_t owner, ASOutputType outputRequested) {
+    char deviceName[256];
+
+    getDeviceName(deviceID, deviceName);
+    switch (outputRequested) {
+        case kFormatCLI:
+            printf("%s,%u,%d\n", deviceName, deviceID, owner);
+            break;
+        case kFormatJSON:
+            printf("{\"name\": \"%s\", \"id\": \"%u\", \"hog_owner\": %d}\n", deviceName, deviceID, owner);
+            break;
+        default:
+            if (owner == kNoHogOwner) {
+                printf("\"%s\" is not hogged\n", deviceName);
+            } else {
+                printf("\"%s\" hogged by process %d\n", deviceName, owner);
+            }
+            break;
+    }
+    fflush(stdout);
+}
+
+// Takes hog mode on the device and keeps it until this process is
+// interrupted or terminated, then gives it back.
+int holdDeviceHog(AudioDeviceID deviceID, ASOutputType outputRequested) {
+    sigset_t signals;
+    int received;
+    OSStatus status;
+
+    // the signals are waited for instead of killing the process, so hog
+    // mode is released before exiting
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGHUP);
+    sigprocmask(SIG_BLOCK, &signals, NULL);
+
+    status = claimDeviceHog(deviceID);
+    if (status != noErr) {
+        pid_t owner = getDeviceHogOwner(deviceID);
+        if (owner != kNoHogOwner && owner != getpid()) {
+            printf("Device %u is already hogged by process %d.\n", deviceID, owner);
+        } else {
+            printf("Could not hog device %u. Error: %d (%s)\n", deviceID, status, describeStatus(status));
+        }
+        return status == kASPropertyChangeTimeoutError ? 2 : 1;
+    }
+    showHogOwner(deviceID, getpid(), outputRequested);
+
+    sigwait(&signals, &received);
+
+    releaseOwnDeviceHog(deviceID);
+    return 0;
+}
+
+// Hog mode can only be given back by the process holding it, so a device
+// held by another SwitchAudioSource is released by ending that process.
+// Devices hogged by other applications are left alone.
+int releaseDeviceHog(AudioDeviceID deviceID, ASOutputType outputRequested) {
+    char ownerName[256] = "";
+    mach_timebase_info_data_t timebase;
+    pid_t owner = getDeviceHogOwner(deviceID);
+
+    if (owner == kNoHogOwner) {
+        showHogOwner(deviceID, owner, outputRequested);
+        return 0;
+    }
+    if (owner == getpid()) {
+        releaseOwnDeviceHog(deviceID);
+        showHogOwner(deviceID, getDeviceHogOwner(deviceID), outputRequested);
+        return 0;
+    }
+
+    proc_name(owner, ownerName, sizeof(ownerName));
+    if (strcmp(ownerName, getprogname()) != 0) {
+        printf("Device %u is hogged by process %d (%s), which has to release it itself.\n", deviceID, owner, ownerName[0] ? ownerName : "unknown");
+        return 1;
+    }
+    if (kill(owner, SIGTERM) != 0) {
+        printf("Could not stop process %d: %s\n", owner, strerror(errno));
+        return 1;
+    }
+
+    mach_timebase_info(&timebase);
+    UInt64 deadline = mach_absolute_time() + (UInt64)getSwitchTimeout() * 1000000ULL * timebase.denom / timebase.numer;
+    while ((owner = getDeviceHogOwner(deviceID)) != kNoHogOwner && mach_absolute_time() < deadline) {
+        usleep(HOG_POLL_MICROS);
+    }
+    if (owner != kNoHogOwner) {
+        printf("Device %u was not released within %u ms.\n", deviceID, getSwitchTimeout());
+        return 2;
+    }
+    showHogOwner(deviceID, owner, outputRequested);
+    return 0;
+}
@@ -0,0 +1,32 @@
+/*
+ *  device_hog.h
+ *  AudioSwitcher
+ *
+ *  Exclusive access (hog mode) to a device.  While a process hogs a device
+ *  no other process can do IO on it, so nothing is mixed into its signal
+ *  and the system mixer is out of the path.
+ *
+ *  The HAL gives hog mode to the process that sets it and takes it back
+ *  when that process exits.  Only the holder may do IO on the device, so
+ *  --hog takes it for the SwitchAudioSource process itself, which stays
+ *  running to keep it; it cannot hold a device for another application.
+ *
+ *  MIT License, see license.txt
+ */
+
+#ifndef DEVICE_HOG_H
+#define DEVICE_HOG_H
+
+#include "audio_switch.h"
+
+// value of kAudioDevicePropertyHogMode when no process hogs the device
+#define kNoHogOwner ((pid_t)-1)
+
+bool parseHogTarget(const char *target);
+pid_t getDeviceHogOwner(AudioDeviceID deviceID);
+OSStatus claimDeviceHog(AudioDeviceID deviceID);
+OSStatus releaseOwnDeviceHog(AudioDeviceID deviceID);
+int holdDeviceHog(AudioDeviceID deviceID, ASOutputType outputRequested);
+int releaseDeviceHog(AudioDeviceID deviceID, ASOutputType outputRequested);
+
+#endif
@@ -0,0 +1,200 @@
+/*
+ *  device_name_index.c
+ *  AudioSwitcher
+ *
+ *  MIT License, see license.txt
+ */
+
+#include "device_name_index.h"
+#include "device_shm.h"
+#include "device_snapshot.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#define NANOS_PER_SECOND 1000000000ULL
+
+static UInt64 wallClockNanos(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return (UInt64)now.tv_sec * NANOS_PER_SECOND + now.tv_nsec;
+}
+
+static void getIndexPath(char *path, size_t pathSize) {
+    const char *directory = getenv("TMPDIR");
+    snprintf(path, pathSize, "%s/SwitchAudioSource.names.%u", directory ? directory : "/tmp", (unsigned int)getuid());
+}
+
+static const ASNameIndex *mapNameIndex(void) {
+    char path[1024];
+    struct stat status;
+
+    getIndexPath(path, sizeof(path));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (fstat(fd, &status) != 0 || status.st_size < (off_t)sizeof(ASNameIndex)) {
+        close(fd);
+        return NULL;
+    }
+    const ASNameIndex *mapped = mmap(NULL, sizeof(ASNameIndex), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        return NULL;
+    }
+    if (mapped->magic != NAME_INDEX_MAGIC || mapped->version != NAME_INDEX_VERSION || mapped->count > NAME_INDEX_MAX_DEVICES) {
+        munmap((void *)mapped, sizeof(ASNameIndex));
+        return NULL;
+    }
+    return mapped;
+}
+
+static int compareEntryNames(const void *a, const void *b) {
+    return strcmp(((const ASIndexEntry *)a)->name, ((const ASIndexEntry *)b)->name);
+}
+
+void sortNameIndex(ASNameIndex *index) {
+    qsort(index->entries, index->count, sizeof(ASIndexEntry), compareEntryNames);
+
+    // an insertion sort is plenty for a few dozen devices
+    for (UInt16 i = 0; i < index->count; i++) {
+        UInt16 j = i;
+        for (; j > 0 && strcmp(index->entries[index->byUID[j - 1]].uid, index->entries[i].uid) > 0; j--) {
+            index->byUID[j] = index->byUID[j - 1];
+        }
+        index->byUID[j] = i;
+    }
+}
+
+// Fills the index from the HAL.  Only names, uids and directions are asked
+// for; AirPlay receivers found over DNS-SD cannot be selected by name, so
+// they are left out.
+static void buildNameIndex(ASNameIndex *index, UInt64 deviceDigest) {
+    ASDeviceSnapshot snapshot;
+
+    memset(index, 0, sizeof(*index));
+    if (loadDeviceSnapshot(&snapshot) == noErr) {
+        for (int i = 0; i < snapshot.count && index->count < NAME_INDEX_MAX_DEVICES; i++) {
+            ASDeviceInfo *info = getDeviceInfo(&snapshot, i, kFieldName | kFieldUID);
+            ASIndexEntry *entry = &index->entries[index->count++];
+            entry->flags = (isAnInputDevice(info->deviceID) ? kIndexInput : 0) | (isAnOutputDevice(info->deviceID) ? kIndexOutput : 0);
+            snprintf(entry->name, sizeof(entry->name), "%s", info->name);
+            snprintf(entry->uid, sizeof(entry->uid), "%s", info->uid);
+        }
+    }
+    sortNameIndex(index);
+
+    index->magic = NAME_INDEX_MAGIC;
+    index->version = NAME_INDEX_VERSION;
+    index->builtNanos = wallClockNanos();
+    index->deviceDigest = deviceDigest;
+}
+
+// Replaces the index file in one rename, so readers see either the old
+// index or the new one.  Without a writable file completion still works,
+// it just asks the HAL every time.
+static void writeNameIndex(const ASNameIndex *index) {
+    char path[1024];
+    char temporaryPath[1100];
+
+    getIndexPath(path, sizeof(path));
+    snprintf(temporaryPath, sizeof(temporaryPath), "%s.%d", path, (int)getpid());
+    int fd = open(temporaryPath, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        return;
+    }
+    bool written = write(fd, index, sizeof(*index)) == (ssize_t)sizeof(*index);
+    close(fd);
+    if (!written || rename(temporaryPath, path) != 0) {
+        unlink(temporaryPath);
+    }
+}
+
+static bool isIndexStale(const ASNameIndex *index, UInt64 now, UInt64 deviceDigest) {
+    return index->deviceDigest != deviceDigest || now < index->builtNanos ||
+        now - index->builtNanos > NAME_INDEX_MAX_AGE_SECONDS * NANOS_PER_SECOND;
+}
+
+static const ASIndexEntry *getIndexEntry(const ASNameIndex *index, UInt32 position, bool completeUIDs) {
+    return &index->entries[completeUIDs ? index->byUID[position] : position];
+}
+
+// Prints each distinct name (or uid) of a device of the wanted directions
+// that starts with prefix, in order, and returns how many were printed.
+int printNameCompletions(const ASNameIndex *index, const char *prefix, UInt32 wantedFlags, bool completeUIDs) {
+    size_t length = strlen(prefix);
+    UInt32 low = 0;
+    UInt32 high = index->count;
+    const char *previous = NULL;
+    int printed = 0;
+
+    // the first entry not ordered before the prefix
+    while (low < high) {
+        UInt32 middle = (low + high) / 2;
+        const ASIndexEntry *entry = getIndexEntry(index, middle, completeUIDs);
+        if (strncmp(completeUIDs ? entry->uid : entry->name, prefix, length) < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    for (UInt32 i = low; i < index->count; i++) {
+        const ASIndexEntry *entry = getIndexEntry(index, i, completeUIDs);
+        const char *key = completeUIDs ? entry->uid : entry->name;
+
+        if (strncmp(key, prefix, length) != 0) break;
+        if (!(entry->flags & wantedFlags) || key[0] == '\0') continue;
+        if (previous != NULL && strcmp(previous, key) == 0) continue;
+        printf("%s\n", key);
+        previous = key;
+        printed++;
+    }
+    return printed;
+}
+
+int showCompletions(const char *prefix, ASDeviceType typeRequested, bool completeUIDs) {
+    static ASNameIndex rebuilt;
+    UInt64 deviceDigest = 0;
+    UInt64 now = wallClockNanos();
+    UInt32 wantedFlags;
+
+    switch (typeRequested) {
+        case kAudioTypeInput:
+            wantedFlags = kIndexInput;
+            break;
+        case kAudioTypeAll:
+            wantedFlags = kIndexInput | kIndexOutput;
+            break;
+        default:
+            wantedFlags = kIndexOutput;
+            break;
+    }
+
+    if (!readSharedDeviceDigest(&deviceDigest)) {
+        deviceDigest = 0;
+    }
+    const ASNameIndex *index = mapNameIndex();
+    if (index != NULL && !isIndexStale(index, now, deviceDigest)) {
+        if (printNameCompletions(index, prefix, wantedFlags, completeUIDs) > 0 ||
+            now - index->builtNanos < NAME_INDEX_MISS_REBUILD_SECONDS * NANOS_PER_SECOND) {
+            munmap((void *)index, sizeof(ASNameIndex));
+            return 0;
+        }
+        // nothing matched, perhaps a device that arrived after the index
+        // was built; nothing was printed, so the answer can start over
+    }
+    if (index != NULL) {
+        munmap((void *)index, sizeof(ASNameIndex));
+    }
+
+    buildNameIndex(&rebuilt, deviceDigest);
+    writeNameIndex(&rebuilt);
+    printNameCompletions(&rebuilt, prefix, wantedFlags, completeUIDs);
+    return 0;
+}
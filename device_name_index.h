@@ -0,0 +1,57 @@
+/*
+ *  device_name_index.h
+ *  AudioSwitcher
+ *
+ *  --complete: device names (or uids) starting with a prefix, for shell
+ *  completion, answered from a small index file instead of the HAL.
+ *
+ *  The index holds every device sorted by name, with a second order by uid,
+ *  so a prefix is found by binary search in the mapped file.  It is rebuilt
+ *  from the HAL when it is older than NAME_INDEX_MAX_AGE_SECONDS, when the
+ *  device table published by --publish no longer matches the one it was
+ *  built from, and when a prefix finds nothing in an index that is more
+ *  than a moment old, so a device plugged in just now completes too.  A
+ *  warm index answers without touching CoreAudio or DNS-SD.
+ *
+ *  MIT License, see license.txt
+ */
+
+#ifndef DEVICE_NAME_INDEX_H
+#define DEVICE_NAME_INDEX_H
+
+#include "audio_switch.h"
+
+#define NAME_INDEX_MAGIC 0x58444e41		// 'ANDX'
+#define NAME_INDEX_VERSION 1
+#define NAME_INDEX_MAX_DEVICES 64
+#define NAME_INDEX_MAX_AGE_SECONDS 60
+#define NAME_INDEX_MISS_REBUILD_SECONDS 2
+
+enum {
+	kIndexInput  = 1 << 0,
+	kIndexOutput = 1 << 1,
+};
+
+typedef struct {
+	UInt32 flags;			// kIndexInput, kIndexOutput
+	char name[256];
+	char uid[256];
+} ASIndexEntry;
+
+typedef struct {
+	UInt32 magic;
+	UInt32 version;
+	UInt64 builtNanos;		// since the epoch
+	UInt64 deviceDigest;	// of the published device table, 0 if none was published
+	UInt32 count;
+	UInt16 byUID[NAME_INDEX_MAX_DEVICES];		// entries in uid order
+	ASIndexEntry entries[NAME_INDEX_MAX_DEVICES];	// in name order
+} ASNameIndex;
+
+int showCompletions(const char *prefix, ASDeviceType typeRequested, bool completeUIDs);
+
+// the parts of an index lookup that need no HAL
+void sortNameIndex(ASNameIndex *index);
+int printNameCompletions(const ASNameIndex *index, const char *prefix, UInt32 wantedFlags, bool completeUIDs);
+
+#endif
@@ -0,0 +1,550 @@
+/*
+ *  device_records.c
+ *  AudioSwitcher
+ *
+ *  MIT License, see license.txt
+ */
+
+#include "device_records.h"
+#include "device_hog.h"
+#include <errno.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define RECORD_INITIAL_CAPACITY 4096
+#define MAX_RECORD_STRING 0xffff
+
+static const char *recordKindName(UInt32 kind) {
+    switch (kind) {
+        case kRecordDevice: return "device";
+        case kRecordCurrent: return "current";
+        default: return "unknown";
+    }
+}
+
+bool isRecordFormat(ASOutputType outputRequested) {
+    return outputRequested == kFormatBinary || outputRequested == kFormatMsgPack;
+}
+
+void initRecordWriter(ASRecordWriter *writer, ASOutputType format) {
+    memset(writer, 0, sizeof(*writer));
+    writer->format = format;
+}
+
+// Once the buffer cannot grow, nothing more is appended and the flush
+// writes nothing, so a reader never gets a record with bytes missing.
+static void appendBytes(ASRecordWriter *writer, const void *bytes, size_t size) {
+    if (writer->failed) return;
+    if (writer->length + size > writer->capacity) {
+        size_t capacity = writer->capacity ? writer->capacity : RECORD_INITIAL_CAPACITY;
+        while (capacity < writer->length + size) capacity *= 2;
+        UInt8 *data = realloc(writer->data, capacity);
+        if (data == NULL) {
+            writer->failed = true;
+            return;
+        }
+        writer->data = data;
+        writer->capacity = capacity;
+    }
+    memcpy(writer->data + writer->length, bytes, size);
+    writer->length += size;
+}
+
+static void appendByte(ASRecordWriter *writer, UInt8 byte) {
+    appendBytes(writer, &byte, 1);
+}
+
+// the binary encoding is little-endian, MessagePack is big-endian
+static void appendUInt(ASRecordWriter *writer, UInt64 value, int size, bool bigEndian) {
+    UInt8 bytes[8];
+    for (int i = 0; i < size; i++) {
+        bytes[bigEndian ? size - 1 - i : i] = (UInt8)(value >> (8 * i));
+    }
+    appendBytes(writer, bytes, size);
+}
+
+static void appendMsgPackString(ASRecordWriter *writer, const char *string) {
+    size_t length = strlen(string);
+    if (length > MAX_RECORD_STRING) length = MAX_RECORD_STRING;
+
+    if (length < 32) {
+        appendByte(writer, 0xa0 | (UInt8)length);
+    } else if (length < 256) {
+        appendByte(writer, 0xd9);
+        appendByte(writer, (UInt8)length);
+    } else {
+        appendByte(writer, 0xda);
+        appendUInt(writer, length, 2, true);
+    }
+    appendBytes(writer, string, length);
+}
+
+static void appendMsgPackUInt(ASRecordWriter *writer, UInt32 value) {
+    if (value < 128) {
+        appendByte(writer, (UInt8)value);
+    } else if (value < 256) {
+        appendByte(writer, 0xcc);
+        appendByte(writer, (UInt8)value);
+    } else if (value < 65536) {
+        appendByte(writer, 0xcd);
+        appendUInt(writer, value, 2, true);
+    } else {
+        appendByte(writer, 0xce);
+        appendUInt(writer, value, 4, true);
+    }
+}
+
+static void beginRecord(ASRecordWriter *writer, ASRecordKind kind) {
+    writer->recordStart = writer->length;
+    writer->fieldCount = 0;
+
+    if (writer->format == kFormatBinary) {
+        appendUInt(writer, 0, 4, false);
+        appendByte(writer, DEVICE_RECORD_VERSION);
+        appendByte(writer, (UInt8)kind);
+        writer->countOffset = writer->length;
+        appendByte(writer, 0);
+    } else {
+        appendByte(writer, 0x93);
+        appendMsgPackUInt(writer, DEVICE_RECORD_VERSION);
+        appendMsgPackString(writer, recordKindName(kind));
+        appendByte(writer, 0xde);
+        writer->countOffset = writer->length;
+        appendUInt(writer, 0, 2, true);
+    }
+}
+
+static void endRecord(ASRecordWriter *writer) {
+    if (writer->failed) return;
+
+    if (writer->format == kFormatBinary) {
+        UInt32 length = (UInt32)(writer->length - writer->recordStart - 4);
+        for (int i = 0; i < 4; i++) {
+            writer->data[writer->recordStart + i] = (UInt8)(length >> (8 * i));
+        }
+        writer->data[writer->countOffset] = (UInt8)writer->fieldCount;
+    } else {
+        writer->data[writer->countOffset] = (UInt8)(writer->fieldCount >> 8);
+        writer->data[writer->countOffset + 1] = (UInt8)writer->fieldCount;
+    }
+}
+
+// In the binary encoding every value is preceded by its length, filled in
+// by endField, so decoders can step over types they do not know.
+static void beginField(ASRecordWriter *writer, ASDeviceField field, ASRecordValueType type) {
+    writer->fieldCount++;
+    if (writer->format == kFormatBinary) {
+        appendByte(writer, (UInt8)__builtin_ctz(field));
+        appendByte(writer, (UInt8)type);
+        appendUInt(writer, 0, 2, false);
+        writer->valueOffset = writer->length;
+    } else {
+        appendMsgPackString(writer, deviceFieldName(field));
+    }
+}
+
+static void endField(ASRecordWriter *writer) {
+    if (writer->format != kFormatBinary || writer->failed) return;
+
+    size_t length = writer->length - writer->valueOffset;
+    writer->data[writer->valueOffset - 2] = (UInt8)length;
+    writer->data[writer->valueOffset - 1] = (UInt8)(length >> 8);
+}
+
+static void writeUInt32Field(ASRecordWriter *writer, ASDeviceField field, UInt32 value) {
+    beginField(writer, field, kValueUInt32);
+    if (writer->format == kFormatBinary) {
+        appendUInt(writer, value, 4, false);
+    } else {
+        appendMsgPackUInt(writer, value);
+    }
+    endField(writer);
+}
+
+static void writeInt32Field(ASRecordWriter *writer, ASDeviceField field, SInt32 value) {
+    beginField(writer, field, kValueInt32);
+    if (writer->format == kFormatBinary) {
+        appendUInt(writer, (UInt32)value, 4, false);
+    } else if (value >= 0) {
+        appendMsgPackUInt(writer, (UInt32)value);
+    } else if (value >= -32) {
+        appendByte(writer, (UInt8)value);
+    } else {
+        appendByte(writer, 0xd2);
+        appendUInt(writer, (UInt32)value, 4, true);
+    }
+    endField(writer);
+}
+
+static void writeFloat64Field(ASRecordWriter *writer, ASDeviceField field, Float64 value) {
+    UInt64 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    beginField(writer, field, kValueFloat64);
+    if (writer->format == kFormatMsgPack) {
+        appendByte(writer, 0xcb);
+    }
+    appendUInt(writer, bits, 8, writer->format == kFormatMsgPack);
+    endField(writer);
+}
+
+static void writeBoolField(ASRecordWriter *writer, ASDeviceField field, bool value) {
+    beginField(writer, field, kValueBool);
+    if (writer->format == kFormatBinary) {
+        appendByte(writer, value ? 1 : 0);
+    } else {
+        appendByte(writer, value ? 0xc3 : 0xc2);
+    }
+    endField(writer);
+}
+
+static void writeStringField(ASRecordWriter *writer, ASDeviceField field, const char *value) {
+    beginField(writer, field, kValueString);
+    if (writer->format == kFormatBinary) {
+        size_t length = strlen(value);
+        if (length > MAX_RECORD_STRING) length = MAX_RECORD_STRING;
+        appendBytes(writer, value, length);
+    } else {
+        appendMsgPackString(writer, value);
+    }
+    endField(writer);
+}
+
+static void writeNullField(ASRecordWriter *writer, ASDeviceField field) {
+    beginField(writer, field, kValueNull);
+    if (writer->format == kFormatMsgPack) {
+        appendByte(writer, 0xc0);
+    }
+    endField(writer);
+}
+
+// Appends one record with the already-loaded fields of a device.  Latency
+// and data source are those of the scope of deviceType, as in the text
+// formats.
+void writeDeviceRecord(ASRecordWriter *writer, ASRecordKind kind, const ASDeviceInfo *info, UInt32 fields, ASDeviceType deviceType) {
+    bool input = (deviceType == kAudioTypeInput);
+
+    beginRecord(writer, kind);
+    for (UInt32 field = 1; field <= fields; field <<= 1) {
+        if (!(fields & field)) continue;
+
+        switch ((ASDeviceField)field) {
+            case kFieldName:
+                writeStringField(writer, field, info->name);
+                break;
+            case kFieldType:
+                writeStringField(writer, field, deviceTypeName(deviceType));
+                break;
+            case kFieldID:
+                writeUInt32Field(writer, field, info->deviceID);
+                break;
+            case kFieldUID:
+                writeStringField(writer, field, info->uid);
+                break;
+            case kFieldTransport:
+                writeStringField(writer, field, transportTypeName(info->transportType));
+                break;
+            case kFieldInputChannels:
+                writeUInt32Field(writer, field, info->inputChannels);
+                break;
+            case kFieldOutputChannels:
+                writeUInt32Field(writer, field, info->outputChannels);
+                break;
+            case kFieldSampleRate:
+                writeFloat64Field(writer, field, info->sampleRate);
+                break;
+            case kFieldLatency:
+                writeUInt32Field(writer, field, input ? info->inputLatency : info->outputLatency);
+                break;
+            case kFieldAlive:
+                writeBoolField(writer, field, info->isAlive);
+                break;
+            case kFieldRunning:
+                writeBoolField(writer, field, info->isRunning);
+                break;
+            case kFieldHidden:
+                writeBoolField(writer, field, info->isHidden);
+                break;
+            case kFieldAggregate:
+                writeUInt32Field(writer, field, info->aggregateID);
+                break;
+            case kFieldDataSource:
+                writeStringField(writer, field, input ? info->inputDataSource : info->outputDataSource);
+                break;
+            case kFieldHogOwner:
+                if (info->hogOwner == kNoHogOwner) {
+                    writeNullField(writer, field);
+                } else {
+                    writeInt32Field(writer, field, info->hogOwner);
+                }
+                break;
+            case kFieldDataSources: {
+                char names[MAX_DATA_SOURCES * 66];
+                formatDataSources(input ? &info->inputDataSources : &info->outputDataSources, false, names, sizeof(names));
+                writeStringField(writer, field, names);
+                break;
+            }
+            default:
+                break;
+        }
+    }
+    endRecord(writer);
+}
+
+// Writes out everything appended so far with one write, retrying only what
+// a short write left over.  If the records could not all be built, nothing
+// is written.
+int flushRecordWriter(ASRecordWriter *writer) {
+    size_t written = 0;
+    int result = 0;
+
+    if (writer->failed) {
+        fprintf(stderr, "Out of memory while building the records.  Nothing was written.\n");
+        result = 1;
+    }
+    while (result == 0 && written < writer->length) {
+        ssize_t count = write(STDOUT_FILENO, writer->data + written, writer->length - written);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            result = 1;
+            break;
+        }
+        written += count;
+    }
+    free(writer->data);
+    initRecordWriter(writer, writer->format);
+    return result;
+}
+
+// The reference decoder: reads records of either encoding and prints each
+// as a line of JSON with typed values.
+
+static void printJSONString(const UInt8 *bytes, size_t length) {
+    putchar('"');
+    for (size_t i = 0; i < length; i++) {
+        if (bytes[i] == '"' || bytes[i] == '\\') {
+            printf("\\%c", bytes[i]);
+        } else if (bytes[i] < 0x20) {
+            printf("\\u%04x", bytes[i]);
+        } else {
+            putchar(bytes[i]);
+        }
+    }
+    putchar('"');
+}
+
+// JSON has no NaN or infinities
+static void printJSONNumber(Float64 value) {
+    if (isfinite(value)) {
+        printf("%.17g", value);
+    } else {
+        printf("null");
+    }
+}
+
+static UInt64 readUInt(const UInt8 *bytes, int size, bool bigEndian) {
+    UInt64 value = 0;
+    for (int i = 0; i < size; i++) {
+        value |= (UInt64)bytes[bigEndian ? size - 1 - i : i] << (8 * i);
+    }
+    return value;
+}
+
+// Prints a binary record as a line of JSON, leaving out fields whose number
+// or value type it does not know.  Returns 1 if the record is malformed.
+static int decodeBinaryRecord(const UInt8 *record, size_t length) {
+    size_t offset = 3;
+    int result = 0;
+
+    if (length < 3 || record[0] != DEVICE_RECORD_VERSION) {
+        return 1;
+    }
+    printf("{\"kind\": \"%s\"", recordKindName(record[1]));
+    for (UInt32 i = 0; i < record[2]; i++) {
+        if (offset + 4 > length) {
+            result = 1;
+            break;
+        }
+        UInt8 bit = record[offset];
+        UInt8 type = record[offset + 1];
+        size_t size = readUInt(record + offset + 2, 2, false);
+        const char *name = bit < 32 ? deviceFieldName((ASDeviceField)(1u << bit)) : "unknown";
+        size_t expected;
+        offset += 4;
+        if (offset + size > length) {
+            result = 1;
+            break;
+        }
+
+        switch (type) {
+            case kValueNull: expected = 0; break;
+            case kValueUInt32:
+            case kValueInt32: expected = 4; break;
+            case kValueFloat64: expected = 8; break;
+            case kValueBool: expected = 1; break;
+            case kValueString: expected = size; break;
+            default: expected = SIZE_MAX; break;
+        }
+        if (expected == SIZE_MAX || strcmp(name, "unknown") == 0) {
+            offset += size;
+            continue;
+        }
+        if (size != expected) {
+            result = 1;
+            break;
+        }
+
+        printf(", \"%s\": ", name);
+        switch (type) {
+            case kValueNull:
+                printf("null");
+                break;
+            case kValueUInt32:
+                printf("%u", (UInt32)readUInt(record + offset, 4, false));
+                break;
+            case kValueInt32:
+                printf("%d", (SInt32)readUInt(record + offset, 4, false));
+                break;
+            case kValueFloat64: {
+                UInt64 bits = readUInt(record + offset, 8, false);
+                Float64 value;
+                memcpy(&value, &bits, sizeof(value));
+                printJSONNumber(value);
+                break;
+            }
+            case kValueBool:
+                printf("%s", record[offset] ? "true" : "false");
+                break;
+            case kValueString:
+                printJSONString(record + offset, size);
+                break;
+        }
+        offset += size;
+    }
+    printf("}\n");
+    return result;
+}
+
+// Prints one MessagePack value of the kinds the encoder writes.  Returns the
+// number of bytes it took, or 0 when it is malformed or of another kind.
+static size_t decodeMsgPackValue(const UInt8 *bytes, size_t length, bool asKey) {
+    UInt8 tag;
+    size_t size;
+
+    if (length == 0) return 0;
+    tag = bytes[0];
+    if (tag < 0x80) {
+        printf("%u", tag);
+        return 1;
+    }
+    if (tag >= 0xe0) {
+        printf("%d", (SInt8)tag);
+        return 1;
+    }
+    if ((tag & 0xe0) == 0xa0 || tag == 0xd9 || tag == 0xda) {
+        size_t header = (tag & 0xe0) == 0xa0 ? 1 : (tag == 0xd9 ? 2 : 3);
+        if (length < header) return 0;
+        size = (tag & 0xe0) == 0xa0 ? (tag & 0x1f) : readUInt(bytes + 1, (int)header - 1, true);
+        if (length < header + size) return 0;
+        printJSONString(bytes + header, size);
+        if (asKey) printf(": ");
+        return header + size;
+    }
+    switch (tag) {
+        case 0xc0: printf("null"); return 1;
+        case 0xc2: printf("false"); return 1;
+        case 0xc3: printf("true"); return 1;
+        case 0xcc: size = 1; break;
+        case 0xcd: size = 2; break;
+        case 0xce: size = 4; break;
+        case 0xd2: size = 4; break;
+        case 0xcb: size = 8; break;
+        default: return 0;
+    }
+    if (length < 1 + size) return 0;
+
+    UInt64 value = readUInt(bytes + 1, (int)size, true);
+    if (tag == 0xcb) {
+        Float64 number;
+        memcpy(&number, &value, sizeof(number));
+        printJSONNumber(number);
+    } else if (tag == 0xd2) {
+        printf("%d", (SInt32)value);
+    } else {
+        printf("%llu", (unsigned long long)value);
+    }
+    return 1 + size;
+}
+
+static size_t decodeMsgPackRecord(const UInt8 *bytes, size_t length) {
+    size_t offset = 2;
+
+    if (length < 3 || bytes[0] != 0x93 || bytes[1] != DEVICE_RECORD_VERSION) {
+        return 0;
+    }
+    printf("{\"kind\": ");
+    size_t used = decodeMsgPackValue(bytes + offset, length - offset, false);
+    if (used == 0 || offset + used + 3 > length || bytes[offset + used] != 0xde) {
+        printf("}\n");
+        return 0;
+    }
+    offset += used;
+    UInt32 count = (UInt32)readUInt(bytes + offset + 1, 2, true);
+    offset += 3;
+
+    for (UInt32 i = 0; i < count * 2; i++) {
+        if (i % 2 == 0) printf(", ");
+        used = decodeMsgPackValue(bytes + offset, length - offset, i % 2 == 0);
+        if (used == 0) {
+            printf("}\n");
+            return 0;
+        }
+        offset += used;
+    }
+    printf("}\n");
+    return offset;
+}
+
+int decodeRecords(FILE *input, ASOutputType format) {
+    UInt8 *data = NULL;
+    size_t length = 0;
+    size_t capacity = 0;
+    size_t offset = 0;
+
+    for (;;) {
+        if (length == capacity) {
+            capacity = capacity ? capacity * 2 : RECORD_INITIAL_CAPACITY;
+            UInt8 *grown = realloc(data, capacity);
+            if (grown == NULL) {
+                free(data);
+                return 1;
+            }
+            data = grown;
+        }
+        size_t count = fread(data + length, 1, capacity - length, input);
+        if (count == 0) break;
+        length += count;
+    }
+
+    while (offset < length) {
+        if (format == kFormatBinary) {
+            if (offset + 4 > length) break;
+            size_t recordLength = readUInt(data + offset, 4, false);
+            if (offset + 4 + recordLength > length || decodeBinaryRecord(data + offset + 4, recordLength) != 0) break;
+            offset += 4 + recordLength;
+        } else {
+            size_t used = decodeMsgPackRecord(data + offset, length - offset);
+            if (used == 0) break;
+            offset += used;
+        }
+    }
+    free(data);
+
+    if (offset != length) {
+        printf("Malformed record at byte %zu.\n", offset);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,66 @@
+/*
+ *  device_records.h
+ *  AudioSwitcher
+ *
+ *  Binary output for programs that read device listings and current-device
+ *  reports many times over.  Two encodings of the same versioned schema:
+ *
+ *  binary   every record is a little-endian UInt32 length followed by that
+ *           many bytes: schema version (UInt8), record kind (UInt8), field
+ *           count (UInt8), then per field its ASDeviceField bit number
+ *           (UInt8), value type (UInt8), value length (UInt16) and value.
+ *           Strings are UTF-8 bytes without a terminator.
+ *
+ *  msgpack  every record is a MessagePack array of the schema version, the
+ *           record kind ("device" or "current") and a map from --fields
+ *           names to values.
+ *
+ *  Fields are always written in ASDeviceField bit order, and decoders are
+ *  expected to skip field numbers and value types they do not know.  All
+ *  records of one listing go out in a single write.
+ *
+ *  MIT License, see license.txt
+ */
+
+#ifndef DEVICE_RECORDS_H
+#define DEVICE_RECORDS_H
+
+#include "audio_switch.h"
+#include "device_snapshot.h"
+#include <stdio.h>
+
+#define DEVICE_RECORD_VERSION 2
+
+typedef enum {
+	kRecordDevice  = 1,		// a row of -a
+	kRecordCurrent = 2,		// the report of -c
+} ASRecordKind;
+
+typedef enum {
+	kValueNull    = 0,
+	kValueUInt32  = 1,
+	kValueInt32   = 2,
+	kValueFloat64 = 3,
+	kValueBool    = 4,
+	kValueString  = 5,
+} ASRecordValueType;
+
+typedef struct {
+	ASOutputType format;	// kFormatBinary or kFormatMsgPack
+	UInt8 *data;
+	size_t length;
+	size_t capacity;
+	size_t recordStart;
+	size_t countOffset;		// where the field count of the open record goes
+	size_t valueOffset;		// where the value of the open field starts
+	UInt32 fieldCount;
+	bool failed;			// the buffer could not grow; nothing will be written
+} ASRecordWriter;
+
+bool isRecordFormat(ASOutputType outputRequested);
+void initRecordWriter(ASRecordWriter *writer, ASOutputType format);
+void writeDeviceRecord(ASRecordWriter *writer, ASRecordKind kind, const ASDeviceInfo *info, UInt32 fields, ASDeviceType deviceType);
+int flushRecordWriter(ASRecordWriter *writer);
+int decodeRecords(FILE *input, ASOutputType format);
+
+#endif
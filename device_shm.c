@@ -0,0 +1,315 @@
+/*
+ *  device_shm.c
+ *  AudioSwitcher
+ *
+ *  MIT License, see license.txt
+ */
+
+#include "device_shm.h"
+#include "device_snapshot.h"
+#include "device_records.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define SHARED_READ_ATTEMPTS 1000
+
+static pthread_mutex_t changeMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t changeCond = PTHREAD_COND_INITIALIZER;
+static bool stateChanged = true;
+
+static const ASDeviceType defaultTypes[3] = {kAudioTypeInput, kAudioTypeOutput, kAudioTypeSystemOutput};
+
+static int defaultIndex(ASDeviceType typeRequested) {
+    switch (typeRequested) {
+        case kAudioTypeInput: return 0;
+        case kAudioTypeSystemOutput: return 2;
+        default: return 1;
+    }
+}
+
+static OSStatus stateChangeListener(AudioObjectID objectID, UInt32 numberAddresses, const AudioObjectPropertyAddress *addresses, void *clientData) {
+    pthread_mutex_lock(&changeMutex);
+    stateChanged = true;
+    pthread_cond_signal(&changeCond);
+    pthread_mutex_unlock(&changeMutex);
+    return noErr;
+}
+
+static UInt32 getMuteState(AudioDeviceID deviceID, ASDeviceType typeRequested) {
+    AudioObjectPropertyAddress propertyAddress = {kAudioDevicePropertyMute, getScopeForDeviceType(typeRequested), kAudioObjectPropertyElementMain};
+    UInt32 muted = 0;
+    UInt32 dataSize = sizeof(muted);
+    AudioObjectGetPropertyData(deviceID, &propertyAddress, 0, NULL, &dataSize, &muted);
+    return muted;
+}
+
+// Moves the mute listeners from the previous default input and output
+// devices to the current ones.
+static void trackMuteListeners(AudioDeviceID *tracked, const ASSharedDefault *defaults) {
+    for (int i = 0; i < 2; i++) {
+        AudioObjectPropertyAddress propertyAddress = {kAudioDevicePropertyMute, getScopeForDeviceType(defaultTypes[i]), kAudioObjectPropertyElementMain};
+        if (tracked[i] == defaults[i].deviceID) continue;
+        if (tracked[i] != kAudioDeviceUnknown) {
+            AudioObjectRemovePropertyListener(tracked[i], &propertyAddress, stateChangeListener, NULL);
+        }
+        tracked[i] = defaults[i].deviceID;
+        if (tracked[i] != kAudioDeviceUnknown) {
+            AudioObjectAddPropertyListener(tracked[i], &propertyAddress, stateChangeListener, NULL);
+        }
+    }
+}
+
+// Gathers everything from the HAL first, so the window in which readers have
+// to retry only covers the copy into the segment.
+static void publishOnce(ASSharedState *state, AudioDeviceID *trackedMuteDevices) {
+    ASSharedDefault defaults[3];
+    ASSharedDevice devices[SHARED_STATE_MAX_DEVICES];
+    ASDeviceSnapshot snapshot;
+    UInt32 deviceCount = 0;
+
+    memset(defaults, 0, sizeof(defaults));
+    memset(devices, 0, sizeof(devices));
+
+    for (int i = 0; i < 3; i++) {
+        const char *uid;
+        defaults[i].deviceID = getCurrentlySelectedDeviceID(defaultTypes[i]);
+        getDeviceName(defaults[i].deviceID, defaults[i].name);
+        uid = getDeviceUID(defaults[i].deviceID);
+        snprintf(defaults[i].uid, sizeof(defaults[i].uid), "%s", uid);
+        if (uid[0] != '\0') free((void *)uid);
+        if (i < 2) defaults[i].muted = getMuteState(defaults[i].deviceID, defaultTypes[i]);
+    }
+
+    if (loadDeviceSnapshot(&snapshot) == noErr) {
+        for (int i = 0; i < snapshot.count && deviceCount < SHARED_STATE_MAX_DEVICES; i++) {
+            ASDeviceInfo *info = getDeviceInfo(&snapshot, i, kFieldName | kFieldUID);
+            ASSharedDevice *device = &devices[deviceCount++];
+            device->deviceID = info->deviceID;
+            device->isInput = isAnInputDevice(info->deviceID);
+            device->isOutput = isAnOutputDevice(info->deviceID);
+            snprintf(device->name, sizeof(device->name), "%s", info->name);
+            snprintf(device->uid, sizeof(device->uid), "%s", info->uid);
+        }
+    }
+
+    UInt32 sequence = state->sequence;
+    __atomic_store_n(&state->sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    memcpy(state->defaults, defaults, sizeof(defaults));
+    memcpy(state->devices, devices, sizeof(devices));
+    state->deviceCount = deviceCount;
+    state->updateCount++;
+
+    __atomic_store_n(&state->sequence, sequence + 2, __ATOMIC_RELEASE);
+
+    trackMuteListeners(trackedMuteDevices, defaults);
+}
+
+static bool isPublisherAlive(pid_t pid) {
+    return pid > 0 && (kill(pid, 0) == 0 || errno == EPERM);
+}
+
+// Runs until killed, republishing whenever a default device, the device
+// list, or the mute state of a default device changes.
+int publishDeviceState(void) {
+    const AudioObjectPropertySelector systemSelectors[] = {
+        kAudioHardwarePropertyDevices,
+        kAudioHardwarePropertyDefaultInputDevice,
+        kAudioHardwarePropertyDefaultOutputDevice,
+        kAudioHardwarePropertyDefaultSystemOutputDevice,
+    };
+    AudioDeviceID trackedMuteDevices[2] = {kAudioDeviceUnknown, kAudioDeviceUnknown};
+
+    int fd = shm_open(SHARED_STATE_NAME, O_RDWR | O_CREAT, 0644);
+    struct stat status;
+
+    // a segment left by a publisher of an older, smaller layout cannot be
+    // grown on macOS, so it is replaced; readers of that layout ignore the
+    // new one by its version
+    if (fd >= 0 && fstat(fd, &status) == 0 && status.st_size >= (off_t)offsetof(ASSharedState, sequence) && status.st_size < (off_t)sizeof(ASSharedState)) {
+        const ASSharedState *old = mmap(NULL, status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        pid_t oldPublisherPID = 0;
+        if (old != MAP_FAILED) {
+            if (old->magic == SHARED_STATE_MAGIC && isPublisherAlive(old->publisherPID)) oldPublisherPID = old->publisherPID;
+            munmap((void *)old, status.st_size);
+        }
+        close(fd);
+        if (oldPublisherPID != 0) {
+            printf("Device state is already being published by process %d.\n", oldPublisherPID);
+            return 1;
+        }
+        shm_unlink(SHARED_STATE_NAME);
+        fd = shm_open(SHARED_STATE_NAME, O_RDWR | O_CREAT, 0644);
+    }
+    if (fd < 0) {
+        printf("Could not open shared memory %s: %s\n", SHARED_STATE_NAME, strerror(errno));
+        return 1;
+    }
+    if (ftruncate(fd, sizeof(ASSharedState)) != 0 && errno != EINVAL) {
+        printf("Could not size shared memory %s: %s\n", SHARED_STATE_NAME, strerror(errno));
+        close(fd);
+        return 1;
+    }
+    ASSharedState *state = mmap(NULL, sizeof(ASSharedState), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (state == MAP_FAILED) {
+        printf("Could not map shared memory %s: %s\n", SHARED_STATE_NAME, strerror(errno));
+        return 1;
+    }
+
+    if (state->magic == SHARED_STATE_MAGIC && state->publisherPID != getpid() && isPublisherAlive(state->publisherPID)) {
+        printf("Device state is already being published by process %d.\n", state->publisherPID);
+        munmap(state, sizeof(ASSharedState));
+        return 1;
+    }
+
+    // readers ignore the segment until the magic and version match, and
+    // retry while the sequence is odd
+    __atomic_store_n(&state->sequence, state->sequence | 1, __ATOMIC_RELAXED);
+    state->magic = SHARED_STATE_MAGIC;
+    state->version = SHARED_STATE_VERSION;
+    state->publisherPID = getpid();
+    __atomic_store_n(&state->sequence, state->sequence + 1, __ATOMIC_RELEASE);
+
+    for (size_t i = 0; i < sizeof(systemSelectors) / sizeof(systemSelectors[0]); i++) {
+        AudioObjectPropertyAddress propertyAddress = {systemSelectors[i], kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain};
+        AudioObjectAddPropertyListener(kAudioObjectSystemObject, &propertyAddress, stateChangeListener, NULL);
+    }
+
+    printf("Publishing device state to %s\n", SHARED_STATE_NAME);
+    fflush(stdout);
+
+    for (;;) {
+        pthread_mutex_lock(&changeMutex);
+        while (!stateChanged) {
+            pthread_cond_wait(&changeCond, &changeMutex);
+        }
+        stateChanged = false;
+        pthread_mutex_unlock(&changeMutex);
+
+        publishOnce(state, trackedMuteDevices);
+    }
+
+    return 0;
+}
+
+static const ASSharedState *mapSharedState(void) {
+    static const ASSharedState *mapped = NULL;
+
+    if (mapped == NULL) {
+        int fd = shm_open(SHARED_STATE_NAME, O_RDONLY, 0);
+        if (fd < 0) {
+            return NULL;
+        }
+        void *address = mmap(NULL, sizeof(ASSharedState), PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (address == MAP_FAILED) {
+            return NULL;
+        }
+        mapped = address;
+    }
+    if (mapped->magic != SHARED_STATE_MAGIC || mapped->version != SHARED_STATE_VERSION || !isPublisherAlive(mapped->publisherPID)) {
+        return NULL;
+    }
+    return mapped;
+}
+
+// Copies the published default device of the given type.  Returns false
+// when nothing is being published, or the publisher kept the segment busy
+// for longer than a reader should spin.
+bool readSharedDefault(ASDeviceType typeRequested, ASSharedDefault *result) {
+    const ASSharedState *state = mapSharedState();
+    if (state == NULL) {
+        return false;
+    }
+
+    const ASSharedDefault *source = &state->defaults[defaultIndex(typeRequested)];
+    for (int attempt = 0; attempt < SHARED_READ_ATTEMPTS; attempt++) {
+        UInt32 before = __atomic_load_n(&state->sequence, __ATOMIC_ACQUIRE);
+        if (before & 1) continue;
+
+        memcpy(result, source, sizeof(*result));
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&state->sequence, __ATOMIC_RELAXED) == before) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Hashes the published device table, so a cache built from it can tell it
+// is out of date without asking the HAL.  Returns false when nothing is
+// being published, or the publisher kept the segment busy.
+bool readSharedDeviceDigest(UInt64 *digest) {
+    const ASSharedState *state = mapSharedState();
+    if (state == NULL) {
+        return false;
+    }
+
+    for (int attempt = 0; attempt < SHARED_READ_ATTEMPTS; attempt++) {
+        UInt32 before = __atomic_load_n(&state->sequence, __ATOMIC_ACQUIRE);
+        if (before & 1) continue;
+
+        // FNV-1a; unused bytes of each entry are always zero
+        UInt32 deviceCount = state->deviceCount < SHARED_STATE_MAX_DEVICES ? state->deviceCount : SHARED_STATE_MAX_DEVICES;
+        const UInt8 *bytes = (const UInt8 *)state->devices;
+        UInt64 hash = 14695981039346656037ULL ^ deviceCount;
+        for (size_t i = 0; i < deviceCount * sizeof(ASSharedDevice); i++) {
+            hash = (hash ^ bytes[i]) * 1099511628211ULL;
+        }
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&state->sequence, __ATOMIC_RELAXED) == before) {
+            // 0 stands for no publisher
+            *digest = hash ? hash : 1;
+            return true;
+        }
+    }
+    return false;
+}
+
+int showSharedCurrentDevice(ASDeviceType typeRequested, ASOutputType outputRequested) {
+    ASSharedDefault current;
+
+    if (!readSharedDefault(typeRequested, &current)) {
+        return 1;
+    }
+
+    switch(outputRequested) {
+        case kFormatHuman:
+            printf("%s\n", current.name);
+            break;
+        case kFormatCLI:
+            printf("%s,%s,%u,%s\n", current.name, deviceTypeName(typeRequested), current.deviceID, current.uid);
+            break;
+        case kFormatJSON:
+            printf("{\"name\": \"%s\", \"type\": \"%s\", \"id\": \"%u\", \"uid\": \"%s\"}\n", current.name, deviceTypeName(typeRequested), current.deviceID, current.uid);
+            break;
+        case kFormatBinary:
+        case kFormatMsgPack: {
+            ASDeviceInfo info;
+            ASRecordWriter writer;
+
+            memset(&info, 0, sizeof(info));
+            info.deviceID = current.deviceID;
+            memcpy(info.name, current.name, sizeof(current.name));
+            memcpy(info.uid, current.uid, sizeof(current.uid));
+
+            initRecordWriter(&writer, outputRequested);
+            writeDeviceRecord(&writer, kRecordCurrent, &info, kDefaultDeviceFields, typeRequested);
+            return flushRecordWriter(&writer);
+        }
+        default:
+            break;
+    }
+    return 0;
+}
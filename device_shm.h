@@ -0,0 +1,57 @@
+/*
+ *  device_shm.h
+ *  AudioSwitcher
+ *
+ *  Current defaults, mute states and the device table, published by a
+ *  long-running SwitchAudioSource into a fixed-layout shared memory segment
+ *  so that frequent readers (status bars, prompts) never touch CoreAudio.
+ *
+ *  The segment is guarded by a sequence lock: the single publisher makes
+ *  the sequence odd while it writes and even when it is done, and readers
+ *  retry a copy that overlapped a write.  Readers never block the publisher.
+ *
+ *  MIT License, see license.txt
+ */
+
+#ifndef DEVICE_SHM_H
+#define DEVICE_SHM_H
+
+#include "audio_switch.h"
+
+#define SHARED_STATE_NAME "/SwitchAudioSource.state"
+#define SHARED_STATE_MAGIC 0x53415353	// 'SASS'
+#define SHARED_STATE_VERSION 2
+#define SHARED_STATE_MAX_DEVICES 64
+
+typedef struct {
+	AudioDeviceID deviceID;
+	UInt32 muted;
+	char name[256];
+	char uid[256];
+} ASSharedDefault;
+
+typedef struct {
+	AudioDeviceID deviceID;
+	UInt32 isInput;
+	UInt32 isOutput;
+	char name[256];
+	char uid[256];
+} ASSharedDevice;
+
+typedef struct {
+	UInt32 magic;
+	UInt32 version;
+	pid_t publisherPID;
+	volatile UInt32 sequence;		// odd while the publisher is writing
+	UInt64 updateCount;
+	ASSharedDefault defaults[3];	// input, output, system
+	UInt32 deviceCount;
+	ASSharedDevice devices[SHARED_STATE_MAX_DEVICES];
+} ASSharedState;
+
+int publishDeviceState(void);
+bool readSharedDefault(ASDeviceType typeRequested, ASSharedDefault *result);
+bool readSharedDeviceDigest(UInt64 *digest);
+int showSharedCurrentDevice(ASDeviceType typeRequested, ASOutputType outputRequested);
+
+#endif
@@ -0,0 +1,328 @@
+/*
+ *  device_snapshot.c
+ *  AudioSwitcher
+ *
+ *  MIT License, see license.txt
+ */
+
+#include "device_snapshot.h"
+#include "device_hog.h"
+#include <stdio.h>
+#include <string.h>
+
+static const struct {
+    ASDeviceField field;
+    const char *name;
+} fieldNames[] = {
+    {kFieldName, "name"},
+    {kFieldType, "type"},
+    {kFieldID, "id"},
+    {kFieldUID, "uid"},
+    {kFieldTransport, "transport"},
+    {kFieldInputChannels, "input_channels"},
+    {kFieldOutputChannels, "output_channels"},
+    {kFieldSampleRate, "sample_rate"},
+    {kFieldLatency, "latency"},
+    {kFieldAlive, "alive"},
+    {kFieldRunning, "running"},
+    {kFieldHidden, "hidden"},
+    {kFieldAggregate, "aggregate"},
+    {kFieldDataSource, "data_source"},
+    {kFieldHogOwner, "hog_owner"},
+    {kFieldDataSources, "data_sources"},
+};
+
+static volatile UInt64 deviceListGeneration = 0;
+static bool trackingDeviceList = false;
+
+static OSStatus deviceListListener(AudioObjectID objectID, UInt32 numberAddresses, const AudioObjectPropertyAddress *addresses, void *clientData) {
+    __atomic_add_fetch(&deviceListGeneration, 1, __ATOMIC_RELEASE);
+    return noErr;
+}
+
+// Starts counting device list changes, so that anything resolved from the
+// list can later tell whether the list changed underneath it.  Returns the
+// current generation.
+UInt64 trackDeviceListGeneration(void) {
+    if (!trackingDeviceList) {
+        AudioObjectPropertyAddress propertyAddress = {kAudioHardwarePropertyDevices, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain};
+        trackingDeviceList = (AudioObjectAddPropertyListener(kAudioObjectSystemObject, &propertyAddress, deviceListListener, NULL) == noErr);
+    }
+    return getDeviceListGeneration();
+}
+
+UInt64 getDeviceListGeneration(void) {
+    return __atomic_load_n(&deviceListGeneration, __ATOMIC_ACQUIRE);
+}
+
+// Device ids are not reused while the HAL runs, so a device that is still
+// listed is the same device.  A list that cannot be read lists nothing.
+bool isDeviceListed(AudioDeviceID deviceID) {
+    AudioObjectPropertyAddress propertyAddress = {kAudioHardwarePropertyDevices, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain};
+    AudioDeviceID dev_array[MAX_SNAPSHOT_DEVICES];
+    UInt32 propertySize = sizeof(dev_array);
+
+    if (AudioObjectGetPropertyData(kAudioObjectSystemObject, &propertyAddress, 0, NULL, &propertySize, dev_array) != noErr) {
+        return false;
+    }
+    for (UInt32 i = 0; i < propertySize / sizeof(AudioDeviceID); i++) {
+        if (dev_array[i] == deviceID) return true;
+    }
+    return false;
+}
+
+OSStatus loadDeviceSnapshot(ASDeviceSnapshot *snapshot) {
+    AudioObjectPropertyAddress propertyAddress = {kAudioHardwarePropertyDevices, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain};
+    AudioDeviceID dev_array[MAX_SNAPSHOT_DEVICES];
+    UInt32 propertySize = sizeof(dev_array);
+
+    memset(snapshot, 0, sizeof(*snapshot));
+    snapshot->generation = getDeviceListGeneration();
+    OSStatus status = AudioObjectGetPropertyData(kAudioObjectSystemObject, &propertyAddress, 0, NULL, &propertySize, dev_array);
+    if (status != noErr) {
+        return status;
+    }
+
+    snapshot->count = propertySize / sizeof(AudioDeviceID);
+    for (int i = 0; i < snapshot->count; i++) {
+        snapshot->devices[i].deviceID = dev_array[i];
+    }
+    return noErr;
+}
+
+static UInt32 getUInt32Property(AudioDeviceID deviceID, AudioObjectPropertySelector selector, AudioObjectPropertyScope scope) {
+    AudioObjectPropertyAddress propertyAddress = {selector, scope, kAudioObjectPropertyElementMain};
+    UInt32 value = 0;
+    UInt32 dataSize = sizeof(value);
+    AudioObjectGetPropertyData(deviceID, &propertyAddress, 0, NULL, &dataSize, &value);
+    return value;
+}
+
+static UInt32 getChannelCount(AudioDeviceID deviceID, AudioObjectPropertyScope scope) {
+    AudioObjectPropertyAddress propertyAddress = {kAudioDevicePropertyStreamConfiguration, scope, kAudioObjectPropertyElementMain};
+    UInt32 dataSize = 0;
+    UInt32 channels = 0;
+
+    if (AudioObjectGetPropertyDataSize(deviceID, &propertyAddress, 0, NULL, &dataSize) != noErr || dataSize == 0) {
+        return 0;
+    }
+    AudioBufferList *bufferList = malloc(dataSize);
+    if (bufferList == NULL) {
+        return 0;
+    }
+    if (AudioObjectGetPropertyData(deviceID, &propertyAddress, 0, NULL, &dataSize, bufferList) == noErr) {
+        for (UInt32 i = 0; i < bufferList->mNumberBuffers; i++) {
+            channels += bufferList->mBuffers[i].mNumberChannels;
+        }
+    }
+    free(bufferList);
+    return channels;
+}
+
+// Aggregate membership can only be found from the aggregate's side, so the
+// sub-device lists of every aggregate are read once for the whole snapshot.
+static void loadAggregates(ASDeviceSnapshot *snapshot) {
+    for (int i = 0; i < snapshot->count; i++) {
+        ASDeviceInfo *aggregate = getDeviceInfo(snapshot, i, kFieldTransport);
+        if (aggregate->transportType != kAudioDeviceTransportTypeAggregate) continue;
+
+        AudioObjectPropertyAddress propertyAddress = {kAudioAggregateDevicePropertyActiveSubDeviceList, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain};
+        AudioObjectID subDevices[MAX_SNAPSHOT_DEVICES];
+        UInt32 dataSize = sizeof(subDevices);
+        if (AudioObjectGetPropertyData(aggregate->deviceID, &propertyAddress, 0, NULL, &dataSize, subDevices) != noErr) continue;
+
+        for (UInt32 j = 0; j < dataSize / sizeof(AudioObjectID); j++) {
+            for (int k = 0; k < snapshot->count; k++) {
+                if (snapshot->devices[k].deviceID == subDevices[j] && snapshot->devices[k].aggregateID == kAudioDeviceUnknown) {
+                    snapshot->devices[k].aggregateID = aggregate->deviceID;
+                }
+            }
+        }
+    }
+    snapshot->aggregatesLoaded = true;
+}
+
+// Returns the device at index with at least the given fields loaded,
+// fetching only those that have not been asked for before.
+ASDeviceInfo *getDeviceInfo(ASDeviceSnapshot *snapshot, int index, UInt32 fields) {
+    ASDeviceInfo *info = &snapshot->devices[index];
+    UInt32 missing = fields & ~info->fetched;
+    AudioDeviceID deviceID = info->deviceID;
+
+    if (missing == 0) {
+        return info;
+    }
+    if (missing & kFieldName) {
+        getDeviceName(deviceID, info->name);
+    }
+    if (missing & kFieldUID) {
+        const char *uid = getDeviceUID(deviceID);
+        strncpy(info->uid, uid, sizeof(info->uid) - 1);
+        if (uid[0] != '\0') free((void *)uid);
+    }
+    if (missing & kFieldTransport) {
+        info->transportType = getUInt32Property(deviceID, kAudioDevicePropertyTransportType, kAudioObjectPropertyScopeGlobal);
+    }
+    if (missing & kFieldInputChannels) {
+        info->inputChannels = getChannelCount(deviceID, kAudioObjectPropertyScopeInput);
+    }
+    if (missing & kFieldOutputChannels) {
+        info->outputChannels = getChannelCount(deviceID, kAudioObjectPropertyScopeOutput);
+    }
+    if (missing & kFieldSampleRate) {
+        AudioObjectPropertyAddress propertyAddress = {kAudioDevicePropertyNominalSampleRate, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain};
+        UInt32 dataSize = sizeof(info->sampleRate);
+        AudioObjectGetPropertyData(deviceID, &propertyAddress, 0, NULL, &dataSize, &info->sampleRate);
+    }
+    if (missing & kFieldLatency) {
+        info->inputLatency = getUInt32Property(deviceID, kAudioDevicePropertyLatency, kAudioObjectPropertyScopeInput);
+        info->outputLatency = getUInt32Property(deviceID, kAudioDevicePropertyLatency, kAudioObjectPropertyScopeOutput);
+    }
+    if (missing & kFieldAlive) {
+        info->isAlive = getUInt32Property(deviceID, kAudioDevicePropertyDeviceIsAlive, kAudioObjectPropertyScopeGlobal);
+    }
+    if (missing & kFieldRunning) {
+        info->isRunning = getUInt32Property(deviceID, kAudioDevicePropertyDeviceIsRunningSomewhere, kAudioObjectPropertyScopeGlobal);
+    }
+    if (missing & kFieldHidden) {
+        info->isHidden = getUInt32Property(deviceID, kAudioDevicePropertyIsHidden, kAudioObjectPropertyScopeGlobal);
+    }
+    if (missing & kFieldDataSource) {
+        getCurrentDataSourceName(deviceID, kAudioObjectPropertyScopeInput, info->inputDataSource, sizeof(info->inputDataSource));
+        getCurrentDataSourceName(deviceID, kAudioObjectPropertyScopeOutput, info->outputDataSource, sizeof(info->outputDataSource));
+    }
+    if (missing & kFieldHogOwner) {
+        info->hogOwner = getDeviceHogOwner(deviceID);
+    }
+    if (missing & kFieldDataSources) {
+        getDataSources(deviceID, kAudioObjectPropertyScopeInput, &info->inputDataSources);
+        getDataSources(deviceID, kAudioObjectPropertyScopeOutput, &info->outputDataSources);
+    }
+    // type and id need no HAL call
+    info->fetched |= missing & ~kFieldAggregate;
+
+    if ((missing & kFieldAggregate) && !snapshot->aggregatesLoaded) {
+        loadAggregates(snapshot);
+    }
+    info->fetched |= missing & kFieldAggregate;
+    return info;
+}
+
+UInt32 parseDeviceFields(const char *fieldList) {
+    UInt32 fields = 0;
+    const char *start = fieldList;
+
+    while (*start != '\0') {
+        size_t length = strcspn(start, ",");
+        bool known = false;
+
+        if (length == 3 && strncmp(start, "all", 3) == 0) {
+            fields |= kAllDeviceFields;
+            known = true;
+        }
+        for (size_t i = 0; i < sizeof(fieldNames) / sizeof(fieldNames[0]) && !known; i++) {
+            if (strlen(fieldNames[i].name) == length && strncmp(start, fieldNames[i].name, length) == 0) {
+                fields |= fieldNames[i].field;
+                known = true;
+            }
+        }
+        if (!known) {
+            return 0;
+        }
+        start += length;
+        if (*start == ',') start++;
+    }
+    return fields;
+}
+
+const char *deviceFieldName(ASDeviceField field) {
+    for (size_t i = 0; i < sizeof(fieldNames) / sizeof(fieldNames[0]); i++) {
+        if (fieldNames[i].field == field) return fieldNames[i].name;
+    }
+    return "unknown";
+}
+
+const char *transportTypeName(UInt32 transportType) {
+    switch (transportType) {
+        case kAudioDeviceTransportTypeBuiltIn: return "builtin";
+        case kAudioDeviceTransportTypeAggregate: return "aggregate";
+        case kAudioDeviceTransportTypeVirtual: return "virtual";
+        case kAudioDeviceTransportTypePCI: return "pci";
+        case kAudioDeviceTransportTypeUSB: return "usb";
+        case kAudioDeviceTransportTypeFireWire: return "firewire";
+        case kAudioDeviceTransportTypeBluetooth: return "bluetooth";
+        case kAudioDeviceTransportTypeBluetoothLE: return "bluetoothle";
+        case kAudioDeviceTransportTypeHDMI: return "hdmi";
+        case kAudioDeviceTransportTypeDisplayPort: return "displayport";
+        case kAudioDeviceTransportTypeAirPlay: return "airplay";
+        case kAudioDeviceTransportTypeAVB: return "avb";
+        case kAudioDeviceTransportTypeThunderbolt: return "thunderbolt";
+        default: return "unknown";
+    }
+}
+
+// Writes one already-loaded field of a device.  Latency and data sources are
+// reported for the scope of deviceType.  With quoteStrings, string values are
+// quoted and booleans spelled out, as the JSON output needs.
+void formatDeviceField(const ASDeviceInfo *info, ASDeviceField field, ASDeviceType deviceType, bool quoteStrings, char *buffer, size_t bufferSize) {
+    const char *quote = quoteStrings ? "\"" : "";
+    bool input = (deviceType == kAudioTypeInput);
+
+    switch (field) {
+        case kFieldName:
+            snprintf(buffer, bufferSize, "%s%s%s", quote, info->name, quote);
+            break;
+        case kFieldType:
+            snprintf(buffer, bufferSize, "%s%s%s", quote, deviceTypeName(deviceType), quote);
+            break;
+        case kFieldID:
+            snprintf(buffer, bufferSize, "%s%u%s", quote, info->deviceID, quote);
+            break;
+        case kFieldUID:
+            snprintf(buffer, bufferSize, "%s%s%s", quote, info->uid, quote);
+            break;
+        case kFieldTransport:
+            snprintf(buffer, bufferSize, "%s%s%s", quote, transportTypeName(info->transportType), quote);
+            break;
+        case kFieldInputChannels:
+            snprintf(buffer, bufferSize, "%u", info->inputChannels);
+            break;
+        case kFieldOutputChannels:
+            snprintf(buffer, bufferSize, "%u", info->outputChannels);
+            break;
+        case kFieldSampleRate:
+            snprintf(buffer, bufferSize, "%.0f", info->sampleRate);
+            break;
+        case kFieldLatency:
+            snprintf(buffer, bufferSize, "%u", input ? info->inputLatency : info->outputLatency);
+            break;
+        case kFieldAlive:
+            snprintf(buffer, bufferSize, "%s", info->isAlive ? "true" : "false");
+            break;
+        case kFieldRunning:
+            snprintf(buffer, bufferSize, "%s", info->isRunning ? "true" : "false");
+            break;
+        case kFieldHidden:
+            snprintf(buffer, bufferSize, "%s", info->isHidden ? "true" : "false");
+            break;
+        case kFieldAggregate:
+            snprintf(buffer, bufferSize, "%s%u%s", quote, info->aggregateID, quote);
+            break;
+        case kFieldDataSource:
+            snprintf(buffer, bufferSize, "%s%s%s", quote, input ? info->inputDataSource : info->outputDataSource, quote);
+            break;
+        case kFieldHogOwner:
+            if (info->hogOwner == kNoHogOwner) {
+                snprintf(buffer, bufferSize, "%s", quoteStrings ? "null" : "");
+            } else {
+                snprintf(buffer, bufferSize, "%d", info->hogOwner);
+            }
+            break;
+        case kFieldDataSources:
+            formatDataSources(input ? &info->inputDataSources : &info->outputDataSources, quoteStrings, buffer, bufferSize);
+            break;
+        default:
+            buffer[0] = '\0';
+            break;
+    }
+}
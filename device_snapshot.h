@@ -0,0 +1,83 @@
+/*
+ *  device_snapshot.h
+ *  AudioSwitcher
+ *
+ *  A snapshot of the device list whose per-device attributes are only
+ *  fetched from the HAL when first asked for, then kept for the lifetime
+ *  of the snapshot.
+ *
+ *  MIT License, see license.txt
+ */
+
+#ifndef DEVICE_SNAPSHOT_H
+#define DEVICE_SNAPSHOT_H
+
+#include "audio_switch.h"
+#include "device_data_source.h"
+
+#define MAX_SNAPSHOT_DEVICES 64
+
+// attributes selectable with --fields, in output order
+typedef enum {
+	kFieldName            = 1 << 0,
+	kFieldType            = 1 << 1,
+	kFieldID              = 1 << 2,
+	kFieldUID             = 1 << 3,
+	kFieldTransport       = 1 << 4,
+	kFieldInputChannels   = 1 << 5,
+	kFieldOutputChannels  = 1 << 6,
+	kFieldSampleRate      = 1 << 7,
+	kFieldLatency         = 1 << 8,
+	kFieldAlive           = 1 << 9,
+	kFieldRunning         = 1 << 10,
+	kFieldHidden          = 1 << 11,
+	kFieldAggregate       = 1 << 12,
+	kFieldDataSource      = 1 << 13,
+	kFieldHogOwner        = 1 << 14,
+	kFieldDataSources     = 1 << 15,
+} ASDeviceField;
+
+// what the listing has always shown
+#define kDefaultDeviceFields (kFieldName | kFieldType | kFieldID | kFieldUID)
+#define kAllDeviceFields ((kFieldDataSources << 1) - 1)
+
+typedef struct {
+	AudioDeviceID deviceID;
+	UInt32 fetched;			// ASDeviceField bits already loaded
+	char name[256];
+	char uid[256];
+	UInt32 transportType;
+	UInt32 inputChannels;
+	UInt32 outputChannels;
+	Float64 sampleRate;
+	UInt32 inputLatency;
+	UInt32 outputLatency;
+	UInt32 isAlive;
+	UInt32 isRunning;
+	UInt32 isHidden;
+	AudioDeviceID aggregateID;	// aggregate device this one belongs to, if any
+	char inputDataSource[64];
+	char outputDataSource[64];
+	pid_t hogOwner;			// process with exclusive access, or -1
+	ASDataSourceList inputDataSources;
+	ASDataSourceList outputDataSources;
+} ASDeviceInfo;
+
+typedef struct {
+	UInt64 generation;		// device list generation the snapshot was taken in
+	int count;
+	bool aggregatesLoaded;
+	ASDeviceInfo devices[MAX_SNAPSHOT_DEVICES];
+} ASDeviceSnapshot;
+
+UInt64 trackDeviceListGeneration(void);
+UInt64 getDeviceListGeneration(void);
+bool isDeviceListed(AudioDeviceID deviceID);
+OSStatus loadDeviceSnapshot(ASDeviceSnapshot *snapshot);
+ASDeviceInfo *getDeviceInfo(ASDeviceSnapshot *snapshot, int index, UInt32 fields);
+UInt32 parseDeviceFields(const char *fieldList);
+const char *deviceFieldName(ASDeviceField field);
+const char *transportTypeName(UInt32 transportType);
+void formatDeviceField(const ASDeviceInfo *info, ASDeviceField field, ASDeviceType deviceType, bool quoteStrings, char *buffer, size_t bufferSize);
+
+#endif
@@ -0,0 +1,126 @@
+/*
+ *  device_top.c
+ *  AudioSwitcher
+ *
+ *  MIT License, see license.txt
+ */
+
+#include "device_top.h"
+#include "device_snapshot.h"
+#include <mach/mach_time.h>
+#include <stdio.h>
+#include <string.h>
+
+static volatile UInt32 overloadCounts[MAX_SNAPSHOT_DEVICES];
+
+static OSStatus overloadListener(AudioObjectID objectID, UInt32 numberAddresses, const AudioObjectPropertyAddress *addresses, void *clientData) {
+    __atomic_add_fetch((volatile UInt32 *)clientData, 1, __ATOMIC_RELAXED);
+    return noErr;
+}
+
+static bool listedDevices[MAX_SNAPSHOT_DEVICES];
+
+static void setOverloadListeners(ASDeviceSnapshot *snapshot, bool listen) {
+    AudioObjectPropertyAddress propertyAddress = {kAudioDeviceProcessorOverload, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain};
+
+    for (int i = 0; i < snapshot->count; i++) {
+        if (listen) {
+            __atomic_store_n(&overloadCounts[i], 0, __ATOMIC_RELAXED);
+            AudioObjectAddPropertyListener(snapshot->devices[i].deviceID, &propertyAddress, overloadListener, (void *)&overloadCounts[i]);
+        } else {
+            AudioObjectRemovePropertyListener(snapshot->devices[i].deviceID, &propertyAddress, overloadListener, (void *)&overloadCounts[i]);
+        }
+    }
+}
+
+// decides once per snapshot which devices are shown
+static void loadListedDevices(ASDeviceSnapshot *snapshot, ASDeviceType typeRequested) {
+    loadDeviceSnapshot(snapshot);
+    for (int i = 0; i < snapshot->count; i++) {
+        listedDevices[i] = typeRequested == kAudioTypeAll || typeRequested == kAudioTypeUnknown || isDeviceOfType(snapshot->devices[i].deviceID, typeRequested);
+    }
+}
+
+// Samples the per-tick attributes of one device.  Names come from the
+// snapshot, so only these three properties are read on every tick.
+static void showDeviceLoad(const ASDeviceInfo *info, UInt32 overloads, ASOutputType outputRequested, bool first) {
+    AudioObjectPropertyAddress propertyAddress = {kAudioDevicePropertyDeviceIsRunningSomewhere, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain};
+    UInt32 isRunning = 0;
+    UInt32 bufferFrames = 0;
+    Float32 cycleUsage = 0.0;
+    UInt32 dataSize = sizeof(isRunning);
+
+    AudioObjectGetPropertyData(info->deviceID, &propertyAddress, 0, NULL, &dataSize, &isRunning);
+    propertyAddress.mSelector = kAudioDevicePropertyBufferFrameSize;
+    dataSize = sizeof(bufferFrames);
+    AudioObjectGetPropertyData(info->deviceID, &propertyAddress, 0, NULL, &dataSize, &bufferFrames);
+    propertyAddress.mSelector = kAudioDevicePropertyIOCycleUsage;
+    dataSize = sizeof(cycleUsage);
+    AudioObjectGetPropertyData(info->deviceID, &propertyAddress, 0, NULL, &dataSize, &cycleUsage);
+
+    switch (outputRequested) {
+        case kFormatHuman:
+            printf("%-40.40s %-7s %7.0f%% %7u %9u\n", info->name, isRunning ? "running" : "idle", cycleUsage * 100.0, bufferFrames, overloads);
+            break;
+        case kFormatCLI:
+            printf("%s,%u,%u,%.3f,%u,%u\n", info->name, info->deviceID, isRunning, cycleUsage, bufferFrames, overloads);
+            break;
+        case kFormatJSON:
+            printf("%s{\"name\": \"%s\", \"id\": \"%u\", \"running\": %s, \"io_cycle_usage\": %.3f, \"buffer_frames\": %u, \"overloads\": %u}",
+                   first ? "" : ", ", info->name, info->deviceID, isRunning ? "true" : "false", cycleUsage, bufferFrames, overloads);
+            break;
+        default:
+            break;
+    }
+}
+
+// Refreshes every intervalMs until killed.  Ticks are scheduled against
+// absolute deadlines, and the snapshot and overload listeners are only
+// rebuilt when the device list changes.
+int showDeviceTop(ASDeviceType typeRequested, ASOutputType outputRequested, UInt32 intervalMs) {
+    ASDeviceSnapshot snapshot;
+    mach_timebase_info_data_t timebase;
+    UInt64 tick = 0;
+
+    if (intervalMs == 0) intervalMs = DEFAULT_TOP_INTERVAL_MS;
+    mach_timebase_info(&timebase);
+    UInt64 intervalHostTime = (UInt64)intervalMs * 1000000ULL * timebase.denom / timebase.numer;
+
+    trackDeviceListGeneration();
+    loadListedDevices(&snapshot, typeRequested);
+    setOverloadListeners(&snapshot, true);
+
+    UInt64 startTime = mach_absolute_time();
+    for (;;) {
+        mach_wait_until(startTime + ++tick * intervalHostTime);
+
+        if (snapshot.generation != getDeviceListGeneration()) {
+            setOverloadListeners(&snapshot, false);
+            loadListedDevices(&snapshot, typeRequested);
+            setOverloadListeners(&snapshot, true);
+        }
+
+        if (outputRequested == kFormatHuman) {
+            // clear the screen and home the cursor
+            printf("\033[H\033[2J%-40s %-7s %8s %7s %9s\n", "DEVICE", "STATE", "IO CYCLE", "BUFFER", "OVERLOADS");
+        } else if (outputRequested == kFormatJSON) {
+            printf("{\"tick\": %llu, \"interval_ms\": %u, \"devices\": [", (unsigned long long)tick, intervalMs);
+        }
+
+        bool first = true;
+        for (int i = 0; i < snapshot.count; i++) {
+            UInt32 overloads = __atomic_exchange_n(&overloadCounts[i], 0, __ATOMIC_RELAXED);
+            if (!listedDevices[i]) continue;
+
+            showDeviceLoad(getDeviceInfo(&snapshot, i, kFieldName), overloads, outputRequested, first);
+            first = false;
+        }
+
+        if (outputRequested == kFormatJSON) {
+            printf("]}\n");
+        }
+        fflush(stdout);
+    }
+
+    return 0;
+}
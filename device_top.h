@@ -0,0 +1,22 @@
+/*
+ *  device_top.h
+ *  AudioSwitcher
+ *
+ *  A periodically refreshed view of every device: whether it is running,
+ *  its IO cycle usage and buffer size, and how many processor overloads it
+ *  reported during the last interval.  IO cycle usage is the share of each
+ *  IO cycle the device allows its clients, a setting rather than a load.
+ *
+ *  MIT License, see license.txt
+ */
+
+#ifndef DEVICE_TOP_H
+#define DEVICE_TOP_H
+
+#include "audio_switch.h"
+
+#define DEFAULT_TOP_INTERVAL_MS 1000
+
+int showDeviceTop(ASDeviceType typeRequested, ASOutputType outputRequested, UInt32 intervalMs);
+
+#endif
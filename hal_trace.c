@@ -0,0 +1,601 @@
+/*
+ *  hal_trace.c
+ *  AudioSwitcher
+ *
+ *  MIT License, see license.txt
+ */
+
+#define HAL_TRACE_IMPLEMENTATION
+#include "hal_trace.h"
+#include "audio_switch.h"
+#include <AudioToolbox/AudioServices.h>
+#include <fcntl.h>
+#include <mach/mach_time.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct {
+    ASTraceRecord record;
+    const UInt8 *qualifier;
+    const UInt8 *data;
+    bool used;
+} ASReplayEntry;
+
+static ASHALTraceMode traceMode = kHALTraceOff;
+static pthread_mutex_t traceMutex = PTHREAD_MUTEX_INITIALIZER;
+static int traceFD = -1;
+static UInt8 *replayBuffer = NULL;
+static ASReplayEntry *replayEntries = NULL;
+static size_t replayCount = 0;
+static mach_timebase_info_data_t timebase;
+static UInt64 firstCallTime = 0;
+static UInt32 callCount = 0;
+
+// how the value of a property is held in its data
+typedef enum {
+    kValueBytes,            // plain data, recorded as it is
+    kValueCFType,           // a CF object owned by the caller
+    kValueCFTranslation,    // an AudioValueTranslation from a UInt32 to a CF object
+} ASValueKind;
+
+static ASValueKind getValueKind(AudioObjectPropertySelector selector) {
+    if (selector == kAudioDevicePropertyDeviceUID ||
+        selector == kAudioDevicePropertyDeviceNameCFString ||
+        selector == kAudioObjectPropertyName ||
+        selector == kAudioAggregateDevicePropertyFullSubDeviceList ||
+        selector == kAudioAggregateDevicePropertyMainSubDevice ||
+        selector == kAudioAggregateDevicePropertyComposition) {
+        return kValueCFType;
+    }
+    if (selector == kAudioDevicePropertyDataSourceNameForIDCFString) {
+        return kValueCFTranslation;
+    }
+    return kValueBytes;
+}
+
+// properties whose qualifier is a CFStringRef
+static bool takesCFStringQualifier(AudioObjectPropertySelector selector) {
+    return selector == kAudioHardwarePropertyTranslateUIDToDevice;
+}
+
+// Counts calls for --startup-profile, noting when the first one was made.
+static inline void countHALCall(void) {
+    if (__atomic_fetch_add(&callCount, 1, __ATOMIC_RELAXED) == 0) {
+        __atomic_store_n(&firstCallTime, mach_absolute_time(), __ATOMIC_RELAXED);
+    }
+}
+
+UInt64 getFirstHALCallTime(void) {
+    return __atomic_load_n(&firstCallTime, __ATOMIC_RELAXED);
+}
+
+UInt32 getHALCallCount(void) {
+    return __atomic_load_n(&callCount, __ATOMIC_RELAXED);
+}
+
+static UInt64 elapsedNanos(UInt64 startTime) {
+    return (mach_absolute_time() - startTime) * timebase.numer / timebase.denom;
+}
+
+typedef struct {
+    UInt8 *bytes;
+    size_t size;
+    size_t capacity;
+    bool failed;
+} ASTraceBuffer;
+
+static void appendTraceBytes(ASTraceBuffer *buffer, const void *bytes, size_t size) {
+    if (buffer->failed) return;
+    if (buffer->size + size > buffer->capacity) {
+        size_t capacity = buffer->capacity ? buffer->capacity * 2 : 256;
+        while (capacity < buffer->size + size) capacity *= 2;
+        UInt8 *grown = realloc(buffer->bytes, capacity);
+        if (grown == NULL) {
+            buffer->failed = true;
+            return;
+        }
+        buffer->bytes = grown;
+        buffer->capacity = capacity;
+    }
+    memcpy(buffer->bytes + buffer->size, bytes, size);
+    buffer->size += size;
+}
+
+static void appendTraceTag(ASTraceBuffer *buffer, UInt8 tag, UInt32 count) {
+    appendTraceBytes(buffer, &tag, sizeof(tag));
+    appendTraceBytes(buffer, &count, sizeof(count));
+}
+
+// Serializes a property list value: strings, numbers, booleans, and arrays
+// and dictionaries of them, each as a tag, a count and the contents.  Any
+// other kind of object fails the whole value.
+static void serializeCFValue(ASTraceBuffer *buffer, CFTypeRef value) {
+    if (value == NULL) {
+        appendTraceTag(buffer, kTraceValueNull, 0);
+        return;
+    }
+
+    CFTypeID type = CFGetTypeID(value);
+    if (type == CFStringGetTypeID()) {
+        CFIndex length = CFStringGetLength(value);
+        CFIndex maxSize = CFStringGetMaximumSizeForEncoding(length, kCFStringEncodingUTF8) + 1;
+        char *text = malloc(maxSize);
+        if (text == NULL || !CFStringGetCString(value, text, maxSize, kCFStringEncodingUTF8)) {
+            free(text);
+            buffer->failed = true;
+            return;
+        }
+        appendTraceTag(buffer, kTraceValueString, (UInt32)strlen(text));
+        appendTraceBytes(buffer, text, strlen(text));
+        free(text);
+    } else if (type == CFBooleanGetTypeID()) {
+        appendTraceTag(buffer, kTraceValueBoolean, CFBooleanGetValue(value) ? 1 : 0);
+    } else if (type == CFNumberGetTypeID()) {
+        if (CFNumberIsFloatType(value)) {
+            Float64 number = 0.0;
+            CFNumberGetValue(value, kCFNumberFloat64Type, &number);
+            appendTraceTag(buffer, kTraceValueFloat, sizeof(number));
+            appendTraceBytes(buffer, &number, sizeof(number));
+        } else {
+            SInt64 number = 0;
+            CFNumberGetValue(value, kCFNumberSInt64Type, &number);
+            appendTraceTag(buffer, kTraceValueInteger, sizeof(number));
+            appendTraceBytes(buffer, &number, sizeof(number));
+        }
+    } else if (type == CFArrayGetTypeID()) {
+        CFIndex count = CFArrayGetCount(value);
+        appendTraceTag(buffer, kTraceValueArray, (UInt32)count);
+        for (CFIndex i = 0; i < count && !buffer->failed; i++) {
+            serializeCFValue(buffer, CFArrayGetValueAtIndex(value, i));
+        }
+    } else if (type == CFDictionaryGetTypeID()) {
+        CFIndex count = CFDictionaryGetCount(value);
+        const void **keys = malloc((count ? count : 1) * sizeof(void *));
+        const void **values = malloc((count ? count : 1) * sizeof(void *));
+        if (keys == NULL || values == NULL) {
+            buffer->failed = true;
+        } else {
+            CFDictionaryGetKeysAndValues(value, keys, values);
+            appendTraceTag(buffer, kTraceValueDictionary, (UInt32)count);
+            for (CFIndex i = 0; i < count && !buffer->failed; i++) {
+                serializeCFValue(buffer, keys[i]);
+                serializeCFValue(buffer, values[i]);
+            }
+        }
+        free(keys);
+        free(values);
+    } else {
+        buffer->failed = true;
+    }
+}
+
+// Rebuilds a value written by serializeCFValue, advancing *bytes past it.
+// Returns NULL for a null value and for a malformed one, telling them apart
+// through *malformed.
+static CFTypeRef deserializeCFValue(const UInt8 **bytes, const UInt8 *end, bool *malformed) {
+    UInt8 tag;
+    UInt32 count;
+
+    if (end - *bytes < (long)(sizeof(tag) + sizeof(count))) {
+        *malformed = true;
+        return NULL;
+    }
+    memcpy(&tag, *bytes, sizeof(tag));
+    memcpy(&count, *bytes + sizeof(tag), sizeof(count));
+    *bytes += sizeof(tag) + sizeof(count);
+
+    switch (tag) {
+        case kTraceValueNull:
+            return NULL;
+        case kTraceValueString: {
+            if ((UInt32)(end - *bytes) < count) break;
+            CFStringRef string = CFStringCreateWithBytes(kCFAllocatorDefault, *bytes, count, kCFStringEncodingUTF8, false);
+            *bytes += count;
+            if (string == NULL) break;
+            return string;
+        }
+        case kTraceValueBoolean:
+            return CFRetain(count ? kCFBooleanTrue : kCFBooleanFalse);
+        case kTraceValueInteger:
+        case kTraceValueFloat: {
+            UInt8 number[8];
+            if (count != sizeof(number) || end - *bytes < (long)sizeof(number)) break;
+            memcpy(number, *bytes, sizeof(number));
+            *bytes += sizeof(number);
+            return CFNumberCreate(kCFAllocatorDefault, tag == kTraceValueFloat ? kCFNumberFloat64Type : kCFNumberSInt64Type, number);
+        }
+        case kTraceValueArray: {
+            CFMutableArrayRef array = CFArrayCreateMutable(kCFAllocatorDefault, 0, &kCFTypeArrayCallBacks);
+            for (UInt32 i = 0; i < count && !*malformed; i++) {
+                CFTypeRef element = deserializeCFValue(bytes, end, malformed);
+                if (element == NULL) continue;
+                CFArrayAppendValue(array, element);
+                CFRelease(element);
+            }
+            if (*malformed) {
+                CFRelease(array);
+                return NULL;
+            }
+            return array;
+        }
+        case kTraceValueDictionary: {
+            CFMutableDictionaryRef dictionary = CFDictionaryCreateMutable(kCFAllocatorDefault, 0, &kCFTypeDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks);
+            for (UInt32 i = 0; i < count && !*malformed; i++) {
+                CFTypeRef key = deserializeCFValue(bytes, end, malformed);
+                CFTypeRef value = deserializeCFValue(bytes, end, malformed);
+                if (key != NULL && value != NULL) CFDictionarySetValue(dictionary, key, value);
+                if (key != NULL) CFRelease(key);
+                if (value != NULL) CFRelease(value);
+            }
+            if (*malformed) {
+                CFRelease(dictionary);
+                return NULL;
+            }
+            return dictionary;
+        }
+        default:
+            break;
+    }
+    *malformed = true;
+    return NULL;
+}
+
+// Converts a CFStringRef to newly allocated UTF-8 text, returning its length.
+static char *copyCFStringText(CFStringRef string, UInt32 *length) {
+    CFIndex maxSize = CFStringGetMaximumSizeForEncoding(CFStringGetLength(string), kCFStringEncodingUTF8) + 1;
+    char *text = malloc(maxSize);
+    if (text == NULL || !CFStringGetCString(string, text, maxSize, kCFStringEncodingUTF8)) {
+        free(text);
+        *length = 0;
+        return NULL;
+    }
+    *length = (UInt32)strlen(text);
+    return text;
+}
+
+// Serializes a qualifier into comparable bytes.  Returns text that the
+// caller frees when the qualifier was a CFStringRef, NULL otherwise.  The
+// input of a translation is part of its data rather than its qualifier, but
+// it decides the answer all the same, so it is matched as one.
+static char *traceQualifier(const AudioObjectPropertyAddress *address, UInt32 *qualifierSize, const void **qualifier, const void *data) {
+    char *text = NULL;
+    if (takesCFStringQualifier(address->mSelector) && *qualifierSize == sizeof(CFStringRef) && *qualifier != NULL) {
+        text = copyCFStringText(*(CFStringRef *)*qualifier, qualifierSize);
+        *qualifier = text;
+    } else if (getValueKind(address->mSelector) == kValueCFTranslation && data != NULL) {
+        const AudioValueTranslation *translation = data;
+        *qualifierSize = translation->mInputDataSize;
+        *qualifier = translation->mInputData;
+    }
+    return text;
+}
+
+// Serializes the CF value a call handed over, or marks the record as one
+// that cannot be replayed; the pointers themselves are never written.
+static ASTraceBuffer traceCFValue(ASTraceRecord *record, UInt32 dataSize, const void *data) {
+    ASTraceBuffer buffer = {NULL, 0, 0, false};
+    CFTypeRef value = NULL;
+
+    if (getValueKind(record->address.mSelector) == kValueCFTranslation) {
+        const AudioValueTranslation *translation = data;
+        if (dataSize == sizeof(*translation) && translation->mOutputDataSize == sizeof(CFTypeRef)) {
+            value = *(CFTypeRef *)translation->mOutputData;
+        } else {
+            buffer.failed = true;
+        }
+    } else if (dataSize == sizeof(CFTypeRef)) {
+        value = *(CFTypeRef *)data;
+    } else {
+        buffer.failed = true;
+    }
+    if (!buffer.failed) {
+        serializeCFValue(&buffer, value);
+    }
+
+    if (buffer.failed) {
+        free(buffer.bytes);
+        buffer = (ASTraceBuffer){NULL, 0, 0, true};
+        record->flags |= kTraceFlagUnserializable;
+    } else {
+        record->flags |= kTraceFlagCFValue;
+    }
+    return buffer;
+}
+
+static void appendRecord(ASTraceOperation operation, AudioObjectID objectID, const AudioObjectPropertyAddress *address, UInt32 qualifierSize, const void *qualifier, UInt32 dataSize, const void *data, OSStatus status, UInt64 latencyNanos) {
+    ASTraceRecord record = {
+        .latencyNanos = latencyNanos,
+        .operation = operation,
+        .objectID = objectID,
+        .address = *address,
+        .flags = 0,
+        .status = status,
+    };
+    char *qualifierText = traceQualifier(address, &qualifierSize, &qualifier, data);
+    ASTraceBuffer value = {NULL, 0, 0, false};
+
+    if (status != noErr) {
+        dataSize = 0;
+    } else if ((operation == kTraceGetPropertyData || operation == kTraceSetPropertyData) && getValueKind(address->mSelector) != kValueBytes) {
+        value = traceCFValue(&record, dataSize, data);
+        dataSize = (UInt32)value.size;
+        data = value.bytes;
+    }
+    record.qualifierSize = qualifier ? qualifierSize : 0;
+    record.dataSize = data ? dataSize : 0;
+
+    // one unbuffered write per record, so a run that ends on a signal, as
+    // --top, --publish and --hog do, leaves every finished call on disk
+    size_t recordSize = sizeof(record) + record.qualifierSize + record.dataSize;
+    UInt8 *bytes = malloc(recordSize);
+    if (bytes != NULL) {
+        memcpy(bytes, &record, sizeof(record));
+        if (record.qualifierSize) memcpy(bytes + sizeof(record), qualifier, record.qualifierSize);
+        if (record.dataSize) memcpy(bytes + sizeof(record) + record.qualifierSize, data, record.dataSize);
+
+        pthread_mutex_lock(&traceMutex);
+        if (traceFD >= 0 && write(traceFD, bytes, recordSize) != (ssize_t)recordSize) {
+            // a torn record would misalign everything after it
+            close(traceFD);
+            traceFD = -1;
+        }
+        pthread_mutex_unlock(&traceMutex);
+        free(bytes);
+    }
+
+    free(qualifierText);
+    free(value.bytes);
+}
+
+static int loadReplay(FILE *file) {
+    UInt32 header[2];
+    long size;
+
+    if (fread(header, sizeof(header), 1, file) != 1 || header[0] != HAL_TRACE_MAGIC || header[1] != HAL_TRACE_VERSION) {
+        return 1;
+    }
+    long start = ftell(file);
+    fseek(file, 0, SEEK_END);
+    size = ftell(file) - start;
+    fseek(file, start, SEEK_SET);
+
+    replayBuffer = malloc(size > 0 ? size : 1);
+    if (replayBuffer == NULL || fread(replayBuffer, 1, size, file) != (size_t)size) {
+        return 1;
+    }
+
+    // two passes: count, then index
+    for (int pass = 0; pass < 2; pass++) {
+        long offset = 0;
+        replayCount = 0;
+        while (offset + (long)sizeof(ASTraceRecord) <= size) {
+            ASTraceRecord record;
+            memcpy(&record, replayBuffer + offset, sizeof(record));
+            offset += sizeof(record);
+            if (offset + record.qualifierSize + record.dataSize > (unsigned long)size) break;
+            if (pass == 1) {
+                replayEntries[replayCount] = (ASReplayEntry){record, replayBuffer + offset, replayBuffer + offset + record.qualifierSize, false};
+            }
+            offset += record.qualifierSize + record.dataSize;
+            replayCount++;
+        }
+        if (pass == 0) {
+            replayEntries = calloc(replayCount ? replayCount : 1, sizeof(ASReplayEntry));
+            if (replayEntries == NULL) return 1;
+        }
+    }
+    return 0;
+}
+
+int startHALTrace(const char *path, ASHALTraceMode mode) {
+    mach_timebase_info(&timebase);
+
+    if (mode == kHALTraceRecord) {
+        UInt32 header[2] = {HAL_TRACE_MAGIC, HAL_TRACE_VERSION};
+        traceFD = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (traceFD < 0 || write(traceFD, header, sizeof(header)) != (ssize_t)sizeof(header)) {
+            printf("Could not create trace file %s\n", path);
+            if (traceFD >= 0) close(traceFD);
+            traceFD = -1;
+            return 1;
+        }
+        atexit(stopHALTrace);
+    } else if (mode == kHALTraceReplay) {
+        FILE *file = fopen(path, "rb");
+        if (file == NULL || loadReplay(file) != 0) {
+            printf("Could not read trace file %s\n", path);
+            if (file) fclose(file);
+            return 1;
+        }
+        fclose(file);
+    }
+    traceMode = mode;
+    return 0;
+}
+
+void stopHALTrace(void) {
+    pthread_mutex_lock(&traceMutex);
+    if (traceFD >= 0) {
+        close(traceFD);
+        traceFD = -1;
+    }
+    pthread_mutex_unlock(&traceMutex);
+}
+
+ASHALTraceMode getHALTraceMode(void) {
+    return traceMode;
+}
+
+// Finds the first unused recorded answer to a call, or the last used one
+// when the call was made more often than during recording, and waits as
+// long as the original call took.
+static ASReplayEntry *replayCall(ASTraceOperation operation, AudioObjectID objectID, const AudioObjectPropertyAddress *address, UInt32 qualifierSize, const void *qualifier, const void *data) {
+    char *qualifierText = traceQualifier(address, &qualifierSize, &qualifier, data);
+    ASReplayEntry *found = NULL;
+
+    if (qualifier == NULL) qualifierSize = 0;
+
+    pthread_mutex_lock(&traceMutex);
+    for (size_t i = 0; i < replayCount; i++) {
+        ASReplayEntry *entry = &replayEntries[i];
+        if (entry->record.operation != operation || entry->record.objectID != objectID ||
+            entry->record.address.mSelector != address->mSelector ||
+            entry->record.address.mScope != address->mScope ||
+            entry->record.address.mElement != address->mElement ||
+            entry->record.qualifierSize != qualifierSize ||
+            (qualifierSize && memcmp(entry->qualifier, qualifier, qualifierSize) != 0)) {
+            continue;
+        }
+        found = entry;
+        if (!entry->used) break;
+    }
+    if (found) found->used = true;
+    pthread_mutex_unlock(&traceMutex);
+
+    free(qualifierText);
+    if (found && found->record.latencyNanos) {
+        struct timespec delay = {(time_t)(found->record.latencyNanos / 1000000000ULL), (long)(found->record.latencyNanos % 1000000000ULL)};
+        nanosleep(&delay, NULL);
+    }
+    return found;
+}
+
+// The virtual main volume and balance are not properties of the device: a
+// device that has them gets them from AudioToolbox, which only serves them
+// through AudioHardwareService.  Either way they are traced as any other.
+static bool isHardwareServiceProperty(const AudioObjectPropertyAddress *address) {
+    return address->mSelector == kAudioHardwareServiceDeviceProperty_VirtualMainVolume ||
+        address->mSelector == kAudioHardwareServiceDeviceProperty_VirtualMainBalance;
+}
+
+OSStatus HALTraceGetPropertyDataSize(AudioObjectID objectID, const AudioObjectPropertyAddress *address, UInt32 qualifierSize, const void *qualifier, UInt32 *outDataSize) {
+    countHALCall();
+    if (traceMode == kHALTraceReplay) {
+        ASReplayEntry *entry = replayCall(kTraceGetPropertyDataSize, objectID, address, qualifierSize, qualifier, NULL);
+        if (entry == NULL) return kAudioHardwareUnknownPropertyError;
+        if (entry->record.dataSize == sizeof(UInt32)) memcpy(outDataSize, entry->data, sizeof(UInt32));
+        return entry->record.status;
+    }
+
+    UInt64 startTime = mach_absolute_time();
+    OSStatus status = isHardwareServiceProperty(address) ?
+        AudioHardwareServiceGetPropertyDataSize(objectID, address, qualifierSize, qualifier, outDataSize) :
+        AudioObjectGetPropertyDataSize(objectID, address, qualifierSize, qualifier, outDataSize);
+    if (traceMode == kHALTraceRecord) {
+        appendRecord(kTraceGetPropertyDataSize, objectID, address, qualifierSize, qualifier, sizeof(UInt32), outDataSize, status, elapsedNanos(startTime));
+    }
+    return status;
+}
+
+OSStatus HALTraceGetPropertyData(AudioObjectID objectID, const AudioObjectPropertyAddress *address, UInt32 qualifierSize, const void *qualifier, UInt32 *ioDataSize, void *outData) {
+    countHALCall();
+    if (traceMode == kHALTraceReplay) {
+        ASReplayEntry *entry = replayCall(kTraceGetPropertyData, objectID, address, qualifierSize, qualifier, outData);
+        if (entry == NULL || (entry->record.flags & kTraceFlagUnserializable)) return kAudioHardwareUnknownPropertyError;
+        if (entry->record.status != noErr) return entry->record.status;
+
+        if (entry->record.flags & kTraceFlagCFValue) {
+            const UInt8 *bytes = entry->data;
+            bool malformed = false;
+            CFTypeRef value = deserializeCFValue(&bytes, entry->data + entry->record.dataSize, &malformed);
+            if (malformed) return kAudioHardwareUnspecifiedError;
+
+            if (getValueKind(address->mSelector) == kValueCFTranslation) {
+                AudioValueTranslation *translation = outData;
+                if (translation->mOutputDataSize < sizeof(CFTypeRef)) {
+                    if (value != NULL) CFRelease(value);
+                    return kAudioHardwareBadPropertySizeError;
+                }
+                *(CFTypeRef *)translation->mOutputData = value;
+            } else {
+                *(CFTypeRef *)outData = value;
+                *ioDataSize = sizeof(CFTypeRef);
+            }
+        } else {
+            UInt32 size = entry->record.dataSize < *ioDataSize ? entry->record.dataSize : *ioDataSize;
+            memcpy(outData, entry->data, size);
+            *ioDataSize = size;
+        }
+        return noErr;
+    }
+
+    UInt64 startTime = mach_absolute_time();
+    OSStatus status = isHardwareServiceProperty(address) ?
+        AudioHardwareServiceGetPropertyData(objectID, address, qualifierSize, qualifier, ioDataSize, outData) :
+        AudioObjectGetPropertyData(objectID, address, qualifierSize, qualifier, ioDataSize, outData);
+    if (traceMode == kHALTraceRecord) {
+        appendRecord(kTraceGetPropertyData, objectID, address, qualifierSize, qualifier, *ioDataSize, outData, status, elapsedNanos(startTime));
+    }
+    return status;
+}
+
+OSStatus HALTraceSetPropertyData(AudioObjectID objectID, const AudioObjectPropertyAddress *address, UInt32 qualifierSize, const void *qualifier, UInt32 dataSize, const void *data) {
+    countHALCall();
+    if (traceMode == kHALTraceReplay) {
+        // never changes anything; answers with the recorded status
+        ASReplayEntry *entry = replayCall(kTraceSetPropertyData, objectID, address, qualifierSize, qualifier, data);
+        return entry ? entry->record.status : noErr;
+    }
+
+    UInt64 startTime = mach_absolute_time();
+    OSStatus status = isHardwareServiceProperty(address) ?
+        AudioHardwareServiceSetPropertyData(objectID, address, qualifierSize, qualifier, dataSize, data) :
+        AudioObjectSetPropertyData(objectID, address, qualifierSize, qualifier, dataSize, data);
+    if (traceMode == kHALTraceRecord) {
+        appendRecord(kTraceSetPropertyData, objectID, address, qualifierSize, qualifier, dataSize, data, status, elapsedNanos(startTime));
+    }
+    return status;
+}
+
+Boolean HALTraceHasProperty(AudioObjectID objectID, const AudioObjectPropertyAddress *address) {
+    countHALCall();
+    if (traceMode == kHALTraceReplay) {
+        ASReplayEntry *entry = replayCall(kTraceHasProperty, objectID, address, 0, NULL, NULL);
+        return entry && entry->record.dataSize == sizeof(Boolean) && *(const Boolean *)entry->data;
+    }
+
+    UInt64 startTime = mach_absolute_time();
+    Boolean hasProperty = isHardwareServiceProperty(address) ?
+        AudioHardwareServiceHasProperty(objectID, address) :
+        AudioObjectHasProperty(objectID, address);
+    if (traceMode == kHALTraceRecord) {
+        appendRecord(kTraceHasProperty, objectID, address, 0, NULL, sizeof(hasProperty), &hasProperty, noErr, elapsedNanos(startTime));
+    }
+    return hasProperty;
+}
+
+OSStatus HALTraceIsPropertySettable(AudioObjectID objectID, const AudioObjectPropertyAddress *address, Boolean *outIsSettable) {
+    countHALCall();
+    if (traceMode == kHALTraceReplay) {
+        ASReplayEntry *entry = replayCall(kTraceIsPropertySettable, objectID, address, 0, NULL, NULL);
+        if (entry == NULL) return kAudioHardwareUnknownPropertyError;
+        if (entry->record.dataSize == sizeof(Boolean)) *outIsSettable = *(const Boolean *)entry->data;
+        return entry->record.status;
+    }
+
+    UInt64 startTime = mach_absolute_time();
+    OSStatus status = isHardwareServiceProperty(address) ?
+        AudioHardwareServiceIsPropertySettable(objectID, address, outIsSettable) :
+        AudioObjectIsPropertySettable(objectID, address, outIsSettable);
+    if (traceMode == kHALTraceRecord) {
+        appendRecord(kTraceIsPropertySettable, objectID, address, 0, NULL, sizeof(Boolean), outIsSettable, status, elapsedNanos(startTime));
+    }
+    return status;
+}
+
+// listeners are not traced, and during replay there is nothing to listen to
+OSStatus HALTraceAddPropertyListener(AudioObjectID objectID, const AudioObjectPropertyAddress *address, AudioObjectPropertyListenerProc listener, void *clientData) {
+    countHALCall();
+    if (traceMode == kHALTraceReplay) return noErr;
+    return AudioObjectAddPropertyListener(objectID, address, listener, clientData);
+}
+
+OSStatus HALTraceRemovePropertyListener(AudioObjectID objectID, const AudioObjectPropertyAddress *address, AudioObjectPropertyListenerProc listener, void *clientData) {
+    countHALCall();
+    if (traceMode == kHALTraceReplay) return noErr;
+    return AudioObjectRemovePropertyListener(objectID, address, listener, clientData);
+}
@@ -0,0 +1,100 @@
+/*
+ *  hal_trace.h
+ *  AudioSwitcher
+ *
+ *  Record and replay of the property queries made against the HAL.
+ *
+ *  Recording writes every call, its address, the bytes returned, the status
+ *  and how long it took to a compact binary trace.  Replaying serves the
+ *  same answers with the same delays without touching the real devices, so
+ *  a slow run on one machine can be reproduced and profiled on another.
+ *
+ *  Including this header routes the AudioObject calls of the including
+ *  file through the trace layer; it is included from audio_switch.h.  The
+ *  trace layer hands the properties AudioToolbox serves on top of the HAL
+ *  to AudioHardwareService, so callers ask for them like any other.
+ *
+ *  MIT License, see license.txt
+ */
+
+#ifndef HAL_TRACE_H
+#define HAL_TRACE_H
+
+#include <CoreAudio/CoreAudio.h>
+
+#define HAL_TRACE_MAGIC 0x52544153		// 'SATR'
+#define HAL_TRACE_VERSION 2
+
+typedef enum {
+	kHALTraceOff    = 0,
+	kHALTraceRecord = 1,
+	kHALTraceReplay = 2,
+} ASHALTraceMode;
+
+typedef enum {
+	kTraceGetPropertyDataSize = 1,
+	kTraceGetPropertyData     = 2,
+	kTraceSetPropertyData     = 3,
+	kTraceHasProperty         = 4,
+	kTraceIsPropertySettable  = 5,
+} ASTraceOperation;
+
+enum {
+	kTraceFlagCFValue         = 1 << 0,	// data is a serialized CF value, see below
+	kTraceFlagUnserializable  = 1 << 1,	// the value held something other than a property list; not replayable
+};
+
+// a serialized CF value is a one byte tag and a UInt32 count, followed by
+// count bytes of UTF-8 for a string, the 8 bytes of an integer or float,
+// count values for an array, or count key and value pairs for a dictionary;
+// a boolean keeps its value in the count
+enum {
+	kTraceValueNull       = 0,
+	kTraceValueString     = 's',
+	kTraceValueInteger    = 'i',
+	kTraceValueFloat      = 'f',
+	kTraceValueBoolean    = 'b',
+	kTraceValueArray      = 'a',
+	kTraceValueDictionary = 'd',
+};
+
+// the file starts with a magic and version, followed by records, each
+// followed by qualifierSize bytes of qualifier and dataSize bytes of data;
+// for a translation such as a data source name, the qualifier holds the
+// translation's input
+typedef struct {
+	UInt64 latencyNanos;
+	UInt32 operation;
+	AudioObjectID objectID;
+	AudioObjectPropertyAddress address;
+	UInt32 qualifierSize;
+	UInt32 dataSize;
+	UInt32 flags;
+	OSStatus status;
+} ASTraceRecord;
+
+int startHALTrace(const char *path, ASHALTraceMode mode);
+void stopHALTrace(void);
+ASHALTraceMode getHALTraceMode(void);
+UInt64 getFirstHALCallTime(void);
+UInt32 getHALCallCount(void);
+
+OSStatus HALTraceGetPropertyDataSize(AudioObjectID objectID, const AudioObjectPropertyAddress *address, UInt32 qualifierSize, const void *qualifier, UInt32 *outDataSize);
+OSStatus HALTraceGetPropertyData(AudioObjectID objectID, const AudioObjectPropertyAddress *address, UInt32 qualifierSize, const void *qualifier, UInt32 *ioDataSize, void *outData);
+OSStatus HALTraceSetPropertyData(AudioObjectID objectID, const AudioObjectPropertyAddress *address, UInt32 qualifierSize, const void *qualifier, UInt32 dataSize, const void *data);
+Boolean HALTraceHasProperty(AudioObjectID objectID, const AudioObjectPropertyAddress *address);
+OSStatus HALTraceIsPropertySettable(AudioObjectID objectID, const AudioObjectPropertyAddress *address, Boolean *outIsSettable);
+OSStatus HALTraceAddPropertyListener(AudioObjectID objectID, const AudioObjectPropertyAddress *address, AudioObjectPropertyListenerProc listener, void *clientData);
+OSStatus HALTraceRemovePropertyListener(AudioObjectID objectID, const AudioObjectPropertyAddress *address, AudioObjectPropertyListenerProc listener, void *clientData);
+
+#ifndef HAL_TRACE_IMPLEMENTATION
+#define AudioObjectGetPropertyDataSize HALTraceGetPropertyDataSize
+#define AudioObjectGetPropertyData HALTraceGetPropertyData
+#define AudioObjectSetPropertyData HALTraceSetPropertyData
+#define AudioObjectHasProperty HALTraceHasProperty
+#define AudioObjectIsPropertySettable HALTraceIsPropertySettable
+#define AudioObjectAddPropertyListener HALTraceAddPropertyListener
+#define AudioObjectRemovePropertyListener HALTraceRemovePropertyListener
+#endif
+
+#endif
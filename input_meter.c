@@ -0,0 +1,187 @@
+/*
+ *  input_meter.c
+ *  AudioSwitcher
+ *
+ *  MIT License, see license.txt
+ */
+
+#include "input_meter.h"
+#include "level_kernels.h"
+#include <mach/mach_time.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#define MAX_METER_STREAMS 16
+#define METER_SCRATCH_FRAMES 1024
+#define WINDOW_HANDOFF_POLLS 100
+#define WINDOW_HANDOFF_POLL_MICROS 1000
+
+typedef struct {
+    float peak[MAX_METER_CHANNELS];
+    double sumSquares[MAX_METER_CHANNELS];
+    UInt64 frames[MAX_METER_CHANNELS];
+} ASMeterWindow;
+
+// the IO thread fills windows[activeWindow] while the main thread reports
+// and clears the other one
+static ASMeterWindow windows[2];
+static int activeWindow = 0;
+static UInt32 ioCycles = 0;
+// only used on the IO thread
+static float scratch[METER_SCRATCH_FRAMES];
+
+static OSStatus meterIOProc(AudioObjectID deviceID, const AudioTimeStamp *now, const AudioBufferList *inputData, const AudioTimeStamp *inputTime, AudioBufferList *outputData, const AudioTimeStamp *outputTime, void *clientData) {
+    ASMeterWindow *window = &windows[__atomic_load_n(&activeWindow, __ATOMIC_ACQUIRE)];
+    UInt32 channel = 0;
+
+    for (UInt32 i = 0; i < inputData->mNumberBuffers && channel < MAX_METER_CHANNELS; i++) {
+        const AudioBuffer *buffer = &inputData->mBuffers[i];
+        UInt32 channels = buffer->mNumberChannels;
+
+        if (buffer->mData == NULL || channels == 0) {
+            channel += channels;
+            continue;
+        }
+        size_t frames = buffer->mDataByteSize / (channels * sizeof(float));
+        for (UInt32 c = 0; c < channels && channel < MAX_METER_CHANNELS; c++, channel++) {
+            for (size_t start = 0; start < frames; start += METER_SCRATCH_FRAMES) {
+                size_t count = frames - start < METER_SCRATCH_FRAMES ? frames - start : METER_SCRATCH_FRAMES;
+                const float *samples = (const float *)buffer->mData + start * channels;
+                float peak;
+                double sumSquares;
+
+                // the kernels want one channel's samples next to each other
+                if (channels > 1) {
+                    deinterleaveChannel(samples, count, channels, c, scratch);
+                    samples = scratch;
+                }
+                measureLevels(samples, count, &peak, &sumSquares);
+                if (peak > window->peak[channel]) window->peak[channel] = peak;
+                window->sumSquares[channel] += sumSquares;
+                window->frames[channel] += count;
+            }
+        }
+    }
+    __atomic_add_fetch(&ioCycles, 1, __ATOMIC_RELEASE);
+    return noErr;
+}
+
+// Points the IO thread at the other window and waits for the cycle that may
+// still be filling the old one to finish, then hands the old one over.  If
+// the device stops delivering input the wait gives up after a while.
+static ASMeterWindow *takeWindow(void) {
+    int previous = __atomic_load_n(&activeWindow, __ATOMIC_RELAXED);
+
+    __atomic_store_n(&activeWindow, !previous, __ATOMIC_RELEASE);
+    UInt32 cycles = __atomic_load_n(&ioCycles, __ATOMIC_ACQUIRE);
+    for (int i = 0; i < WINDOW_HANDOFF_POLLS && __atomic_load_n(&ioCycles, __ATOMIC_ACQUIRE) == cycles; i++) {
+        usleep(WINDOW_HANDOFF_POLL_MICROS);
+    }
+    return &windows[previous];
+}
+
+// Returns how many input channels the device has, or 0 when any of its
+// input streams does not deliver 32-bit float samples.
+static UInt32 getMeterChannels(AudioDeviceID deviceID) {
+    AudioObjectPropertyAddress propertyAddress = {kAudioDevicePropertyStreams, kAudioObjectPropertyScopeInput, kAudioObjectPropertyElementMain};
+    AudioStreamID streams[MAX_METER_STREAMS];
+    UInt32 dataSize = sizeof(streams);
+    UInt32 channels = 0;
+
+    if (AudioObjectGetPropertyData(deviceID, &propertyAddress, 0, NULL, &dataSize, streams) != noErr) {
+        return 0;
+    }
+    for (UInt32 i = 0; i < dataSize / sizeof(AudioStreamID); i++) {
+        AudioObjectPropertyAddress formatAddress = {kAudioStreamPropertyVirtualFormat, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain};
+        AudioStreamBasicDescription format;
+        UInt32 formatSize = sizeof(format);
+
+        if (AudioObjectGetPropertyData(streams[i], &formatAddress, 0, NULL, &formatSize, &format) != noErr ||
+            format.mFormatID != kAudioFormatLinearPCM || !(format.mFormatFlags & kAudioFormatFlagIsFloat) || format.mBitsPerChannel != 32) {
+            return 0;
+        }
+        channels += format.mChannelsPerFrame;
+    }
+    return channels < MAX_METER_CHANNELS ? channels : MAX_METER_CHANNELS;
+}
+
+static double levelToDB(double level) {
+    return level > 0.0 ? fmax(20.0 * log10(level), METER_FLOOR_DB) : METER_FLOOR_DB;
+}
+
+static void showLevels(const char *deviceName, UInt64 elapsedMs, const ASMeterWindow *window, UInt32 channels, ASOutputType outputRequested) {
+    if (outputRequested == kFormatJSON) {
+        printf("{\"name\": \"%s\", \"elapsed_ms\": %llu, \"channels\": [", deviceName, (unsigned long long)elapsedMs);
+    } else if (outputRequested == kFormatCLI) {
+        printf("%llu", (unsigned long long)elapsedMs);
+    } else {
+        printf("%7.1f s", elapsedMs / 1000.0);
+    }
+
+    for (UInt32 i = 0; i < channels; i++) {
+        double peakDB = levelToDB(window->peak[i]);
+        double rmsDB = levelToDB(window->frames[i] ? sqrt(window->sumSquares[i] / window->frames[i]) : 0.0);
+
+        switch (outputRequested) {
+            case kFormatCLI:
+                printf(",%.1f,%.1f", peakDB, rmsDB);
+                break;
+            case kFormatJSON:
+                printf("%s{\"peak_db\": %.1f, \"rms_db\": %.1f}", i ? ", " : "", peakDB, rmsDB);
+                break;
+            default:
+                printf("  %u: peak %6.1f dB rms %6.1f dB", i + 1, peakDB, rmsDB);
+                break;
+        }
+    }
+    printf(outputRequested == kFormatJSON ? "]}\n" : "\n");
+    fflush(stdout);
+}
+
+// Runs the input of the device and reports the levels of the last
+// intervalMs every intervalMs, for the given number of seconds or, with 0,
+// until killed.  Nothing about the device or the defaults is changed.
+int showInputMeter(AudioDeviceID deviceID, UInt32 seconds, UInt32 intervalMs, ASOutputType outputRequested) {
+    AudioDeviceIOProcID procID = NULL;
+    mach_timebase_info_data_t timebase;
+    char deviceName[256];
+    UInt64 tick = 0;
+
+    if (intervalMs == 0) intervalMs = DEFAULT_METER_INTERVAL_MS;
+    if (deviceID == kAudioDeviceUnknown) {
+        printf("There is no input device to meter.\n");
+        return 1;
+    }
+    getDeviceName(deviceID, deviceName);
+    UInt32 channels = getMeterChannels(deviceID);
+    if (channels == 0) {
+        printf("Input device \"%s\" has no float input channels to meter.\n", deviceName);
+        return 1;
+    }
+
+    OSStatus status = AudioDeviceCreateIOProcID(deviceID, meterIOProc, NULL, &procID);
+    if (status == noErr) {
+        status = AudioDeviceStart(deviceID, procID);
+    }
+    if (status != noErr) {
+        printf("Could not start input device \"%s\". Error: %d (%s)\n", deviceName, status, describeStatus(status));
+        if (procID != NULL) AudioDeviceDestroyIOProcID(deviceID, procID);
+        return 1;
+    }
+
+    mach_timebase_info(&timebase);
+    UInt64 intervalHostTime = (UInt64)intervalMs * 1000000ULL * timebase.denom / timebase.numer;
+    UInt64 startTime = mach_absolute_time();
+    while (seconds == 0 || (tick + 1) * intervalMs <= (UInt64)seconds * 1000) {
+        mach_wait_until(startTime + ++tick * intervalHostTime);
+
+        ASMeterWindow *window = takeWindow();
+        showLevels(deviceName, tick * intervalMs, window, channels, outputRequested);
+        memset(window, 0, sizeof(*window));
+    }
+
+    AudioDeviceStop(deviceID, procID);
+    AudioDeviceDestroyIOProcID(deviceID, procID);
+    return 0;
+}
@@ -0,0 +1,25 @@
+/*
+ *  input_meter.h
+ *  AudioSwitcher
+ *
+ *  --meter: the peak and RMS level of every channel of an input device,
+ *  reported at a fixed interval, to check that a microphone hears anything
+ *  before switching to it.
+ *
+ *  MIT License, see license.txt
+ */
+
+#ifndef INPUT_METER_H
+#define INPUT_METER_H
+
+#include "audio_switch.h"
+
+#define DEFAULT_METER_INTERVAL_MS 100
+#define MAX_METER_SECONDS 86400
+#define MAX_METER_CHANNELS 32
+// reported for silence instead of minus infinity
+#define METER_FLOOR_DB -120.0
+
+int showInputMeter(AudioDeviceID deviceID, UInt32 seconds, UInt32 intervalMs, ASOutputType outputRequested);
+
+#endif
@@ -0,0 +1,161 @@
+/*
+ *  latency_correlation.c
+ *  AudioSwitcher
+ *
+ *  MIT License, see license.txt
+ */
+
+#include "latency_correlation.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+// feedback taps of a maximum length shift register of each order, from a
+// primitive polynomial of that degree: the term x^k is bit order - k
+static const unsigned int mlsTaps[MAX_MLS_ORDER + 1] = {
+    [8] = 0x1d, [9] = 0x11, [10] = 0x9, [11] = 0x5, [12] = 0x941, [13] = 0x1601, [14] = 0x2a01,
+    [15] = 0x3, [16] = 0x100b, [17] = 0x9, [18] = 0x81, [19] = 0x62001, [20] = 0x9,
+};
+
+// Writes the 2^order - 1 samples of a maximum length sequence, each one
+// plus or minus amplitude, and returns how many were written, or 0 for an
+// unsupported order.  Its autocorrelation is a single spike, which makes
+// the start of the sequence easy to find even in a noisy recording.
+size_t generateMLS(unsigned int order, float amplitude, float *signal) {
+    unsigned int state = 1;
+    size_t length = ((size_t)1 << order) - 1;
+
+    if (order < MIN_MLS_ORDER || order > MAX_MLS_ORDER) {
+        return 0;
+    }
+    for (size_t i = 0; i < length; i++) {
+        signal[i] = (state & 1) ? amplitude : -amplitude;
+        unsigned int feedback = __builtin_parity(state & mlsTaps[order]);
+        state = (state >> 1) | (feedback << (order - 1));
+    }
+    return length;
+}
+
+// Fills capture with what an input would record if signal came back delay
+// samples late at the given gain, over uniform noise of the given peak.
+// The same seed always produces the same recording.
+void generateDelayedCapture(const float *signal, size_t signalLength, size_t delay, float gain, float noise, unsigned int seed, float *capture, size_t captureLength) {
+    unsigned int random = seed ? seed : 1;
+
+    for (size_t i = 0; i < captureLength; i++) {
+        // xorshift, so runs are reproducible on every platform
+        random ^= random << 13;
+        random ^= random >> 17;
+        random ^= random << 5;
+        capture[i] = noise * ((float)random / 4294967295.0f * 2.0f - 1.0f);
+        if (i >= delay && i - delay < signalLength) {
+            capture[i] += gain * signal[i - delay];
+        }
+    }
+}
+
+// In-place radix-2 transform of n complex values.  twiddles holds the n / 2
+// values of exp(-2 pi i k / n), real parts first.
+static void transform(float *real, float *imag, size_t n, const float *twiddles, bool inverse) {
+    const float *twiddleReal = twiddles;
+    const float *twiddleImag = twiddles + n / 2;
+
+    for (size_t i = 1, j = 0; i < n; i++) {
+        size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j ^= bit;
+        if (i < j) {
+            float swap = real[i]; real[i] = real[j]; real[j] = swap;
+            swap = imag[i]; imag[i] = imag[j]; imag[j] = swap;
+        }
+    }
+
+    for (size_t length = 2; length <= n; length <<= 1) {
+        size_t half = length / 2;
+        size_t stride = n / length;
+        for (size_t start = 0; start < n; start += length) {
+            for (size_t k = 0; k < half; k++) {
+                float wr = twiddleReal[k * stride];
+                float wi = inverse ? -twiddleImag[k * stride] : twiddleImag[k * stride];
+                size_t even = start + k;
+                size_t odd = even + half;
+                float tr = real[odd] * wr - imag[odd] * wi;
+                float ti = real[odd] * wi + imag[odd] * wr;
+                real[odd] = real[even] - tr;
+                imag[odd] = imag[even] - ti;
+                real[even] += tr;
+                imag[even] += ti;
+            }
+        }
+    }
+}
+
+// Returns how many samples into capture the signal starts, or -1 when the
+// buffers cannot be allocated.  confidence receives the height of the
+// correlation peak over the RMS of the whole correlation; recordings of
+// noise alone score below 8 or so, a clear signal in the hundreds.
+//
+// Both real inputs go through one complex transform, as the real and
+// imaginary parts, and are separated again by symmetry, so the whole search
+// costs two transforms instead of three.
+long findSignalDelay(const float *signal, size_t signalLength, const float *capture, size_t captureLength, float *confidence) {
+    size_t n = 1;
+    while (n < captureLength + signalLength) n <<= 1;
+
+    float *real = calloc(n, sizeof(float));
+    float *imag = calloc(n, sizeof(float));
+    float *productReal = malloc(n * sizeof(float));
+    float *productImag = malloc(n * sizeof(float));
+    float *twiddles = malloc(n * sizeof(float));
+    long delay = -1;
+
+    if (real == NULL || imag == NULL || productReal == NULL || productImag == NULL || twiddles == NULL) {
+        goto done;
+    }
+    for (size_t k = 0; k < n / 2; k++) {
+        double angle = -2.0 * M_PI * k / n;
+        twiddles[k] = (float)cos(angle);
+        twiddles[n / 2 + k] = (float)sin(angle);
+    }
+    for (size_t i = 0; i < captureLength; i++) real[i] = capture[i];
+    for (size_t i = 0; i < signalLength; i++) imag[i] = signal[i];
+
+    transform(real, imag, n, twiddles, false);
+
+    // with Z the transform of capture + i signal and W = conj(Z[n - k]),
+    // capture's transform is (Z + W) / 2 and signal's is (Z - W) / 2i; the
+    // product is capture's times the conjugate of signal's
+    for (size_t k = 0; k < n; k++) {
+        size_t mirror = (n - k) & (n - 1);
+        float zr = real[k], zi = imag[k];
+        float wr = real[mirror], wi = -imag[mirror];
+        float ar = (zr + wr) * 0.5f, ai = (zi + wi) * 0.5f;
+        float br = (zi - wi) * 0.5f, bi = (zr - wr) * 0.5f;
+        productReal[k] = ar * br - ai * bi;
+        productImag[k] = ar * bi + ai * br;
+    }
+
+    transform(productReal, productImag, n, twiddles, true);
+
+    double sumSquares = 0.0;
+    float peak = 0.0f;
+    for (size_t k = 0; k < captureLength; k++) {
+        // a path that inverts polarity gives a negative peak
+        float value = fabsf(productReal[k]);
+        sumSquares += (double)value * value;
+        if (value > peak) {
+            peak = value;
+            delay = (long)k;
+        }
+    }
+    *confidence = sumSquares > 0.0 ? (float)(peak / sqrt(sumSquares / captureLength)) : 0.0f;
+    if (delay < 0) delay = 0;
+
+done:
+    free(real);
+    free(imag);
+    free(productReal);
+    free(productImag);
+    free(twiddles);
+    return delay;
+}
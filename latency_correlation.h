@@ -0,0 +1,27 @@
+/*
+ *  latency_correlation.h
+ *  AudioSwitcher
+ *
+ *  Finds where a known test signal starts in a recording, by FFT-based
+ *  cross-correlation, for --measure-latency.  Plain C without any audio
+ *  system dependency; generateDelayedCapture builds synthetic recordings
+ *  with a known delay so the search can be checked on any platform.
+ *
+ *  MIT License, see license.txt
+ */
+
+#ifndef LATENCY_CORRELATION_H
+#define LATENCY_CORRELATION_H
+
+#include <stddef.h>
+
+#define MIN_MLS_ORDER 8
+#define MAX_MLS_ORDER 20
+#define LATENCY_MLS_ORDER 15				// the sequence --measure-latency plays
+#define MIN_CORRELATION_CONFIDENCE 10.0f	// below this, the recording did not contain the signal
+
+size_t generateMLS(unsigned int order, float amplitude, float *signal);
+void generateDelayedCapture(const float *signal, size_t signalLength, size_t delay, float gain, float noise, unsigned int seed, float *capture, size_t captureLength);
+long findSignalDelay(const float *signal, size_t signalLength, const float *capture, size_t captureLength, float *confidence);
+
+#endif
@@ -0,0 +1,96 @@
+/*
+ *  level_kernels.c
+ *  AudioSwitcher
+ *
+ *  MIT License, see license.txt
+ */
+
+#include "level_kernels.h"
+#include <math.h>
+#include <string.h>
+
+typedef float ASFloat4 __attribute__((vector_size(16)));
+typedef int ASInt4 __attribute__((vector_size(16)));
+
+static inline ASFloat4 loadFloat4(const float *samples) {
+    ASFloat4 value;
+    memcpy(&value, samples, sizeof(value));
+    return value;
+}
+
+static inline ASFloat4 absFloat4(ASFloat4 value) {
+    return (ASFloat4)((ASInt4)value & 0x7fffffff);
+}
+
+// Comparisons with NaN are false, so a NaN sample never replaces the peak.
+static inline ASFloat4 maxFloat4(ASFloat4 a, ASFloat4 b) {
+    ASInt4 greater = a > b;
+    return (ASFloat4)(((ASInt4)a & greater) | ((ASInt4)b & ~greater));
+}
+
+// The reference: the largest magnitude and the sum of squares of count
+// samples.
+void measureLevelsScalar(const float *samples, size_t count, float *peak, double *sumSquares) {
+    float blockPeak = 0.0f;
+    double blockSum = 0.0;
+
+    for (size_t i = 0; i < count; i++) {
+        float magnitude = fabsf(samples[i]);
+        if (magnitude > blockPeak) blockPeak = magnitude;
+        blockSum += (double)samples[i] * samples[i];
+    }
+    *peak = blockPeak;
+    *sumSquares = blockSum;
+}
+
+// Eight samples per step in two independent accumulators, so consecutive
+// steps do not wait on each other's additions.  The squares are summed in
+// single precision within a call, which IO buffer sizes keep well inside
+// the error the meter can display.
+void measureLevels(const float *samples, size_t count, float *peak, double *sumSquares) {
+    ASFloat4 peak0 = {0.0f, 0.0f, 0.0f, 0.0f};
+    ASFloat4 peak1 = peak0;
+    ASFloat4 sum0 = peak0;
+    ASFloat4 sum1 = peak0;
+    size_t i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        ASFloat4 a = loadFloat4(samples + i);
+        ASFloat4 b = loadFloat4(samples + i + 4);
+        peak0 = maxFloat4(absFloat4(a), peak0);
+        peak1 = maxFloat4(absFloat4(b), peak1);
+        sum0 += a * a;
+        sum1 += b * b;
+    }
+    if (i + 4 <= count) {
+        ASFloat4 a = loadFloat4(samples + i);
+        peak0 = maxFloat4(absFloat4(a), peak0);
+        sum0 += a * a;
+        i += 4;
+    }
+
+    peak0 = maxFloat4(peak0, peak1);
+    sum0 += sum1;
+    float blockPeak = 0.0f;
+    double blockSum = 0.0;
+    for (int lane = 0; lane < 4; lane++) {
+        if (peak0[lane] > blockPeak) blockPeak = peak0[lane];
+        blockSum += sum0[lane];
+    }
+    for (; i < count; i++) {
+        float magnitude = fabsf(samples[i]);
+        if (magnitude > blockPeak) blockPeak = magnitude;
+        blockSum += (double)samples[i] * samples[i];
+    }
+    *peak = blockPeak;
+    *sumSquares = blockSum;
+}
+
+// Copies one channel of interleaved frames into consecutive samples.
+void deinterleaveChannel(const float *interleaved, size_t frames, unsigned int channels, unsigned int channel, float *samples) {
+    const float *source = interleaved + channel;
+
+    for (size_t i = 0; i < frames; i++) {
+        samples[i] = source[i * channels];
+    }
+}
@@ -0,0 +1,24 @@
+/*
+ *  level_kernels.h
+ *  AudioSwitcher
+ *
+ *  Peak and sum of squares of blocks of float samples, the arithmetic of
+ *  the input meter.  Plain C without any audio system dependency, so it
+ *  builds and can be checked on any platform.  measureLevels works on
+ *  vector registers through the compiler's vector extensions (SSE on
+ *  Intel, NEON on Apple silicon); measureLevelsScalar is the reference it
+ *  has to agree with.
+ *
+ *  MIT License, see license.txt
+ */
+
+#ifndef LEVEL_KERNELS_H
+#define LEVEL_KERNELS_H
+
+#include <stddef.h>
+
+void measureLevelsScalar(const float *samples, size_t count, float *peak, double *sumSquares);
+void measureLevels(const float *samples, size_t count, float *peak, double *sumSquares);
+void deinterleaveChannel(const float *interleaved, size_t frames, unsigned int channels, unsigned int channel, float *samples);
+
+#endif
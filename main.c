@@ -1,8 +1,10 @@
 #include "audio_switch.h"
+#include "startup_profile.h"
 
 
 
 int main (int argc, const char * argv[]) {
+	noteMainEntry();
 	return runAudioSwitch(argc, argv);
 }
 
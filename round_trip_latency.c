@@ -0,0 +1,273 @@
+/*
+ *  round_trip_latency.c
+ *  AudioSwitcher
+ *
+ *  MIT License, see license.txt
+ */
+
+#include "round_trip_latency.h"
+#include "latency_correlation.h"
+#include "level_kernels.h"
+#include <mach/mach_time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LATENCY_SIGNAL_AMPLITUDE 0.25f		// -12 dBFS
+#define LATENCY_WINDOW_MS 1500				// longest round trip that can be found
+#define LEAD_IN_CYCLES 4					// input cycles recorded before the signal starts
+#define MAX_LATENCY_STREAMS 16
+#define CAPTURE_POLL_MICROS 10000
+
+typedef struct {
+    size_t startFrame;
+    UInt64 hostTime;
+} ASCaptureCycle;
+
+typedef struct {
+    const float *signal;
+    size_t signalLength;
+    size_t played;			// output proc only
+    UInt64 playHostTime;	// cycle that started the signal, 0 before
+    float *capture;
+    size_t captureLength;
+    size_t captured;
+    ASCaptureCycle *cycles;
+    size_t maxCycles;
+    size_t cycleCount;
+} ASLatencyRun;
+
+static OSStatus latencyOutputProc(AudioObjectID deviceID, const AudioTimeStamp *now, const AudioBufferList *inputData, const AudioTimeStamp *inputTime, AudioBufferList *outputData, const AudioTimeStamp *outputTime, void *clientData) {
+    ASLatencyRun *run = (ASLatencyRun *)clientData;
+    bool playing = __atomic_load_n(&run->playHostTime, __ATOMIC_RELAXED) != 0;
+    size_t frames = 0;
+
+    // the signal starts at the beginning of a cycle once the input has
+    // recorded some silence ahead of it
+    if (!playing && __atomic_load_n(&run->cycleCount, __ATOMIC_ACQUIRE) >= LEAD_IN_CYCLES) {
+        __atomic_store_n(&run->playHostTime, now->mHostTime, __ATOMIC_RELEASE);
+        playing = true;
+    }
+
+    for (UInt32 i = 0; i < outputData->mNumberBuffers; i++) {
+        AudioBuffer *buffer = &outputData->mBuffers[i];
+        UInt32 channels = buffer->mNumberChannels;
+        float *samples = buffer->mData;
+
+        if (samples == NULL || channels == 0) continue;
+        frames = buffer->mDataByteSize / (channels * sizeof(float));
+        for (size_t frame = 0; frame < frames; frame++) {
+            size_t position = run->played + frame;
+            float value = (playing && position < run->signalLength) ? run->signal[position] : 0.0f;
+            for (UInt32 c = 0; c < channels; c++) {
+                samples[frame * channels + c] = value;
+            }
+        }
+    }
+    if (playing) run->played += frames;
+    return noErr;
+}
+
+// Records the first channel of the input, and when each cycle's frames
+// were handed over.
+static OSStatus latencyInputProc(AudioObjectID deviceID, const AudioTimeStamp *now, const AudioBufferList *inputData, const AudioTimeStamp *inputTime, AudioBufferList *outputData, const AudioTimeStamp *outputTime, void *clientData) {
+    ASLatencyRun *run = (ASLatencyRun *)clientData;
+    size_t captured = run->captured;
+
+    if (inputData->mNumberBuffers == 0 || inputData->mBuffers[0].mData == NULL || inputData->mBuffers[0].mNumberChannels == 0) {
+        return noErr;
+    }
+    if (captured >= run->captureLength || run->cycleCount >= run->maxCycles) {
+        return noErr;
+    }
+
+    const AudioBuffer *buffer = &inputData->mBuffers[0];
+    size_t frames = buffer->mDataByteSize / (buffer->mNumberChannels * sizeof(float));
+    if (frames > run->captureLength - captured) frames = run->captureLength - captured;
+    deinterleaveChannel(buffer->mData, frames, buffer->mNumberChannels, 0, run->capture + captured);
+
+    run->cycles[run->cycleCount].startFrame = captured;
+    run->cycles[run->cycleCount].hostTime = now->mHostTime;
+    __atomic_store_n(&run->captured, captured + frames, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&run->cycleCount, 1, __ATOMIC_RELEASE);
+    return noErr;
+}
+
+static UInt32 getLatencyUInt32(AudioObjectID objectID, AudioObjectPropertySelector selector, AudioObjectPropertyScope scope) {
+    AudioObjectPropertyAddress propertyAddress = {selector, scope, kAudioObjectPropertyElementMain};
+    UInt32 value = 0;
+    UInt32 dataSize = sizeof(value);
+    AudioObjectGetPropertyData(objectID, &propertyAddress, 0, NULL, &dataSize, &value);
+    return value;
+}
+
+// Checks that every stream of the scope carries 32-bit floats and returns
+// the first stream, or kAudioObjectUnknown.
+static AudioStreamID getFloatStream(AudioDeviceID deviceID, AudioObjectPropertyScope scope) {
+    AudioObjectPropertyAddress propertyAddress = {kAudioDevicePropertyStreams, scope, kAudioObjectPropertyElementMain};
+    AudioStreamID streams[MAX_LATENCY_STREAMS];
+    UInt32 dataSize = sizeof(streams);
+
+    if (AudioObjectGetPropertyData(deviceID, &propertyAddress, 0, NULL, &dataSize, streams) != noErr || dataSize == 0) {
+        return kAudioObjectUnknown;
+    }
+    for (UInt32 i = 0; i < dataSize / sizeof(AudioStreamID); i++) {
+        AudioObjectPropertyAddress formatAddress = {kAudioStreamPropertyVirtualFormat, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain};
+        AudioStreamBasicDescription format;
+        UInt32 formatSize = sizeof(format);
+
+        if (AudioObjectGetPropertyData(streams[i], &formatAddress, 0, NULL, &formatSize, &format) != noErr ||
+            format.mFormatID != kAudioFormatLinearPCM || !(format.mFormatFlags & kAudioFormatFlagIsFloat) || format.mBitsPerChannel != 32) {
+            return kAudioObjectUnknown;
+        }
+    }
+    return streams[0];
+}
+
+// What the device says one side of the round trip costs, in frames.
+static UInt32 getReportedLatency(AudioDeviceID deviceID, AudioStreamID streamID, AudioObjectPropertyScope scope) {
+    return getLatencyUInt32(deviceID, kAudioDevicePropertyBufferFrameSize, kAudioObjectPropertyScopeGlobal)
+        + getLatencyUInt32(deviceID, kAudioDevicePropertyLatency, scope)
+        + getLatencyUInt32(deviceID, kAudioDevicePropertySafetyOffset, scope)
+        + getLatencyUInt32(streamID, kAudioStreamPropertyLatency, kAudioObjectPropertyScopeGlobal);
+}
+
+static Float64 getLatencySampleRate(AudioDeviceID deviceID) {
+    AudioObjectPropertyAddress propertyAddress = {kAudioDevicePropertyNominalSampleRate, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain};
+    Float64 sampleRate = 0.0;
+    UInt32 dataSize = sizeof(sampleRate);
+    AudioObjectGetPropertyData(deviceID, &propertyAddress, 0, NULL, &dataSize, &sampleRate);
+    return sampleRate;
+}
+
+static void showRoundTrip(const char *outputName, const char *inputName, Float64 sampleRate, double measuredFrames, UInt32 reportedOutput, UInt32 reportedInput, float confidence, ASOutputType outputRequested) {
+    UInt32 reportedFrames = reportedOutput + reportedInput;
+    double measuredMs = measuredFrames * 1000.0 / sampleRate;
+    double reportedMs = reportedFrames * 1000.0 / sampleRate;
+
+    switch (outputRequested) {
+        case kFormatCLI:
+            printf("%s,%s,%.0f,%.0f,%.3f,%u,%.3f,%.1f\n", outputName, inputName, sampleRate, measuredFrames, measuredMs, reportedFrames, reportedMs, confidence);
+            break;
+        case kFormatJSON:
+            printf("{\"output\": \"%s\", \"input\": \"%s\", \"sample_rate\": %.0f, \"measured_frames\": %.0f, \"measured_ms\": %.3f, "
+                   "\"reported_frames\": %u, \"reported_ms\": %.3f, \"reported_output_frames\": %u, \"reported_input_frames\": %u, \"confidence\": %.1f}\n",
+                   outputName, inputName, sampleRate, measuredFrames, measuredMs, reportedFrames, reportedMs, reportedOutput, reportedInput, confidence);
+            break;
+        default:
+            printf("\"%s\" -> \"%s\": %.1f ms measured, %.1f ms reported (%+.1f ms) at %.0f Hz\n",
+                   outputName, inputName, measuredMs, reportedMs, measuredMs - reportedMs, sampleRate);
+            break;
+    }
+}
+
+// Plays the test signal and records until the capture is full, or fails
+// with kASPropertyChangeTimeoutError when the input stops short of that.
+static OSStatus runLatencyCapture(AudioDeviceID outputDeviceID, AudioDeviceID inputDeviceID, ASLatencyRun *run, UInt32 timeoutMs) {
+    AudioDeviceIOProcID outputProcID = NULL;
+    AudioDeviceIOProcID inputProcID = NULL;
+    mach_timebase_info_data_t timebase;
+
+    OSStatus status = AudioDeviceCreateIOProcID(inputDeviceID, latencyInputProc, run, &inputProcID);
+    if (status == noErr) status = AudioDeviceCreateIOProcID(outputDeviceID, latencyOutputProc, run, &outputProcID);
+    if (status == noErr) status = AudioDeviceStart(outputDeviceID, outputProcID);
+    if (status == noErr) status = AudioDeviceStart(inputDeviceID, inputProcID);
+
+    if (status == noErr) {
+        mach_timebase_info(&timebase);
+        UInt64 deadline = mach_absolute_time() + (UInt64)timeoutMs * 1000000ULL * timebase.denom / timebase.numer;
+        while (__atomic_load_n(&run->captured, __ATOMIC_ACQUIRE) < run->captureLength &&
+               __atomic_load_n(&run->cycleCount, __ATOMIC_ACQUIRE) < run->maxCycles) {
+            if (mach_absolute_time() >= deadline) {
+                status = kASPropertyChangeTimeoutError;
+                break;
+            }
+            usleep(CAPTURE_POLL_MICROS);
+        }
+    }
+
+    if (inputProcID != NULL) {
+        AudioDeviceStop(inputDeviceID, inputProcID);
+        AudioDeviceDestroyIOProcID(inputDeviceID, inputProcID);
+    }
+    if (outputProcID != NULL) {
+        AudioDeviceStop(outputDeviceID, outputProcID);
+        AudioDeviceDestroyIOProcID(outputDeviceID, outputProcID);
+    }
+    return status;
+}
+
+int measureRoundTripLatency(AudioDeviceID outputDeviceID, AudioDeviceID inputDeviceID, ASOutputType outputRequested) {
+    char outputName[256];
+    char inputName[256];
+    ASLatencyRun run;
+    float confidence = 0.0f;
+    int result = 1;
+
+    getDeviceName(outputDeviceID, outputName);
+    getDeviceName(inputDeviceID, inputName);
+    AudioStreamID outputStreamID = getFloatStream(outputDeviceID, kAudioObjectPropertyScopeOutput);
+    AudioStreamID inputStreamID = getFloatStream(inputDeviceID, kAudioObjectPropertyScopeInput);
+    if (outputStreamID == kAudioObjectUnknown || inputStreamID == kAudioObjectUnknown) {
+        printf("\"%s\" and \"%s\" need float output and input streams to be measured.\n", outputName, inputName);
+        return 1;
+    }
+    Float64 sampleRate = getLatencySampleRate(outputDeviceID);
+    if (sampleRate <= 0.0 || sampleRate != getLatencySampleRate(inputDeviceID)) {
+        printf("\"%s\" and \"%s\" run at different sample rates; match them first, for example with --match-rate.\n", outputName, inputName);
+        return 1;
+    }
+
+    memset(&run, 0, sizeof(run));
+    float *signal = malloc((((size_t)1 << LATENCY_MLS_ORDER) - 1) * sizeof(float));
+    run.signal = signal;
+    run.signalLength = signal ? generateMLS(LATENCY_MLS_ORDER, LATENCY_SIGNAL_AMPLITUDE, signal) : 0;
+    run.captureLength = run.signalLength + (size_t)(sampleRate * LATENCY_WINDOW_MS / 1000.0);
+    run.capture = malloc(run.captureLength * sizeof(float));
+    // even the smallest IO buffers leave room for every cycle
+    run.maxCycles = run.captureLength / 8 + 1;
+    run.cycles = malloc(run.maxCycles * sizeof(ASCaptureCycle));
+    if (signal == NULL || run.capture == NULL || run.cycles == NULL) {
+        printf("Out of memory.\n");
+        goto done;
+    }
+
+    UInt32 captureMs = (UInt32)(run.captureLength * 1000.0 / sampleRate);
+    OSStatus status = runLatencyCapture(outputDeviceID, inputDeviceID, &run, captureMs + getSwitchTimeout());
+    if (status != noErr) {
+        printf("Could not play to \"%s\" and record from \"%s\". Error: %d (%s)\n", outputName, inputName, status, describeStatus(status));
+        result = status == kASPropertyChangeTimeoutError ? 2 : 1;
+        goto done;
+    }
+
+    long delay = findSignalDelay(run.signal, run.signalLength, run.capture, run.captured, &confidence);
+    if (delay < 0 || confidence < MIN_CORRELATION_CONFIDENCE || run.playHostTime == 0) {
+        printf("The test signal played on \"%s\" was not heard on \"%s\" (confidence %.1f).  Check the volume and how the output reaches the input.\n", outputName, inputName, confidence);
+        goto done;
+    }
+
+    // the cycle that returned the first frame of the signal
+    size_t cycle = run.cycleCount - 1;
+    while (cycle > 0 && run.cycles[cycle].startFrame > (size_t)delay) cycle--;
+    if (run.cycles[cycle].hostTime < run.playHostTime) {
+        printf("The test signal was heard on \"%s\" before it was played; something else is playing the same signal.\n", inputName);
+        goto done;
+    }
+
+    mach_timebase_info_data_t timebase;
+    mach_timebase_info(&timebase);
+    double cycleNanos = (double)(run.cycles[cycle].hostTime - run.playHostTime) * timebase.numer / timebase.denom;
+    double measuredFrames = cycleNanos * sampleRate / 1e9 + (delay - run.cycles[cycle].startFrame);
+
+    showRoundTrip(outputName, inputName, sampleRate, measuredFrames,
+                  getReportedLatency(outputDeviceID, outputStreamID, kAudioObjectPropertyScopeOutput),
+                  getReportedLatency(inputDeviceID, inputStreamID, kAudioObjectPropertyScopeInput),
+                  confidence, outputRequested);
+    result = 0;
+
+done:
+    free(signal);
+    free(run.capture);
+    free(run.cycles);
+    return result;
+}
@@ -0,0 +1,25 @@
+/*
+ *  round_trip_latency.h
+ *  AudioSwitcher
+ *
+ *  --measure-latency: plays a maximum length sequence on an output device,
+ *  records an input device, and finds how long the sequence took to come
+ *  back, to compare with what the devices report about their latency.
+ *
+ *  The round trip is counted the way an application doing both input and
+ *  output sees it: from the IO cycle that hands the first test sample to
+ *  the output to the cycle that returns it from the input, plus its
+ *  position in that cycle's buffer.  The reported figure is the buffer
+ *  size, latency, safety offset and stream latency of both sides.
+ *
+ *  MIT License, see license.txt
+ */
+
+#ifndef ROUND_TRIP_LATENCY_H
+#define ROUND_TRIP_LATENCY_H
+
+#include "audio_switch.h"
+
+int measureRoundTripLatency(AudioDeviceID outputDeviceID, AudioDeviceID inputDeviceID, ASOutputType outputRequested);
+
+#endif
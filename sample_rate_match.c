@@ -0,0 +1,245 @@
+/*
+ *  sample_rate_match.c
+ *  AudioSwitcher
+ *
+ *  MIT License, see license.txt
+ */
+
+#include "sample_rate_match.h"
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+
+#define MAX_RATE_RANGES 32
+
+// rates tried inside continuous ranges, besides the ends of every range
+static const Float64 commonRates[] = {8000, 11025, 16000, 22050, 32000, 44100, 48000, 88200, 96000, 176400, 192000, 352800, 384000};
+
+static bool matching = false;
+static Float64 preferredRate = 0.0;
+static bool switchPending = false;
+static bool watching = false;
+static ASOutputType watchFormat = kFormatHuman;
+
+static pthread_mutex_t changeMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t changeCond = PTHREAD_COND_INITIALIZER;
+static bool defaultsChanged = false;
+
+static const AudioObjectPropertySelector watchedSelectors[] = {
+    kAudioHardwarePropertyDevices,
+    kAudioHardwarePropertyDefaultInputDevice,
+    kAudioHardwarePropertyDefaultOutputDevice,
+};
+
+// preferred is the rate to use whenever both devices support it, 0 for the
+// highest rate they have in common.
+void setRateMatching(bool enabled, Float64 preferred) {
+    matching = enabled;
+    preferredRate = preferred;
+}
+
+bool isRateMatching(void) {
+    return matching;
+}
+
+// Called by setOneDevice for every confirmed switch.  The system output
+// device does no input, so it has nothing to match.
+void noteDefaultDeviceSwitched(ASDeviceType typeRequested) {
+    if (typeRequested == kAudioTypeInput || typeRequested == kAudioTypeOutput) {
+        switchPending = true;
+    }
+}
+
+static Float64 getNominalSampleRate(AudioDeviceID deviceID) {
+    AudioObjectPropertyAddress propertyAddress = {kAudioDevicePropertyNominalSampleRate, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain};
+    Float64 sampleRate = 0.0;
+    UInt32 dataSize = sizeof(sampleRate);
+    AudioObjectGetPropertyData(deviceID, &propertyAddress, 0, NULL, &dataSize, &sampleRate);
+    return sampleRate;
+}
+
+static UInt32 getAvailableRates(AudioDeviceID deviceID, AudioValueRange *ranges) {
+    AudioObjectPropertyAddress propertyAddress = {kAudioDevicePropertyAvailableNominalSampleRates, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain};
+    UInt32 dataSize = MAX_RATE_RANGES * sizeof(AudioValueRange);
+
+    if (AudioObjectGetPropertyData(deviceID, &propertyAddress, 0, NULL, &dataSize, ranges) != noErr) {
+        return 0;
+    }
+    return dataSize / sizeof(AudioValueRange);
+}
+
+static bool isRateInRanges(Float64 sampleRate, const AudioValueRange *ranges, UInt32 rangeCount) {
+    for (UInt32 i = 0; i < rangeCount; i++) {
+        if (sampleRate >= ranges[i].mMinimum && sampleRate <= ranges[i].mMaximum) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void considerRate(Float64 sampleRate, const AudioValueRange *inputRanges, UInt32 inputCount, const AudioValueRange *outputRanges, UInt32 outputCount, Float64 *best) {
+    if (sampleRate > *best && isRateInRanges(sampleRate, inputRanges, inputCount) && isRateInRanges(sampleRate, outputRanges, outputCount)) {
+        *best = sampleRate;
+    }
+}
+
+// Returns the rate both devices should run at, or 0 when they have none in
+// common.  Devices already running at the same rate are left there unless a
+// preferred rate is configured that both support.
+static Float64 chooseCommonRate(AudioDeviceID inputID, AudioDeviceID outputID, Float64 inputRate, Float64 outputRate) {
+    AudioValueRange inputRanges[MAX_RATE_RANGES];
+    AudioValueRange outputRanges[MAX_RATE_RANGES];
+    UInt32 inputCount = getAvailableRates(inputID, inputRanges);
+    UInt32 outputCount = getAvailableRates(outputID, outputRanges);
+    Float64 best = 0.0;
+
+    if (preferredRate > 0.0 && isRateInRanges(preferredRate, inputRanges, inputCount) && isRateInRanges(preferredRate, outputRanges, outputCount)) {
+        return preferredRate;
+    }
+    if (inputRate == outputRate) {
+        return inputRate;
+    }
+
+    for (UInt32 i = 0; i < inputCount; i++) {
+        considerRate(inputRanges[i].mMinimum, inputRanges, inputCount, outputRanges, outputCount, &best);
+        considerRate(inputRanges[i].mMaximum, inputRanges, inputCount, outputRanges, outputCount, &best);
+    }
+    for (UInt32 i = 0; i < outputCount; i++) {
+        considerRate(outputRanges[i].mMinimum, inputRanges, inputCount, outputRanges, outputCount, &best);
+        considerRate(outputRanges[i].mMaximum, inputRanges, inputCount, outputRanges, outputCount, &best);
+    }
+    for (size_t i = 0; i < sizeof(commonRates) / sizeof(commonRates[0]); i++) {
+        considerRate(commonRates[i], inputRanges, inputCount, outputRanges, outputCount, &best);
+    }
+    return best;
+}
+
+static void showRateMatch(AudioDeviceID deviceID, ASDeviceType deviceType, Float64 fromRate, Float64 toRate, ASOutputType outputRequested) {
+    char deviceName[256];
+
+    getDeviceName(deviceID, deviceName);
+    switch (outputRequested) {
+        case kFormatCLI:
+            printf("%s,%s,%u,%.0f,%.0f\n", deviceName, deviceTypeName(deviceType), deviceID, fromRate, toRate);
+            break;
+        case kFormatJSON:
+            printf("{\"name\": \"%s\", \"type\": \"%s\", \"id\": \"%u\", \"previous_rate\": %.0f, \"rate\": %.0f, \"changed\": %s}\n",
+                   deviceName, deviceTypeName(deviceType), deviceID, fromRate, toRate, fromRate != toRate ? "true" : "false");
+            break;
+        default:
+            if (fromRate != toRate) {
+                printf("%s audio device \"%s\" sample rate changed from %.0f to %.0f Hz\n", deviceTypeName(deviceType), deviceName, fromRate, toRate);
+            } else {
+                printf("%s audio device \"%s\" already runs at %.0f Hz\n", deviceTypeName(deviceType), deviceName, toRate);
+            }
+            break;
+    }
+}
+
+static int applyMatchedRate(AudioDeviceID deviceID, ASDeviceType deviceType, Float64 fromRate, Float64 toRate, ASOutputType outputRequested) {
+    AudioObjectPropertyAddress propertyAddress = {kAudioDevicePropertyNominalSampleRate, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain};
+
+    if (fromRate != toRate) {
+        OSStatus status = setPropertyAndWait(deviceID, &propertyAddress, sizeof(toRate), &toRate, getSwitchTimeout(), NULL);
+        if (status != noErr) {
+            printf("Could not set the sample rate of %s device %u to %.0f. Error: %d (%s)\n", deviceTypeName(deviceType), deviceID, toRate, status, describeStatus(status));
+            return status == kASPropertyChangeTimeoutError ? 2 : 1;
+        }
+    }
+    showRateMatch(deviceID, deviceType, fromRate, toRate, outputRequested);
+    return 0;
+}
+
+// Brings the default input and output devices to a common nominal rate,
+// changing only the ones that differ from it, and reports both.
+int matchDefaultSampleRates(ASOutputType outputRequested) {
+    AudioDeviceID inputID = getCurrentlySelectedDeviceID(kAudioTypeInput);
+    AudioDeviceID outputID = getCurrentlySelectedDeviceID(kAudioTypeOutput);
+
+    if (inputID == kAudioDeviceUnknown || outputID == kAudioDeviceUnknown) {
+        return 0;
+    }
+    Float64 inputRate = getNominalSampleRate(inputID);
+    Float64 outputRate = getNominalSampleRate(outputID);
+
+    // a device doing both runs at a single rate
+    if (inputID == outputID) {
+        showRateMatch(outputID, kAudioTypeOutput, outputRate, outputRate, outputRequested);
+        return 0;
+    }
+
+    Float64 commonRate = chooseCommonRate(inputID, outputID, inputRate, outputRate);
+    if (commonRate <= 0.0) {
+        printf("The default input and output devices have no sample rate in common.\n");
+        return 1;
+    }
+
+    int result = applyMatchedRate(inputID, kAudioTypeInput, inputRate, commonRate, outputRequested);
+    if (result != 0) {
+        return result;
+    }
+    return applyMatchedRate(outputID, kAudioTypeOutput, outputRate, commonRate, outputRequested);
+}
+
+// Matches rates once a command that may have switched devices is done, so
+// switching input and output together only matches the final pair.
+int matchRatesAfterSwitch(int switchResult, ASOutputType outputRequested) {
+    if (switchResult != 0 || !matching || !switchPending) {
+        return switchResult;
+    }
+    switchPending = false;
+    return matchDefaultSampleRates(outputRequested);
+}
+
+static OSStatus defaultsChangeListener(AudioObjectID objectID, UInt32 numberAddresses, const AudioObjectPropertyAddress *addresses, void *clientData) {
+    pthread_mutex_lock(&changeMutex);
+    defaultsChanged = true;
+    pthread_cond_signal(&changeCond);
+    pthread_mutex_unlock(&changeMutex);
+    return noErr;
+}
+
+// Rates are set off the HAL's notification thread, since waiting for the
+// change to be confirmed needs that thread to deliver the confirmation.
+static void *rateMatchThread(void *context) {
+    for (;;) {
+        pthread_mutex_lock(&changeMutex);
+        while (!defaultsChanged) {
+            pthread_cond_wait(&changeCond, &changeMutex);
+        }
+        defaultsChanged = false;
+        pthread_mutex_unlock(&changeMutex);
+
+        matchDefaultSampleRates(watchFormat);
+        fflush(stdout);
+    }
+    return NULL;
+}
+
+// Keeps matching in the background for the modes that keep running.  Does
+// nothing unless --match-rate was given.
+void watchDefaultSampleRates(ASOutputType outputRequested) {
+    pthread_t thread;
+    sigset_t allSignals;
+    sigset_t previousSignals;
+
+    if (!matching || watching) {
+        return;
+    }
+    watching = true;
+    watchFormat = outputRequested;
+
+    for (size_t i = 0; i < sizeof(watchedSelectors) / sizeof(watchedSelectors[0]); i++) {
+        AudioObjectPropertyAddress propertyAddress = {watchedSelectors[i], kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain};
+        AudioObjectAddPropertyListener(kAudioObjectSystemObject, &propertyAddress, defaultsChangeListener, NULL);
+    }
+
+    // the thread takes no signals, so they keep reaching the sigwait the
+    // running mode waits on
+    sigfillset(&allSignals);
+    pthread_sigmask(SIG_BLOCK, &allSignals, &previousSignals);
+    if (pthread_create(&thread, NULL, rateMatchThread, NULL) == 0) {
+        pthread_detach(thread);
+    }
+    pthread_sigmask(SIG_SETMASK, &previousSignals, NULL);
+}
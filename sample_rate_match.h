@@ -0,0 +1,26 @@
+/*
+ *  sample_rate_match.h
+ *  AudioSwitcher
+ *
+ *  --match-rate: keeps the default input and output devices at the same
+ *  nominal sample rate, so applications doing both input and output do not
+ *  have to convert between them.  Matching runs after a switch and, in the
+ *  modes that keep running, whenever a default device changes or a device
+ *  comes or goes.
+ *
+ *  MIT License, see license.txt
+ */
+
+#ifndef SAMPLE_RATE_MATCH_H
+#define SAMPLE_RATE_MATCH_H
+
+#include "audio_switch.h"
+
+void setRateMatching(bool enabled, Float64 preferredRate);
+bool isRateMatching(void);
+void noteDefaultDeviceSwitched(ASDeviceType typeRequested);
+int matchDefaultSampleRates(ASOutputType outputRequested);
+int matchRatesAfterSwitch(int switchResult, ASOutputType outputRequested);
+void watchDefaultSampleRates(ASOutputType outputRequested);
+
+#endif
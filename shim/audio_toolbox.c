@@ -0,0 +1,33 @@
+/*
+ *  audio_toolbox.c
+ *  AudioSwitcher
+ *
+ *  AudioHardwareService without AudioToolbox.  On a Mac it serves the
+ *  virtual main volume and balance from the device's own controls; here
+ *  there are no controls to serve them from, so every call is handed to the
+ *  HAL stand-in as it is, which answers as a device without them would.
+ *
+ *  MIT License, see license.txt
+ */
+
+#include <AudioToolbox/AudioServices.h>
+
+Boolean AudioHardwareServiceHasProperty(AudioObjectID objectID, const AudioObjectPropertyAddress *address) {
+    return AudioObjectHasProperty(objectID, address);
+}
+
+OSStatus AudioHardwareServiceIsPropertySettable(AudioObjectID objectID, const AudioObjectPropertyAddress *address, Boolean *outIsSettable) {
+    return AudioObjectIsPropertySettable(objectID, address, outIsSettable);
+}
+
+OSStatus AudioHardwareServiceGetPropertyDataSize(AudioObjectID objectID, const AudioObjectPropertyAddress *address, UInt32 qualifierSize, const void *qualifier, UInt32 *outDataSize) {
+    return AudioObjectGetPropertyDataSize(objectID, address, qualifierSize, qualifier, outDataSize);
+}
+
+OSStatus AudioHardwareServiceGetPropertyData(AudioObjectID objectID, const AudioObjectPropertyAddress *address, UInt32 qualifierSize, const void *qualifier, UInt32 *ioDataSize, void *outData) {
+    return AudioObjectGetPropertyData(objectID, address, qualifierSize, qualifier, ioDataSize, outData);
+}
+
+OSStatus AudioHardwareServiceSetPropertyData(AudioObjectID objectID, const AudioObjectPropertyAddress *address, UInt32 qualifierSize, const void *qualifier, UInt32 dataSize, const void *data) {
+    return AudioObjectSetPropertyData(objectID, address, qualifierSize, qualifier, dataSize, data);
+}
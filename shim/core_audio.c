@@ -0,0 +1,65 @@
+/*
+ *  core_audio.c
+ *  AudioSwitcher
+ *
+ *  Stands in for the HAL where there is none.  Every call fails as the HAL
+ *  does when coreaudiod is not running, so the only way to get answers is
+ *  to replay a trace recorded on a Mac with --replay, which never reaches
+ *  these functions.
+ *
+ *  MIT License, see license.txt
+ */
+
+#include <CoreAudio/CoreAudio.h>
+
+OSStatus AudioObjectGetPropertyDataSize(AudioObjectID objectID, const AudioObjectPropertyAddress *address, UInt32 qualifierSize, const void *qualifier, UInt32 *outDataSize) {
+    return kAudioHardwareNotRunningError;
+}
+
+OSStatus AudioObjectGetPropertyData(AudioObjectID objectID, const AudioObjectPropertyAddress *address, UInt32 qualifierSize, const void *qualifier, UInt32 *ioDataSize, void *outData) {
+    return kAudioHardwareNotRunningError;
+}
+
+OSStatus AudioObjectSetPropertyData(AudioObjectID objectID, const AudioObjectPropertyAddress *address, UInt32 qualifierSize, const void *qualifier, UInt32 dataSize, const void *data) {
+    return kAudioHardwareNotRunningError;
+}
+
+Boolean AudioObjectHasProperty(AudioObjectID objectID, const AudioObjectPropertyAddress *address) {
+    return false;
+}
+
+OSStatus AudioObjectIsPropertySettable(AudioObjectID objectID, const AudioObjectPropertyAddress *address, Boolean *outIsSettable) {
+    return kAudioHardwareNotRunningError;
+}
+
+OSStatus AudioObjectAddPropertyListener(AudioObjectID objectID, const AudioObjectPropertyAddress *address, AudioObjectPropertyListenerProc listener, void *clientData) {
+    return kAudioHardwareNotRunningError;
+}
+
+OSStatus AudioObjectRemovePropertyListener(AudioObjectID objectID, const AudioObjectPropertyAddress *address, AudioObjectPropertyListenerProc listener, void *clientData) {
+    return kAudioHardwareNotRunningError;
+}
+
+OSStatus AudioDeviceCreateIOProcID(AudioObjectID device, AudioDeviceIOProc proc, void *clientData, AudioDeviceIOProcID *outIOProcID) {
+    return kAudioHardwareNotRunningError;
+}
+
+OSStatus AudioDeviceDestroyIOProcID(AudioObjectID device, AudioDeviceIOProcID ioProcID) {
+    return kAudioHardwareNotRunningError;
+}
+
+OSStatus AudioDeviceStart(AudioObjectID device, AudioDeviceIOProcID ioProcID) {
+    return kAudioHardwareNotRunningError;
+}
+
+OSStatus AudioDeviceStop(AudioObjectID device, AudioDeviceIOProcID ioProcID) {
+    return kAudioHardwareNotRunningError;
+}
+
+OSStatus AudioHardwareCreateAggregateDevice(CFDictionaryRef description, AudioObjectID *outDeviceID) {
+    return kAudioHardwareNotRunningError;
+}
+
+OSStatus AudioHardwareDestroyAggregateDevice(AudioObjectID deviceID) {
+    return kAudioHardwareNotRunningError;
+}
@@ -0,0 +1,390 @@
+/*
+ *  core_foundation.c
+ *  AudioSwitcher
+ *
+ *  Reference counted property list objects behind the CoreFoundation calls
+ *  SwitchAudioSource makes.  Strings hold UTF-8, so lengths are in bytes;
+ *  arrays and dictionaries always retain their contents and compare keys
+ *  by value.
+ *
+ *  MIT License, see license.txt
+ */
+
+#include <CoreFoundation/CoreFoundation.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+enum {
+    kTypeString     = 1,
+    kTypeNumber     = 2,
+    kTypeBoolean    = 3,
+    kTypeArray      = 4,
+    kTypeDictionary = 5,
+};
+
+// objects with a negative retain count are never freed
+typedef struct {
+    CFTypeID type;
+    int retainCount;
+} ASObject;
+
+struct __CFString {
+    ASObject object;
+    CFIndex length;
+    char text[];
+};
+
+struct __CFNumber {
+    ASObject object;
+    bool isFloat;
+    SInt64 integer;
+    Float64 real;
+};
+
+struct __CFBoolean {
+    ASObject object;
+    Boolean value;
+};
+
+struct __CFArray {
+    ASObject object;
+    CFIndex count;
+    CFIndex capacity;
+    CFTypeRef *values;
+};
+
+struct __CFDictionary {
+    ASObject object;
+    CFIndex count;
+    CFIndex capacity;
+    CFTypeRef *keys;
+    CFTypeRef *values;
+};
+
+typedef struct ASConstantString {
+    struct ASConstantString *next;
+    CFStringRef string;
+} ASConstantString;
+
+static const struct __CFBoolean trueBoolean = {{kTypeBoolean, -1}, 1};
+static const struct __CFBoolean falseBoolean = {{kTypeBoolean, -1}, 0};
+static pthread_mutex_t constantMutex = PTHREAD_MUTEX_INITIALIZER;
+static ASConstantString *constantStrings = NULL;
+
+const CFAllocatorRef kCFAllocatorDefault = NULL;
+const CFArrayCallBacks kCFTypeArrayCallBacks = {0};
+const CFDictionaryKeyCallBacks kCFTypeDictionaryKeyCallBacks = {0};
+const CFDictionaryValueCallBacks kCFTypeDictionaryValueCallBacks = {0};
+const CFBooleanRef kCFBooleanTrue = &trueBoolean;
+const CFBooleanRef kCFBooleanFalse = &falseBoolean;
+const CFStringRef kCFRunLoopDefaultMode = NULL;
+
+static void *createObject(CFTypeID type, size_t size) {
+    ASObject *object = calloc(1, size);
+    if (object != NULL) {
+        object->type = type;
+        object->retainCount = 1;
+    }
+    return object;
+}
+
+CFTypeRef CFRetain(CFTypeRef object) {
+    ASObject *header = (ASObject *)object;
+    if (header != NULL && __atomic_load_n(&header->retainCount, __ATOMIC_RELAXED) >= 0) {
+        __atomic_fetch_add(&header->retainCount, 1, __ATOMIC_RELAXED);
+    }
+    return object;
+}
+
+void CFRelease(CFTypeRef object) {
+    ASObject *header = (ASObject *)object;
+    if (header == NULL || __atomic_load_n(&header->retainCount, __ATOMIC_RELAXED) < 0 ||
+        __atomic_sub_fetch(&header->retainCount, 1, __ATOMIC_ACQ_REL) > 0) {
+        return;
+    }
+    if (header->type == kTypeArray) {
+        struct __CFArray *array = (struct __CFArray *)object;
+        for (CFIndex i = 0; i < array->count; i++) CFRelease(array->values[i]);
+        free(array->values);
+    } else if (header->type == kTypeDictionary) {
+        struct __CFDictionary *dictionary = (struct __CFDictionary *)object;
+        for (CFIndex i = 0; i < dictionary->count; i++) {
+            CFRelease(dictionary->keys[i]);
+            CFRelease(dictionary->values[i]);
+        }
+        free(dictionary->keys);
+        free(dictionary->values);
+    }
+    free(header);
+}
+
+CFTypeID CFGetTypeID(CFTypeRef object) {
+    return object ? ((const ASObject *)object)->type : 0;
+}
+
+Boolean CFEqual(CFTypeRef a, CFTypeRef b) {
+    if (a == b) return true;
+    if (a == NULL || b == NULL || CFGetTypeID(a) != CFGetTypeID(b)) return false;
+
+    switch (CFGetTypeID(a)) {
+        case kTypeString: {
+            CFStringRef first = a, second = b;
+            return first->length == second->length && memcmp(first->text, second->text, first->length) == 0;
+        }
+        case kTypeNumber: {
+            CFNumberRef first = a, second = b;
+            if (first->isFloat || second->isFloat) {
+                return (first->isFloat ? first->real : first->integer) == (second->isFloat ? second->real : second->integer);
+            }
+            return first->integer == second->integer;
+        }
+        case kTypeArray: {
+            CFArrayRef first = a, second = b;
+            if (first->count != second->count) return false;
+            for (CFIndex i = 0; i < first->count; i++) {
+                if (!CFEqual(first->values[i], second->values[i])) return false;
+            }
+            return true;
+        }
+        case kTypeDictionary: {
+            CFDictionaryRef first = a, second = b;
+            if (first->count != second->count) return false;
+            for (CFIndex i = 0; i < first->count; i++) {
+                if (!CFEqual(first->values[i], CFDictionaryGetValue(second, first->keys[i]))) return false;
+            }
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+CFTypeID CFStringGetTypeID(void) {
+    return kTypeString;
+}
+
+CFStringRef CFStringCreateWithBytes(CFAllocatorRef allocator, const UInt8 *bytes, CFIndex length, CFStringEncoding encoding, Boolean isExternalRepresentation) {
+    struct __CFString *string = createObject(kTypeString, sizeof(struct __CFString) + length + 1);
+    if (string != NULL) {
+        memcpy(string->text, bytes, length);
+        string->text[length] = '\0';
+        string->length = length;
+    }
+    return string;
+}
+
+CFStringRef CFStringCreateWithCString(CFAllocatorRef allocator, const char *text, CFStringEncoding encoding) {
+    return text ? CFStringCreateWithBytes(allocator, (const UInt8 *)text, strlen(text), encoding, false) : NULL;
+}
+
+CFIndex CFStringGetLength(CFStringRef string) {
+    return string ? string->length : 0;
+}
+
+CFIndex CFStringGetMaximumSizeForEncoding(CFIndex length, CFStringEncoding encoding) {
+    return length * 3;
+}
+
+Boolean CFStringGetCString(CFStringRef string, char *buffer, CFIndex bufferSize, CFStringEncoding encoding) {
+    if (string == NULL || bufferSize <= string->length) {
+        return false;
+    }
+    memcpy(buffer, string->text, string->length + 1);
+    return true;
+}
+
+CFRange CFStringFind(CFStringRef string, CFStringRef find, CFStringCompareFlags options) {
+    const char *found = strstr(string->text, find->text);
+    return found ? (CFRange){found - string->text, find->length} : (CFRange){kCFNotFound, 0};
+}
+
+// CFSTR literals are made once and live as long as the process.
+CFStringRef __CFStringMakeConstantString(const char *text) {
+    CFStringRef string = NULL;
+
+    pthread_mutex_lock(&constantMutex);
+    for (ASConstantString *constant = constantStrings; constant != NULL && string == NULL; constant = constant->next) {
+        if (strcmp(constant->string->text, text) == 0) string = constant->string;
+    }
+    if (string == NULL) {
+        ASConstantString *constant = malloc(sizeof(ASConstantString));
+        string = CFStringCreateWithCString(kCFAllocatorDefault, text, kCFStringEncodingUTF8);
+        ((ASObject *)string)->retainCount = -1;
+        constant->string = string;
+        constant->next = constantStrings;
+        constantStrings = constant;
+    }
+    pthread_mutex_unlock(&constantMutex);
+    return string;
+}
+
+CFTypeID CFNumberGetTypeID(void) {
+    return kTypeNumber;
+}
+
+CFNumberRef CFNumberCreate(CFAllocatorRef allocator, CFNumberType type, const void *value) {
+    struct __CFNumber *number = createObject(kTypeNumber, sizeof(struct __CFNumber));
+    if (number == NULL) return NULL;
+
+    switch (type) {
+        case kCFNumberSInt8Type:
+        case kCFNumberCharType:
+            number->integer = *(const SInt8 *)value;
+            break;
+        case kCFNumberSInt16Type:
+        case kCFNumberShortType:
+            number->integer = *(const SInt16 *)value;
+            break;
+        case kCFNumberSInt32Type:
+        case kCFNumberIntType:
+            number->integer = *(const SInt32 *)value;
+            break;
+        case kCFNumberFloat32Type:
+        case kCFNumberFloatType:
+            number->isFloat = true;
+            number->real = *(const Float32 *)value;
+            break;
+        case kCFNumberFloat64Type:
+        case kCFNumberDoubleType:
+            number->isFloat = true;
+            number->real = *(const Float64 *)value;
+            break;
+        default:
+            number->integer = *(const SInt64 *)value;
+            break;
+    }
+    return number;
+}
+
+Boolean CFNumberGetValue(CFNumberRef number, CFNumberType type, void *value) {
+    SInt64 integer = number->isFloat ? (SInt64)number->real : number->integer;
+    Float64 real = number->isFloat ? number->real : (Float64)number->integer;
+
+    switch (type) {
+        case kCFNumberSInt8Type:
+        case kCFNumberCharType:
+            *(SInt8 *)value = (SInt8)integer;
+            break;
+        case kCFNumberSInt16Type:
+        case kCFNumberShortType:
+            *(SInt16 *)value = (SInt16)integer;
+            break;
+        case kCFNumberSInt32Type:
+        case kCFNumberIntType:
+            *(SInt32 *)value = (SInt32)integer;
+            break;
+        case kCFNumberFloat32Type:
+        case kCFNumberFloatType:
+            *(Float32 *)value = (Float32)real;
+            break;
+        case kCFNumberFloat64Type:
+        case kCFNumberDoubleType:
+            *(Float64 *)value = real;
+            break;
+        default:
+            *(SInt64 *)value = integer;
+            break;
+    }
+    return true;
+}
+
+Boolean CFNumberIsFloatType(CFNumberRef number) {
+    return number->isFloat;
+}
+
+CFTypeID CFBooleanGetTypeID(void) {
+    return kTypeBoolean;
+}
+
+Boolean CFBooleanGetValue(CFBooleanRef boolean) {
+    return boolean->value;
+}
+
+CFTypeID CFArrayGetTypeID(void) {
+    return kTypeArray;
+}
+
+CFMutableArrayRef CFArrayCreateMutable(CFAllocatorRef allocator, CFIndex capacity, const CFArrayCallBacks *callBacks) {
+    return createObject(kTypeArray, sizeof(struct __CFArray));
+}
+
+CFIndex CFArrayGetCount(CFArrayRef array) {
+    return array->count;
+}
+
+const void *CFArrayGetValueAtIndex(CFArrayRef array, CFIndex index) {
+    return index >= 0 && index < array->count ? array->values[index] : NULL;
+}
+
+static bool growValues(CFTypeRef **values, CFIndex *capacity, CFIndex count) {
+    if (count < *capacity) return true;
+    CFIndex grown = *capacity ? *capacity * 2 : 8;
+    CFTypeRef *resized = realloc(*values, grown * sizeof(CFTypeRef));
+    if (resized == NULL) return false;
+    *values = resized;
+    *capacity = grown;
+    return true;
+}
+
+void CFArrayAppendValue(CFMutableArrayRef array, const void *value) {
+    if (growValues(&array->values, &array->capacity, array->count)) {
+        array->values[array->count++] = CFRetain(value);
+    }
+}
+
+CFTypeID CFDictionaryGetTypeID(void) {
+    return kTypeDictionary;
+}
+
+CFMutableDictionaryRef CFDictionaryCreateMutable(CFAllocatorRef allocator, CFIndex capacity, const CFDictionaryKeyCallBacks *keyCallBacks, const CFDictionaryValueCallBacks *valueCallBacks) {
+    return createObject(kTypeDictionary, sizeof(struct __CFDictionary));
+}
+
+CFIndex CFDictionaryGetCount(CFDictionaryRef dictionary) {
+    return dictionary->count;
+}
+
+static CFIndex findKey(CFDictionaryRef dictionary, const void *key) {
+    for (CFIndex i = 0; i < dictionary->count; i++) {
+        if (CFEqual(dictionary->keys[i], key)) return i;
+    }
+    return kCFNotFound;
+}
+
+const void *CFDictionaryGetValue(CFDictionaryRef dictionary, const void *key) {
+    CFIndex index = findKey(dictionary, key);
+    return index != kCFNotFound ? dictionary->values[index] : NULL;
+}
+
+void CFDictionaryGetKeysAndValues(CFDictionaryRef dictionary, const void **keys, const void **values) {
+    for (CFIndex i = 0; i < dictionary->count; i++) {
+        if (keys) keys[i] = dictionary->keys[i];
+        if (values) values[i] = dictionary->values[i];
+    }
+}
+
+void CFDictionarySetValue(CFMutableDictionaryRef dictionary, const void *key, const void *value) {
+    CFIndex index = findKey(dictionary, key);
+    CFIndex keyCapacity = dictionary->capacity;
+
+    if (index != kCFNotFound) {
+        CFRetain(value);
+        CFRelease(dictionary->values[index]);
+        dictionary->values[index] = value;
+        return;
+    }
+    if (!growValues(&dictionary->keys, &keyCapacity, dictionary->count) ||
+        !growValues(&dictionary->values, &dictionary->capacity, dictionary->count)) {
+        return;
+    }
+    dictionary->keys[dictionary->count] = CFRetain(key);
+    dictionary->values[dictionary->count++] = CFRetain(value);
+}
+
+SInt32 CFRunLoopRunInMode(CFStringRef mode, CFTimeInterval seconds, Boolean returnAfterSourceHandled) {
+    struct timespec delay = {(time_t)seconds, (long)((seconds - (time_t)seconds) * 1e9)};
+    nanosleep(&delay, NULL);
+    return kCFRunLoopRunTimedOut;
+}
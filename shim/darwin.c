@@ -0,0 +1,123 @@
+/*
+ *  darwin.c
+ *  AudioSwitcher
+ *
+ *  The Darwin system calls SwitchAudioSource makes outside CoreAudio, on
+ *  top of Linux: host time, process names and start times from /proc, and
+ *  a DNS-SD that has no responder to talk to.
+ *
+ *  MIT License, see license.txt
+ */
+
+#include <dns_sd.h>
+#include <errno.h>
+#include <libproc.h>
+#include <mach/mach_time.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/sysctl.h>
+#include <time.h>
+#include <unistd.h>
+
+extern char *program_invocation_short_name;
+
+uint64_t mach_absolute_time(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+int mach_timebase_info(mach_timebase_info_data_t *info) {
+    info->numer = 1;
+    info->denom = 1;
+    return 0;
+}
+
+int mach_wait_until(uint64_t deadline) {
+    struct timespec until = {(time_t)(deadline / 1000000000ULL), (long)(deadline % 1000000000ULL)};
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, NULL) == EINTR) {
+    }
+    return 0;
+}
+
+int proc_name(int pid, void *buffer, uint32_t bufferSize) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/comm", pid);
+    FILE *file = fopen(path, "r");
+    if (file == NULL || bufferSize == 0) {
+        if (file) fclose(file);
+        return 0;
+    }
+    char *name = fgets(buffer, bufferSize, file);
+    fclose(file);
+    if (name == NULL) {
+        return 0;
+    }
+    name[strcspn(name, "\n")] = '\0';
+    return (int)strlen(name);
+}
+
+const char *getprogname(void) {
+    return program_invocation_short_name;
+}
+
+// Only the start time of a process is filled in: how long after boot it
+// started, in clock ticks from /proc/<pid>/stat, against the uptime, taken
+// back from the wall clock.  Both are only kept in hundredths of a second.
+int sysctl(int *name, unsigned int nameLength, void *oldValue, size_t *oldLength, void *newValue, size_t newLength) {
+    char path[64];
+    char line[1024];
+    unsigned long long startTicks = 0;
+    double uptime = 0.0;
+    struct timespec now;
+
+    if (nameLength != 4 || name[0] != CTL_KERN || name[1] != KERN_PROC || name[2] != KERN_PROC_PID ||
+        oldValue == NULL || *oldLength < sizeof(struct kinfo_proc)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    snprintf(path, sizeof(path), "/proc/%d/stat", name[3]);
+    FILE *file = fopen(path, "r");
+    if (file == NULL) return -1;
+    char *fields = fgets(line, sizeof(line), file) ? strrchr(line, ')') : NULL;
+    fclose(file);
+    // the start time is the 22nd field, the 20th after the command name
+    if (fields == NULL || sscanf(fields + 1, " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %*u %*u %*d %*d %*d %*d %*d %*d %llu", &startTicks) != 1) {
+        errno = ESRCH;
+        return -1;
+    }
+
+    file = fopen("/proc/uptime", "r");
+    if (file == NULL) return -1;
+    int scanned = fscanf(file, "%lf", &uptime);
+    fclose(file);
+    clock_gettime(CLOCK_REALTIME, &now);
+    if (scanned != 1) {
+        errno = ESRCH;
+        return -1;
+    }
+
+    double started = now.tv_sec + now.tv_nsec / 1e9 - uptime + (double)startTicks / sysconf(_SC_CLK_TCK);
+    struct kinfo_proc *info = oldValue;
+    memset(info, 0, sizeof(*info));
+    info->kp_proc.p_starttime.tv_sec = (time_t)started;
+    info->kp_proc.p_starttime.tv_usec = (suseconds_t)((started - (time_t)started) * 1e6);
+    *oldLength = sizeof(*info);
+    return 0;
+}
+
+DNSServiceErrorType DNSServiceBrowse(DNSServiceRef *sdRef, DNSServiceFlags flags, uint32_t interfaceIndex, const char *regtype, const char *domain, DNSServiceBrowseReply callBack, void *context) {
+    return kDNSServiceErr_ServiceNotRunning;
+}
+
+DNSServiceErrorType DNSServiceResolve(DNSServiceRef *sdRef, DNSServiceFlags flags, uint32_t interfaceIndex, const char *name, const char *regtype, const char *domain, DNSServiceResolveReply callBack, void *context) {
+    return kDNSServiceErr_ServiceNotRunning;
+}
+
+DNSServiceErrorType DNSServiceProcessResult(DNSServiceRef sdRef) {
+    return kDNSServiceErr_ServiceNotRunning;
+}
+
+void DNSServiceRefDeallocate(DNSServiceRef sdRef) {
+}
@@ -0,0 +1,30 @@
+/*
+ *  AudioServices.h
+ *  AudioSwitcher
+ *
+ *  The device properties AudioToolbox adds on top of the HAL, with the
+ *  selector values of the macOS SDK, and the AudioHardwareService calls
+ *  they are read and set through.  See shim/audio_toolbox.c.
+ *
+ *  MIT License, see license.txt
+ */
+
+#ifndef SHIM_AUDIO_SERVICES_H
+#define SHIM_AUDIO_SERVICES_H
+
+#include <CoreAudio/CoreAudio.h>
+
+enum {
+	kAudioHardwareServiceDeviceProperty_VirtualMainVolume   = 'vmvc',
+	kAudioHardwareServiceDeviceProperty_VirtualMasterVolume = kAudioHardwareServiceDeviceProperty_VirtualMainVolume,
+	kAudioHardwareServiceDeviceProperty_VirtualMainBalance  = 'vmbl',
+	kAudioHardwareServiceDeviceProperty_VirtualMasterBalance = kAudioHardwareServiceDeviceProperty_VirtualMainBalance,
+};
+
+Boolean AudioHardwareServiceHasProperty(AudioObjectID objectID, const AudioObjectPropertyAddress *address);
+OSStatus AudioHardwareServiceIsPropertySettable(AudioObjectID objectID, const AudioObjectPropertyAddress *address, Boolean *outIsSettable);
+OSStatus AudioHardwareServiceGetPropertyDataSize(AudioObjectID objectID, const AudioObjectPropertyAddress *address, UInt32 qualifierSize, const void *qualifier, UInt32 *outDataSize);
+OSStatus AudioHardwareServiceGetPropertyData(AudioObjectID objectID, const AudioObjectPropertyAddress *address, UInt32 qualifierSize, const void *qualifier, UInt32 *ioDataSize, void *outData);
+OSStatus AudioHardwareServiceSetPropertyData(AudioObjectID objectID, const AudioObjectPropertyAddress *address, UInt32 qualifierSize, const void *qualifier, UInt32 dataSize, const void *data);
+
+#endif
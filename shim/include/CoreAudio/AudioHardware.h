@@ -0,0 +1,91 @@
+/*
+ *  AudioHardware.h
+ *  AudioSwitcher
+ *
+ *  The HAL's client API: property access and listeners on audio objects,
+ *  IO procs, and aggregate devices, with the selector values of the macOS
+ *  SDK.
+ *
+ *  MIT License, see license.txt
+ */
+
+#ifndef SHIM_AUDIO_HARDWARE_H
+#define SHIM_AUDIO_HARDWARE_H
+
+#include <CoreAudio/AudioHardwareBase.h>
+
+enum {
+	kAudioObjectSystemObject = 1,
+};
+
+enum {
+	kAudioHardwarePropertyDevices                   = 'dev#',
+	kAudioHardwarePropertyDefaultInputDevice        = 'dIn ',
+	kAudioHardwarePropertyDefaultOutputDevice       = 'dOut',
+	kAudioHardwarePropertyDefaultSystemOutputDevice = 'sOut',
+	kAudioHardwarePropertyTranslateUIDToDevice      = 'uidd',
+	kAudioHardwarePropertyPlugInForBundleID         = 'pibi',
+};
+
+enum {
+	kAudioDevicePropertyScopeInput  = kAudioObjectPropertyScopeInput,
+	kAudioDevicePropertyScopeOutput = kAudioObjectPropertyScopeOutput,
+};
+
+enum {
+	kAudioDevicePropertyDeviceNameCFString        = kAudioObjectPropertyName,
+	kAudioDevicePropertyProcessorOverload         = 'over',
+	kAudioDeviceProcessorOverload                 = 'over',
+	kAudioDevicePropertyIOCycleUsage              = 'ncyc',
+	kAudioDevicePropertyHogMode                   = 'oink',
+	kAudioDevicePropertyBufferFrameSize           = 'fsiz',
+	kAudioDevicePropertyBufferFrameSizeRange      = 'fsz#',
+	kAudioDevicePropertyStreamConfiguration       = 'slay',
+	kAudioDevicePropertyStreamFormat              = 'sfmt',
+	kAudioDevicePropertyMute                      = 'mute',
+	kAudioDevicePropertyVolumeScalar              = 'volm',
+	kAudioDevicePropertyDataSource                = 'ssrc',
+	kAudioDevicePropertyDataSources               = 'ssc#',
+	kAudioDevicePropertyDataSourceNameForIDCFString = 'lscn',
+};
+
+enum {
+	kAudioAggregateDevicePropertyFullSubDeviceList   = 'grup',
+	kAudioAggregateDevicePropertyActiveSubDeviceList = 'agrp',
+	kAudioAggregateDevicePropertyComposition         = 'acom',
+	kAudioAggregateDevicePropertyMainSubDevice       = 'amst',
+	kAudioAggregateDevicePropertyMasterSubDevice     = kAudioAggregateDevicePropertyMainSubDevice,
+	kAudioSubDevicePropertyDriftCompensation         = 'drft',
+};
+
+#define kAudioAggregateDeviceUIDKey "uid"
+#define kAudioAggregateDeviceNameKey "name"
+#define kAudioAggregateDeviceSubDeviceListKey "subdevices"
+#define kAudioAggregateDeviceMainSubDeviceKey "master"
+#define kAudioAggregateDeviceMasterSubDeviceKey kAudioAggregateDeviceMainSubDeviceKey
+#define kAudioAggregateDeviceIsPrivateKey "private"
+#define kAudioAggregateDeviceIsStackedKey "stacked"
+#define kAudioSubDeviceUIDKey "uid"
+#define kAudioSubDeviceDriftCompensationKey "drift"
+
+typedef OSStatus (*AudioObjectPropertyListenerProc)(AudioObjectID objectID, UInt32 numberAddresses, const AudioObjectPropertyAddress *addresses, void *clientData);
+typedef OSStatus (*AudioDeviceIOProc)(AudioObjectID device, const AudioTimeStamp *now, const AudioBufferList *inputData, const AudioTimeStamp *inputTime, AudioBufferList *outputData, const AudioTimeStamp *outputTime, void *clientData);
+typedef AudioDeviceIOProc AudioDeviceIOProcID;
+
+OSStatus AudioObjectGetPropertyDataSize(AudioObjectID objectID, const AudioObjectPropertyAddress *address, UInt32 qualifierSize, const void *qualifier, UInt32 *outDataSize);
+OSStatus AudioObjectGetPropertyData(AudioObjectID objectID, const AudioObjectPropertyAddress *address, UInt32 qualifierSize, const void *qualifier, UInt32 *ioDataSize, void *outData);
+OSStatus AudioObjectSetPropertyData(AudioObjectID objectID, const AudioObjectPropertyAddress *address, UInt32 qualifierSize, const void *qualifier, UInt32 dataSize, const void *data);
+Boolean AudioObjectHasProperty(AudioObjectID objectID, const AudioObjectPropertyAddress *address);
+OSStatus AudioObjectIsPropertySettable(AudioObjectID objectID, const AudioObjectPropertyAddress *address, Boolean *outIsSettable);
+OSStatus AudioObjectAddPropertyListener(AudioObjectID objectID, const AudioObjectPropertyAddress *address, AudioObjectPropertyListenerProc listener, void *clientData);
+OSStatus AudioObjectRemovePropertyListener(AudioObjectID objectID, const AudioObjectPropertyAddress *address, AudioObjectPropertyListenerProc listener, void *clientData);
+
+OSStatus AudioDeviceCreateIOProcID(AudioObjectID device, AudioDeviceIOProc proc, void *clientData, AudioDeviceIOProcID *outIOProcID);
+OSStatus AudioDeviceDestroyIOProcID(AudioObjectID device, AudioDeviceIOProcID ioProcID);
+OSStatus AudioDeviceStart(AudioObjectID device, AudioDeviceIOProcID ioProcID);
+OSStatus AudioDeviceStop(AudioObjectID device, AudioDeviceIOProcID ioProcID);
+
+OSStatus AudioHardwareCreateAggregateDevice(CFDictionaryRef description, AudioObjectID *outDeviceID);
+OSStatus AudioHardwareDestroyAggregateDevice(AudioObjectID deviceID);
+
+#endif
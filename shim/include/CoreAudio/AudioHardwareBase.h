@@ -0,0 +1,112 @@
+/*
+ *  AudioHardwareBase.h
+ *  AudioSwitcher
+ *
+ *  Audio objects, property addresses, the selectors shared by the HAL and
+ *  its drivers, and the HAL's error codes, with the values of the macOS
+ *  SDK.
+ *
+ *  MIT License, see license.txt
+ */
+
+#ifndef SHIM_AUDIO_HARDWARE_BASE_H
+#define SHIM_AUDIO_HARDWARE_BASE_H
+
+#include <CoreAudio/CoreAudioTypes.h>
+
+typedef UInt32 AudioObjectID;
+typedef UInt32 AudioClassID;
+typedef UInt32 AudioObjectPropertySelector;
+typedef UInt32 AudioObjectPropertyScope;
+typedef UInt32 AudioObjectPropertyElement;
+typedef AudioObjectID AudioDeviceID;
+typedef AudioObjectID AudioStreamID;
+
+typedef struct {
+	AudioObjectPropertySelector mSelector;
+	AudioObjectPropertyScope mScope;
+	AudioObjectPropertyElement mElement;
+} AudioObjectPropertyAddress;
+
+enum {
+	kAudioHardwareNoError                   = 0,
+	kAudioHardwareNotRunningError           = 'stop',
+	kAudioHardwareUnspecifiedError          = 'what',
+	kAudioHardwareUnknownPropertyError      = 'who?',
+	kAudioHardwareBadPropertySizeError      = '!siz',
+	kAudioHardwareIllegalOperationError     = 'nope',
+	kAudioHardwareBadObjectError            = '!obj',
+	kAudioHardwareBadDeviceError            = '!dev',
+	kAudioHardwareBadStreamError            = '!str',
+	kAudioHardwareUnsupportedOperationError = 'unop',
+	kAudioDeviceUnsupportedFormatError      = '!dat',
+	kAudioDevicePermissionsError            = '!hog',
+};
+
+enum {
+	kAudioObjectUnknown = 0,
+};
+#define kAudioDeviceUnknown kAudioObjectUnknown
+
+enum {
+	kAudioObjectPropertyScopeGlobal      = 'glob',
+	kAudioObjectPropertyScopeInput       = 'inpt',
+	kAudioObjectPropertyScopeOutput      = 'outp',
+	kAudioObjectPropertyScopePlayThrough = 'ptru',
+	kAudioObjectPropertyScopeWildcard    = '****',
+	kAudioObjectPropertyElementMain      = 0,
+	kAudioObjectPropertyElementMaster    = kAudioObjectPropertyElementMain,
+	kAudioObjectPropertyElementWildcard  = 0xFFFFFFFF,
+};
+
+enum {
+	kAudioObjectPropertyClass       = 'clas',
+	kAudioObjectPropertyOwner       = 'stdv',
+	kAudioObjectPropertyName        = 'lnam',
+	kAudioObjectPropertyOwnedObjects = 'ownd',
+};
+
+enum {
+	kAudioDevicePropertyDeviceUID                    = 'uid ',
+	kAudioDevicePropertyTransportType                = 'tran',
+	kAudioDevicePropertyDeviceIsAlive                = 'livn',
+	kAudioDevicePropertyDeviceIsRunning              = 'goin',
+	kAudioDevicePropertyDeviceIsRunningSomewhere     = 'gone',
+	kAudioDevicePropertyIsHidden                     = 'hidn',
+	kAudioDevicePropertyLatency                      = 'ltnc',
+	kAudioDevicePropertySafetyOffset                 = 'saft',
+	kAudioDevicePropertyStreams                      = 'stm#',
+	kAudioDevicePropertyNominalSampleRate            = 'nsrt',
+	kAudioDevicePropertyAvailableNominalSampleRates  = 'nsr#',
+	kAudioDevicePropertyPreferredChannelsForStereo   = 'dch2',
+};
+
+enum {
+	kAudioStreamPropertyVirtualFormat  = 'sfmt',
+	kAudioStreamPropertyPhysicalFormat = 'pft ',
+	kAudioStreamPropertyLatency        = 'ltnc',
+};
+
+enum {
+	kAudioDeviceTransportTypeUnknown     = 0,
+	kAudioDeviceTransportTypeBuiltIn     = 'bltn',
+	kAudioDeviceTransportTypeAggregate   = 'grup',
+	kAudioDeviceTransportTypeVirtual     = 'virt',
+	kAudioDeviceTransportTypePCI         = 'pci ',
+	kAudioDeviceTransportTypeUSB         = 'usb ',
+	kAudioDeviceTransportTypeFireWire    = '1394',
+	kAudioDeviceTransportTypeBluetooth   = 'blue',
+	kAudioDeviceTransportTypeBluetoothLE = 'blea',
+	kAudioDeviceTransportTypeHDMI        = 'hdmi',
+	kAudioDeviceTransportTypeDisplayPort = 'dprt',
+	kAudioDeviceTransportTypeAirPlay     = 'airp',
+	kAudioDeviceTransportTypeAVB         = 'eavb',
+	kAudioDeviceTransportTypeThunderbolt = 'thun',
+};
+
+enum {
+	kAudioAggregateDeviceClassID = 'aagg',
+	kAudioSubDeviceClassID       = 'asub',
+};
+
+#endif
@@ -0,0 +1,21 @@
+/*
+ *  CoreAudio.h
+ *  AudioSwitcher
+ *
+ *  The part of CoreAudio SwitchAudioSource uses, for building it without
+ *  the macOS SDK.  See shim/core_audio.c for what stands in for the HAL.
+ *
+ *  MIT License, see license.txt
+ */
+
+#ifndef SHIM_CORE_AUDIO_H
+#define SHIM_CORE_AUDIO_H
+
+// the constants below have the spellings and values of the macOS 12 SDK
+#define __MAC_12_0 120000
+
+#include <CoreAudio/CoreAudioTypes.h>
+#include <CoreAudio/AudioHardwareBase.h>
+#include <CoreAudio/AudioHardware.h>
+
+#endif
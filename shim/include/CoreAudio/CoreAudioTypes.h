@@ -0,0 +1,87 @@
+/*
+ *  CoreAudioTypes.h
+ *  AudioSwitcher
+ *
+ *  Buffers, time stamps and stream formats, laid out as in the macOS SDK.
+ *
+ *  MIT License, see license.txt
+ */
+
+#ifndef SHIM_CORE_AUDIO_TYPES_H
+#define SHIM_CORE_AUDIO_TYPES_H
+
+#include <CoreFoundation/CoreFoundation.h>
+
+typedef struct {
+	Float64 mMinimum;
+	Float64 mMaximum;
+} AudioValueRange;
+
+typedef struct {
+	void *mInputData;
+	UInt32 mInputDataSize;
+	void *mOutputData;
+	UInt32 mOutputDataSize;
+} AudioValueTranslation;
+
+typedef struct {
+	UInt32 mNumberChannels;
+	UInt32 mDataByteSize;
+	void *mData;
+} AudioBuffer;
+
+typedef struct {
+	UInt32 mNumberBuffers;
+	AudioBuffer mBuffers[1];	// variable length
+} AudioBufferList;
+
+typedef struct {
+	SInt16 mSubframes;
+	SInt16 mSubframeDivisor;
+	UInt32 mCounter;
+	UInt32 mType;
+	UInt32 mFlags;
+	SInt16 mHours;
+	SInt16 mMinutes;
+	SInt16 mSeconds;
+	SInt16 mFrames;
+} SMPTETime;
+
+typedef struct {
+	Float64 mSampleTime;
+	UInt64 mHostTime;
+	Float64 mRateScalar;
+	UInt64 mWordClockTime;
+	SMPTETime mSMPTETime;
+	UInt32 mFlags;
+	UInt32 mReserved;
+} AudioTimeStamp;
+
+typedef UInt32 AudioFormatID;
+typedef UInt32 AudioFormatFlags;
+
+typedef struct {
+	Float64 mSampleRate;
+	AudioFormatID mFormatID;
+	AudioFormatFlags mFormatFlags;
+	UInt32 mBytesPerPacket;
+	UInt32 mFramesPerPacket;
+	UInt32 mBytesPerFrame;
+	UInt32 mChannelsPerFrame;
+	UInt32 mBitsPerChannel;
+	UInt32 mReserved;
+} AudioStreamBasicDescription;
+
+enum {
+	kAudioFormatLinearPCM = 'lpcm',
+};
+
+enum {
+	kAudioFormatFlagIsFloat          = (1U << 0),
+	kAudioFormatFlagIsBigEndian      = (1U << 1),
+	kAudioFormatFlagIsSignedInteger  = (1U << 2),
+	kAudioFormatFlagIsPacked         = (1U << 3),
+	kAudioFormatFlagIsNonInterleaved = (1U << 5),
+};
+
+#endif
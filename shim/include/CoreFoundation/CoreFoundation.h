@@ -0,0 +1,156 @@
+/*
+ *  CoreFoundation.h
+ *  AudioSwitcher
+ *
+ *  The part of CoreFoundation SwitchAudioSource uses, for building it
+ *  without the macOS SDK: the MacTypes scalars and property list objects
+ *  (strings, numbers, booleans, arrays and dictionaries).  Values and
+ *  layouts are those of the SDK, so traces recorded on a Mac replay here.
+ *
+ *  MIT License, see license.txt
+ */
+
+#ifndef SHIM_CORE_FOUNDATION_H
+#define SHIM_CORE_FOUNDATION_H
+
+// as with the SDK, the C library comes along
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef uint8_t UInt8;
+typedef int8_t SInt8;
+typedef uint16_t UInt16;
+typedef int16_t SInt16;
+typedef uint32_t UInt32;
+typedef int32_t SInt32;
+typedef uint64_t UInt64;
+typedef int64_t SInt64;
+typedef float Float32;
+typedef double Float64;
+typedef unsigned char Boolean;
+typedef SInt32 OSStatus;
+typedef UInt32 FourCharCode;
+
+#define noErr 0
+
+#ifndef nil
+#define nil NULL
+#endif
+
+typedef const void *CFTypeRef;
+typedef unsigned long CFTypeID;
+typedef long CFIndex;
+typedef double CFTimeInterval;
+typedef const struct __CFAllocator *CFAllocatorRef;
+typedef const struct __CFString *CFStringRef;
+typedef const struct __CFNumber *CFNumberRef;
+typedef const struct __CFBoolean *CFBooleanRef;
+typedef const struct __CFArray *CFArrayRef;
+typedef struct __CFArray *CFMutableArrayRef;
+typedef const struct __CFDictionary *CFDictionaryRef;
+typedef struct __CFDictionary *CFMutableDictionaryRef;
+
+typedef struct {
+	CFIndex location;
+	CFIndex length;
+} CFRange;
+
+enum {
+	kCFNotFound = -1,
+};
+
+typedef UInt32 CFStringEncoding;
+enum {
+	kCFStringEncodingUTF8 = 0x08000100,
+};
+
+typedef unsigned long CFStringCompareFlags;
+
+typedef CFIndex CFNumberType;
+enum {
+	kCFNumberSInt8Type     = 1,
+	kCFNumberSInt16Type    = 2,
+	kCFNumberSInt32Type    = 3,
+	kCFNumberSInt64Type    = 4,
+	kCFNumberFloat32Type   = 5,
+	kCFNumberFloat64Type   = 6,
+	kCFNumberCharType      = 7,
+	kCFNumberShortType     = 8,
+	kCFNumberIntType       = 9,
+	kCFNumberLongType      = 10,
+	kCFNumberLongLongType  = 11,
+	kCFNumberFloatType     = 12,
+	kCFNumberDoubleType    = 13,
+	kCFNumberCFIndexType   = 14,
+};
+
+// objects are always retained and compared by value, whichever callbacks
+// are given
+typedef struct {
+	CFIndex version;
+} CFArrayCallBacks, CFDictionaryKeyCallBacks, CFDictionaryValueCallBacks;
+
+extern const CFAllocatorRef kCFAllocatorDefault;
+extern const CFArrayCallBacks kCFTypeArrayCallBacks;
+extern const CFDictionaryKeyCallBacks kCFTypeDictionaryKeyCallBacks;
+extern const CFDictionaryValueCallBacks kCFTypeDictionaryValueCallBacks;
+extern const CFBooleanRef kCFBooleanTrue;
+extern const CFBooleanRef kCFBooleanFalse;
+extern const CFStringRef kCFRunLoopDefaultMode;
+
+enum {
+	kCFRunLoopRunFinished      = 1,
+	kCFRunLoopRunStopped       = 2,
+	kCFRunLoopRunTimedOut      = 3,
+	kCFRunLoopRunHandledSource = 4,
+};
+
+CFTypeRef CFRetain(CFTypeRef object);
+void CFRelease(CFTypeRef object);
+CFTypeID CFGetTypeID(CFTypeRef object);
+Boolean CFEqual(CFTypeRef a, CFTypeRef b);
+
+CFTypeID CFStringGetTypeID(void);
+CFStringRef CFStringCreateWithCString(CFAllocatorRef allocator, const char *text, CFStringEncoding encoding);
+CFStringRef CFStringCreateWithBytes(CFAllocatorRef allocator, const UInt8 *bytes, CFIndex length, CFStringEncoding encoding, Boolean isExternalRepresentation);
+CFIndex CFStringGetLength(CFStringRef string);
+CFIndex CFStringGetMaximumSizeForEncoding(CFIndex length, CFStringEncoding encoding);
+Boolean CFStringGetCString(CFStringRef string, char *buffer, CFIndex bufferSize, CFStringEncoding encoding);
+CFRange CFStringFind(CFStringRef string, CFStringRef find, CFStringCompareFlags options);
+CFStringRef __CFStringMakeConstantString(const char *text);
+#define CFSTR(text) __CFStringMakeConstantString("" text "")
+
+CFTypeID CFNumberGetTypeID(void);
+CFNumberRef CFNumberCreate(CFAllocatorRef allocator, CFNumberType type, const void *value);
+Boolean CFNumberGetValue(CFNumberRef number, CFNumberType type, void *value);
+Boolean CFNumberIsFloatType(CFNumberRef number);
+
+CFTypeID CFBooleanGetTypeID(void);
+Boolean CFBooleanGetValue(CFBooleanRef boolean);
+
+CFTypeID CFArrayGetTypeID(void);
+CFMutableArrayRef CFArrayCreateMutable(CFAllocatorRef allocator, CFIndex capacity, const CFArrayCallBacks *callBacks);
+CFIndex CFArrayGetCount(CFArrayRef array);
+const void *CFArrayGetValueAtIndex(CFArrayRef array, CFIndex index);
+void CFArrayAppendValue(CFMutableArrayRef array, const void *value);
+
+CFTypeID CFDictionaryGetTypeID(void);
+CFMutableDictionaryRef CFDictionaryCreateMutable(CFAllocatorRef allocator, CFIndex capacity, const CFDictionaryKeyCallBacks *keyCallBacks, const CFDictionaryValueCallBacks *valueCallBacks);
+CFIndex CFDictionaryGetCount(CFDictionaryRef dictionary);
+const void *CFDictionaryGetValue(CFDictionaryRef dictionary, const void *key);
+void CFDictionaryGetKeysAndValues(CFDictionaryRef dictionary, const void **keys, const void **values);
+void CFDictionarySetValue(CFMutableDictionaryRef dictionary, const void *key, const void *value);
+
+// there are no run loop sources; running one only waits
+SInt32 CFRunLoopRunInMode(CFStringRef mode, CFTimeInterval seconds, Boolean returnAfterSourceHandled);
+
+#endif
@@ -0,0 +1,39 @@
+/*
+ *  dns_sd.h
+ *  AudioSwitcher
+ *
+ *  The DNS-SD calls used to find AirPlay receivers.  There is no mDNS
+ *  responder to ask, so browsing always fails.
+ *
+ *  MIT License, see license.txt
+ */
+
+#ifndef SHIM_DNS_SD_H
+#define SHIM_DNS_SD_H
+
+#include <stdint.h>
+
+#define DNSSD_API
+
+typedef struct _DNSServiceRef_t *DNSServiceRef;
+typedef uint32_t DNSServiceFlags;
+typedef int32_t DNSServiceErrorType;
+
+enum {
+	kDNSServiceErr_NoError = 0,
+	kDNSServiceErr_ServiceNotRunning = -65563,
+};
+
+enum {
+	kDNSServiceInterfaceIndexAny = 0,
+};
+
+typedef void (DNSSD_API *DNSServiceBrowseReply)(DNSServiceRef sdRef, DNSServiceFlags flags, uint32_t interfaceIndex, DNSServiceErrorType errorCode, const char *serviceName, const char *regtype, const char *replyDomain, void *context);
+typedef void (DNSSD_API *DNSServiceResolveReply)(DNSServiceRef sdRef, DNSServiceFlags flags, uint32_t interfaceIndex, DNSServiceErrorType errorCode, const char *fullname, const char *hosttarget, uint16_t port, uint16_t txtLen, const unsigned char *txtRecord, void *context);
+
+DNSServiceErrorType DNSServiceBrowse(DNSServiceRef *sdRef, DNSServiceFlags flags, uint32_t interfaceIndex, const char *regtype, const char *domain, DNSServiceBrowseReply callBack, void *context);
+DNSServiceErrorType DNSServiceResolve(DNSServiceRef *sdRef, DNSServiceFlags flags, uint32_t interfaceIndex, const char *name, const char *regtype, const char *domain, DNSServiceResolveReply callBack, void *context);
+DNSServiceErrorType DNSServiceProcessResult(DNSServiceRef sdRef);
+void DNSServiceRefDeallocate(DNSServiceRef sdRef);
+
+#endif
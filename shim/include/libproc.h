@@ -0,0 +1,18 @@
+/*
+ *  libproc.h
+ *  AudioSwitcher
+ *
+ *  Process names, read from /proc.
+ *
+ *  MIT License, see license.txt
+ */
+
+#ifndef SHIM_LIBPROC_H
+#define SHIM_LIBPROC_H
+
+#include <stdint.h>
+
+int proc_name(int pid, void *buffer, uint32_t bufferSize);
+const char *getprogname(void);
+
+#endif
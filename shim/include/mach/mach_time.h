@@ -0,0 +1,24 @@
+/*
+ *  mach_time.h
+ *  AudioSwitcher
+ *
+ *  Host time on top of the monotonic clock: one tick is one nanosecond.
+ *
+ *  MIT License, see license.txt
+ */
+
+#ifndef SHIM_MACH_TIME_H
+#define SHIM_MACH_TIME_H
+
+#include <stdint.h>
+
+typedef struct {
+	uint32_t numer;
+	uint32_t denom;
+} mach_timebase_info_data_t;
+
+uint64_t mach_absolute_time(void);
+int mach_timebase_info(mach_timebase_info_data_t *info);
+int mach_wait_until(uint64_t deadline);
+
+#endif
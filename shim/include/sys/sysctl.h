@@ -0,0 +1,30 @@
+/*
+ *  sysctl.h
+ *  AudioSwitcher
+ *
+ *  The one BSD sysctl used: the start time of a process, read from /proc.
+ *
+ *  MIT License, see license.txt
+ */
+
+#ifndef SHIM_SYS_SYSCTL_H
+#define SHIM_SYS_SYSCTL_H
+
+#include <stddef.h>
+#include <sys/time.h>
+
+#define CTL_KERN 1
+#define KERN_PROC 14
+#define KERN_PROC_PID 1
+
+struct extern_proc {
+	struct timeval p_starttime;
+};
+
+struct kinfo_proc {
+	struct extern_proc kp_proc;
+};
+
+int sysctl(int *name, unsigned int nameLength, void *oldValue, size_t *oldLength, void *newValue, size_t newLength);
+
+#endif
@@ -0,0 +1,88 @@
+/*
+ *  startup_profile.c
+ *  AudioSwitcher
+ *
+ *  MIT License, see license.txt
+ */
+
+#include "startup_profile.h"
+#include <mach/mach_time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/sysctl.h>
+#include <sys/time.h>
+
+static UInt64 mainHostTime = 0;
+static struct timeval mainWallTime;
+static ASOutputType profileFormat = kFormatHuman;
+static bool profiling = false;
+
+// Called first thing in main; costs two clock reads whether or not the
+// profile is asked for.
+void noteMainEntry(void) {
+    mainHostTime = mach_absolute_time();
+    gettimeofday(&mainWallTime, NULL);
+}
+
+// The kernel only keeps the start time with microsecond precision, on the
+// wall clock, so time to main is measured on the wall clock too.
+static double timeToMainMs(void) {
+    int mib[4] = {CTL_KERN, KERN_PROC, KERN_PROC_PID, getpid()};
+    struct kinfo_proc info;
+    size_t size = sizeof(info);
+
+    if (sysctl(mib, 4, &info, &size, NULL, 0) != 0 || size == 0) {
+        return 0.0;
+    }
+    struct timeval start = info.kp_proc.p_starttime;
+    return (mainWallTime.tv_sec - start.tv_sec) * 1000.0 + (mainWallTime.tv_usec - start.tv_usec) / 1000.0;
+}
+
+static void showStartupProfile(void) {
+    mach_timebase_info_data_t timebase;
+    UInt64 firstHALCallTime = getFirstHALCallTime();
+    double toMainMs = timeToMainMs();
+    double toFirstCallMs = -1.0;
+
+    mach_timebase_info(&timebase);
+    double sinceMainMs = (mach_absolute_time() - mainHostTime) * timebase.numer / timebase.denom / 1000000.0;
+    if (firstHALCallTime != 0) {
+        toFirstCallMs = (firstHALCallTime - mainHostTime) * timebase.numer / timebase.denom / 1000000.0;
+    }
+
+    switch (profileFormat) {
+        case kFormatCLI:
+            fprintf(stderr, "%.3f,%.3f,%.3f,%u\n", toMainMs, toFirstCallMs, toMainMs + sinceMainMs, getHALCallCount());
+            break;
+        case kFormatJSON:
+            fprintf(stderr, "{\"time_to_main_ms\": %.3f, \"time_to_first_hal_ms\": ", toMainMs);
+            if (toFirstCallMs < 0.0) {
+                fprintf(stderr, "null");
+            } else {
+                fprintf(stderr, "%.3f", toFirstCallMs);
+            }
+            fprintf(stderr, ", \"total_ms\": %.3f, \"hal_calls\": %u}\n", toMainMs + sinceMainMs, getHALCallCount());
+            break;
+        default:
+            fprintf(stderr, "startup: %.3f ms to main, ", toMainMs);
+            if (toFirstCallMs < 0.0) {
+                fprintf(stderr, "no audio system calls, ");
+            } else {
+                fprintf(stderr, "%.3f ms more to the first of %u audio system calls, ", toFirstCallMs, getHALCallCount());
+            }
+            fprintf(stderr, "%.3f ms in total\n", toMainMs + sinceMainMs);
+            break;
+    }
+}
+
+void startStartupProfile(void) {
+    if (!profiling) {
+        profiling = true;
+        atexit(showStartupProfile);
+    }
+}
+
+void setStartupProfileFormat(ASOutputType outputRequested) {
+    // the records of the binary formats are for stdout only
+    profileFormat = (outputRequested == kFormatBinary || outputRequested == kFormatMsgPack) ? kFormatJSON : outputRequested;
+}
@@ -0,0 +1,21 @@
+/*
+ *  startup_profile.h
+ *  AudioSwitcher
+ *
+ *  --startup-profile: where the time of a short invocation goes, from the
+ *  kernel starting the process to main, from main to the first call into
+ *  the audio system, and in total until exit.
+ *
+ *  MIT License, see license.txt
+ */
+
+#ifndef STARTUP_PROFILE_H
+#define STARTUP_PROFILE_H
+
+#include "audio_switch.h"
+
+void noteMainEntry(void);
+void startStartupProfile(void);
+void setStartupProfileFormat(ASOutputType outputRequested);
+
+#endif
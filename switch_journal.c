@@ -0,0 +1,206 @@
+/*
+ *  switch_journal.c
+ *  AudioSwitcher
+ *
+ *  MIT License, see license.txt
+ */
+
+#include "switch_journal.h"
+#include <fcntl.h>
+#include <libproc.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+
+static ASJournal *journal = NULL;
+static pthread_once_t journalOnce = PTHREAD_ONCE_INIT;
+static ASJournalOperation currentOperation = kJournalSwitch;
+static char parentName[36] = "";
+
+static const char *operationName(UInt8 operation) {
+    switch (operation) {
+        case kJournalSwitch: return "switch";
+        case kJournalCycle: return "cycle";
+        case kJournalMute: return "mute";
+        default: return "unknown";
+    }
+}
+
+static UInt64 wallClockNanos(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return (UInt64)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+// Maps the journal, creating it if asked to.  A new file reads as zeros,
+// and every process writes the same header into it, so creating it needs
+// no lock.
+static ASJournal *mapJournal(bool create) {
+    char path[1024];
+    const char *directory = getenv("TMPDIR");
+    struct stat status;
+
+    snprintf(path, sizeof(path), "%s/SwitchAudioSource.journal.%u", directory ? directory : "/tmp", (unsigned int)getuid());
+    int fd = open(path, create ? O_RDWR | O_CREAT : O_RDONLY, 0600);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (fstat(fd, &status) != 0 || (status.st_size < (off_t)sizeof(ASJournal) && (!create || ftruncate(fd, sizeof(ASJournal)) != 0))) {
+        close(fd);
+        return NULL;
+    }
+    ASJournal *mapped = mmap(NULL, sizeof(ASJournal), create ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        return NULL;
+    }
+
+    if (create && mapped->magic != JOURNAL_MAGIC) {
+        mapped->version = JOURNAL_VERSION;
+        __atomic_store_n(&mapped->magic, JOURNAL_MAGIC, __ATOMIC_RELEASE);
+    }
+    if (__atomic_load_n(&mapped->magic, __ATOMIC_ACQUIRE) != JOURNAL_MAGIC || mapped->version != JOURNAL_VERSION) {
+        munmap(mapped, sizeof(ASJournal));
+        return NULL;
+    }
+    return mapped;
+}
+
+// Mute fan-out records from several threads, so the journal is opened once
+// for all of them.  Without a usable journal nothing is recorded and
+// switching goes on.
+static void openJournal(void) {
+    journal = mapJournal(true);
+    if (proc_name(getppid(), parentName, sizeof(parentName)) <= 0) {
+        strcpy(parentName, "unknown");
+    }
+}
+
+static void copyUID(AudioDeviceID deviceID, char *uid, size_t uidSize) {
+    const char *deviceUID = deviceID != kAudioDeviceUnknown ? getDeviceUID(deviceID) : "";
+    strncpy(uid, deviceUID, uidSize - 1);
+    if (deviceUID[0] != '\0') free((void *)deviceUID);
+}
+
+static void appendRecord(UInt8 operation, ASDeviceType deviceType, AudioDeviceID oldDeviceID, AudioDeviceID newDeviceID, OSStatus status, UInt32 muted, UInt64 latencyNanos) {
+    pthread_once(&journalOnce, openJournal);
+    ASJournal *target = journal;
+    if (target == NULL) {
+        return;
+    }
+
+    // everything that asks the HAL is done before the slot is reserved, so
+    // the slot is only ever busy for the copy
+    ASJournalRecord record;
+    memset(&record, 0, sizeof(record));
+    record.timestampNanos = wallClockNanos();
+    record.latencyNanos = latencyNanos;
+    record.pid = getpid();
+    record.status = status;
+    record.operation = operation;
+    record.deviceType = (UInt8)deviceType;
+    record.muted = (UInt8)muted;
+    memcpy(record.parentName, parentName, sizeof(record.parentName));
+    copyUID(oldDeviceID, record.oldUID, sizeof(record.oldUID));
+    copyUID(newDeviceID, record.newUID, sizeof(record.newUID));
+
+    UInt64 position = __atomic_fetch_add(&target->head, 1, __ATOMIC_RELAXED);
+    ASJournalRecord *slot = &target->records[position % JOURNAL_SLOTS];
+
+    __atomic_store_n(&slot->sequence, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy((UInt8 *)slot + sizeof(slot->sequence), (UInt8 *)&record + sizeof(record.sequence), sizeof(record) - sizeof(record.sequence));
+    __atomic_store_n(&slot->sequence, position + 1, __ATOMIC_RELEASE);
+}
+
+// Switches made from here on are recorded as the given operation.
+void setJournalOperation(ASJournalOperation operation) {
+    currentOperation = operation;
+}
+
+void journalSwitch(ASDeviceType deviceType, AudioDeviceID oldDeviceID, AudioDeviceID newDeviceID, OSStatus status, UInt64 latencyNanos) {
+    appendRecord(currentOperation, deviceType, oldDeviceID, newDeviceID, status, 0, latencyNanos);
+}
+
+void journalMute(ASDeviceType deviceType, AudioDeviceID deviceID, OSStatus status, UInt32 muted, UInt64 latencyNanos) {
+    appendRecord(kJournalMute, deviceType, deviceID, deviceID, status, muted, latencyNanos);
+}
+
+static bool matchesHistory(const ASJournalRecord *record, ASDeviceType typeRequested, const char *match, UInt64 sinceNanos) {
+    if (record->timestampNanos < sinceNanos) return false;
+    if (typeRequested != kAudioTypeUnknown && typeRequested != kAudioTypeAll && record->deviceType != typeRequested) return false;
+    if (match == NULL || match[0] == '\0') return true;
+    return strstr(record->parentName, match) || strstr(record->oldUID, match) || strstr(record->newUID, match) || strstr(operationName(record->operation), match);
+}
+
+static void showHistoryRecord(const ASJournalRecord *record, ASOutputType outputRequested) {
+    char timeText[32];
+    char change[300];
+    struct tm local;
+    time_t seconds = (time_t)(record->timestampNanos / 1000000000ULL);
+    UInt32 millis = (UInt32)(record->timestampNanos % 1000000000ULL / 1000000ULL);
+    const char *result = record->status == noErr ? "ok" : (record->status == kASPropertyChangeTimeoutError ? "timeout" : describeStatus(record->status));
+    double latencyMs = record->latencyNanos / 1000000.0;
+
+    localtime_r(&seconds, &local);
+    strftime(timeText, sizeof(timeText), "%Y-%m-%dT%H:%M:%S", &local);
+
+    switch (outputRequested) {
+        case kFormatCLI:
+            printf("%s.%03u,%s,%s,%s,%s,%d,%s,%s,%u,%.3f\n", timeText, millis, operationName(record->operation), deviceTypeName(record->deviceType),
+                   record->oldUID, record->newUID, record->pid, record->parentName, result, record->muted, latencyMs);
+            break;
+        case kFormatJSON:
+            printf("{\"time\": \"%s.%03u\", \"operation\": \"%s\", \"type\": \"%s\", \"old_uid\": \"%s\", \"new_uid\": \"%s\", \"pid\": %d, \"parent\": \"%s\", \"status\": \"%s\", ",
+                   timeText, millis, operationName(record->operation), deviceTypeName(record->deviceType), record->oldUID, record->newUID, record->pid, record->parentName, result);
+            if (record->operation == kJournalMute) printf("\"muted\": %s, ", record->muted ? "true" : "false");
+            printf("\"latency_ms\": %.3f}\n", latencyMs);
+            break;
+        default:
+            if (record->operation == kJournalMute) {
+                snprintf(change, sizeof(change), "%s %s", record->newUID, record->muted ? "muted" : "unmuted");
+            } else {
+                snprintf(change, sizeof(change), "%s -> %s", record->oldUID[0] ? record->oldUID : "?", record->newUID);
+            }
+            printf("%s.%03u  %-6s %-6s %s  by %s (%d)  %s, %.1f ms\n", timeText, millis, operationName(record->operation), deviceTypeName(record->deviceType),
+                   change, record->parentName, record->pid, result, latencyMs);
+            break;
+    }
+}
+
+// Prints the recorded changes, oldest first, that are of the requested type,
+// no older than sinceSeconds (0 for all), and whose parent process, device
+// UIDs or operation contain match.
+int showHistory(ASDeviceType typeRequested, const char *match, UInt32 sinceSeconds, ASOutputType outputRequested) {
+    const ASJournal *source = mapJournal(false);
+    UInt64 now = wallClockNanos();
+    UInt64 windowNanos = (UInt64)sinceSeconds * 1000000000ULL;
+    UInt64 sinceNanos = sinceSeconds && windowNanos < now ? now - windowNanos : 0;
+
+    if (source == NULL) {
+        return 0;
+    }
+
+    UInt64 head = __atomic_load_n(&source->head, __ATOMIC_ACQUIRE);
+    for (UInt64 position = head > JOURNAL_SLOTS ? head - JOURNAL_SLOTS : 0; position < head; position++) {
+        const ASJournalRecord *slot = &source->records[position % JOURNAL_SLOTS];
+        ASJournalRecord record;
+
+        if (__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) != position + 1) continue;
+        memcpy(&record, slot, sizeof(record));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&slot->sequence, __ATOMIC_RELAXED) != position + 1) continue;
+
+        record.parentName[sizeof(record.parentName) - 1] = '\0';
+        record.oldUID[sizeof(record.oldUID) - 1] = '\0';
+        record.newUID[sizeof(record.newUID) - 1] = '\0';
+        if (matchesHistory(&record, typeRequested, match, sinceNanos)) {
+            showHistoryRecord(&record, outputRequested);
+        }
+    }
+    return 0;
+}
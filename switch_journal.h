@@ -0,0 +1,62 @@
+/*
+ *  switch_journal.h
+ *  AudioSwitcher
+ *
+ *  An always-on record of every switch, cycle and mute made by any
+ *  SwitchAudioSource, so a change nobody remembers making can be traced
+ *  back to the script or hotkey that made it.
+ *
+ *  The journal is a fixed-size ring of fixed-width records in a file that
+ *  every process maps.  A writer reserves a slot by atomically bumping the
+ *  head, so concurrent processes never wait for each other; the slot's
+ *  sequence is zero while it is being filled and its position plus one
+ *  once complete, which lets readers skip records that are mid-write or
+ *  were overwritten while being copied.
+ *
+ *  MIT License, see license.txt
+ */
+
+#ifndef SWITCH_JOURNAL_H
+#define SWITCH_JOURNAL_H
+
+#include "audio_switch.h"
+
+#define JOURNAL_MAGIC 0x4e4a5341		// 'ASJN'
+#define JOURNAL_VERSION 1
+#define JOURNAL_SLOTS 2048
+
+typedef enum {
+	kJournalSwitch = 1,
+	kJournalCycle  = 2,
+	kJournalMute   = 3,
+} ASJournalOperation;
+
+typedef struct {
+	UInt64 sequence;
+	UInt64 timestampNanos;	// since the epoch
+	UInt64 latencyNanos;	// request to confirmation
+	SInt32 pid;
+	OSStatus status;
+	UInt8 operation;		// ASJournalOperation
+	UInt8 deviceType;		// ASDeviceType
+	UInt8 muted;			// mute: the resulting state
+	UInt8 reserved;
+	char parentName[36];	// process that ran SwitchAudioSource
+	char oldUID[128];
+	char newUID[128];
+} ASJournalRecord;
+
+typedef struct {
+	UInt32 magic;
+	UInt32 version;
+	UInt64 head;			// records ever reserved
+	UInt8 padding[48];		// keeps the head on its own cache line
+	ASJournalRecord records[JOURNAL_SLOTS];
+} ASJournal;
+
+void setJournalOperation(ASJournalOperation operation);
+void journalSwitch(ASDeviceType deviceType, AudioDeviceID oldDeviceID, AudioDeviceID newDeviceID, OSStatus status, UInt64 latencyNanos);
+void journalMute(ASDeviceType deviceType, AudioDeviceID deviceID, OSStatus status, UInt32 muted, UInt64 latencyNanos);
+int showHistory(ASDeviceType typeRequested, const char *match, UInt32 sinceSeconds, ASOutputType outputRequested);
+
+#endif
@@ -0,0 +1,245 @@
+/*
+ *  device_name_index_test.c
+ *  AudioSwitcher
+ *
+ *  Builds name indexes by hand and checks what --complete prints from them:
+ *  prefix hits found by the binary search, the empty prefix, misses,
+ *  duplicate names printed once, and uids completed in uid order.  Then
+ *  plants index files under a TMPDIR of its own and checks showCompletions
+ *  answers from a fresh one, rebuilds one that is stale, and rebuilds one
+ *  that misses only once it is more than a moment old, against the
+ *  simulated HAL.  Run by make check.
+ *
+ *  MIT License, see license.txt
+ */
+
+#include "../audio_switch.h"
+#include "../device_name_index.h"
+#include "../device_shm.h"
+#include "simulated_hal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define NANOS_PER_SECOND 1000000000ULL
+#define MAX_PRINTED 16384
+
+static int failures = 0;
+
+typedef struct {
+    const ASNameIndex *index;
+    const char *prefix;
+    UInt32 wantedFlags;
+    bool completeUIDs;
+    ASDeviceType typeRequested;
+} CompletionRequest;
+
+static int printFromIndex(const CompletionRequest *request) {
+    return printNameCompletions(request->index, request->prefix, request->wantedFlags, request->completeUIDs);
+}
+
+static int completeFromFile(const CompletionRequest *request) {
+    return showCompletions(request->prefix, request->typeRequested, request->completeUIDs);
+}
+
+// Runs action with stdout going to a file of its own and returns what it
+// printed in printed.
+static int capture(int (*action)(const CompletionRequest *), const CompletionRequest *request, char *printed, size_t printedSize) {
+    FILE *captured = tmpfile();
+    int result;
+
+    printed[0] = '\0';
+    if (captured == NULL) return -1;
+    fflush(stdout);
+    int savedStdout = dup(STDOUT_FILENO);
+    dup2(fileno(captured), STDOUT_FILENO);
+    result = action(request);
+    fflush(stdout);
+    dup2(savedStdout, STDOUT_FILENO);
+    close(savedStdout);
+
+    rewind(captured);
+    size_t length = fread(printed, 1, printedSize - 1, captured);
+    printed[length] = '\0';
+    fclose(captured);
+    return result;
+}
+
+static void addEntry(ASNameIndex *index, UInt32 flags, const char *name, const char *uid) {
+    ASIndexEntry *entry = &index->entries[index->count++];
+    entry->flags = flags;
+    snprintf(entry->name, sizeof(entry->name), "%s", name);
+    snprintf(entry->uid, sizeof(entry->uid), "%s", uid);
+}
+
+static void expectCompletions(const ASNameIndex *index, const char *prefix, UInt32 wantedFlags, bool completeUIDs, const char *expected) {
+    CompletionRequest request = {index, prefix, wantedFlags, completeUIDs, kAudioTypeUnknown};
+    char printed[MAX_PRINTED];
+    int expectedCount = 0;
+
+    for (const char *line = expected; *line; line++) {
+        if (*line == '\n') expectedCount++;
+    }
+    int count = capture(printFromIndex, &request, printed, sizeof(printed));
+    if (strcmp(printed, expected) != 0 || count != expectedCount) {
+        printf("FAIL completing %s \"%s\": printed %d\n%s  expected %d\n%s", completeUIDs ? "uid" : "name", prefix, count, printed, expectedCount, expected);
+        failures++;
+    }
+}
+
+static void checkHandBuiltIndex(void) {
+    ASNameIndex index;
+
+    memset(&index, 0, sizeof(index));
+    addEntry(&index, kIndexOutput, "Speakers", "BuiltInSpeakerDevice");
+    addEntry(&index, kIndexInput | kIndexOutput, "USB Interface", "AppleUSBAudioEngine:2");
+    addEntry(&index, kIndexInput, "Microphone", "BuiltInMicrophoneDevice");
+    addEntry(&index, kIndexOutput, "USB Interface", "AppleUSBAudioEngine:1");
+    addEntry(&index, kIndexOutput, "Studio Monitors", "ZStudio");
+    addEntry(&index, kIndexOutput, "", "AAAUnnamed");
+    sortNameIndex(&index);
+
+    for (UInt32 i = 1; i < index.count; i++) {
+        if (strcmp(index.entries[i - 1].name, index.entries[i].name) > 0) {
+            printf("FAIL \"%s\" is sorted before \"%s\"\n", index.entries[i - 1].name, index.entries[i].name);
+            failures++;
+        }
+        if (strcmp(index.entries[index.byUID[i - 1]].uid, index.entries[index.byUID[i]].uid) >= 0) {
+            printf("FAIL uid %s is sorted before %s\n", index.entries[index.byUID[i - 1]].uid, index.entries[index.byUID[i]].uid);
+            failures++;
+        }
+    }
+
+    expectCompletions(&index, "S", kIndexOutput, false, "Speakers\nStudio Monitors\n");
+    expectCompletions(&index, "Spe", kIndexOutput, false, "Speakers\n");
+    expectCompletions(&index, "USB", kIndexOutput, false, "USB Interface\n");
+    expectCompletions(&index, "", kIndexOutput, false, "Speakers\nStudio Monitors\nUSB Interface\n");
+    expectCompletions(&index, "", kIndexInput, false, "Microphone\nUSB Interface\n");
+    expectCompletions(&index, "Mic", kIndexOutput, false, "");
+    expectCompletions(&index, "Q", kIndexInput | kIndexOutput, false, "");
+    expectCompletions(&index, "Zebra", kIndexInput | kIndexOutput, false, "");
+    expectCompletions(&index, "AppleUSB", kIndexOutput, true, "AppleUSBAudioEngine:1\nAppleUSBAudioEngine:2\n");
+    expectCompletions(&index, "", kIndexInput | kIndexOutput, true, "AAAUnnamed\nAppleUSBAudioEngine:1\nAppleUSBAudioEngine:2\nBuiltInMicrophoneDevice\nBuiltInSpeakerDevice\nZStudio\n");
+    expectCompletions(&index, "Built", kIndexInput, true, "BuiltInMicrophoneDevice\n");
+}
+
+// A full index, filled in reverse, where every name must be found by the
+// binary search on its own and one character short of itself.
+static void checkFullIndex(void) {
+    ASNameIndex index;
+    char name[32], uid[32], expected[64];
+
+    memset(&index, 0, sizeof(index));
+    for (int i = NAME_INDEX_MAX_DEVICES - 1; i >= 0; i--) {
+        snprintf(name, sizeof(name), "Device %02d", i);
+        snprintf(uid, sizeof(uid), "uid-%02d", NAME_INDEX_MAX_DEVICES - 1 - i);
+        addEntry(&index, kIndexOutput, name, uid);
+    }
+    sortNameIndex(&index);
+
+    for (int i = 0; i < NAME_INDEX_MAX_DEVICES; i++) {
+        snprintf(name, sizeof(name), "Device %02d", i);
+        snprintf(expected, sizeof(expected), "%s\n", name);
+        expectCompletions(&index, name, kIndexOutput, false, expected);
+
+        snprintf(uid, sizeof(uid), "uid-%02d", i);
+        snprintf(expected, sizeof(expected), "%s\n", uid);
+        expectCompletions(&index, uid, kIndexOutput, true, expected);
+    }
+    snprintf(name, sizeof(name), "Device %d", NAME_INDEX_MAX_DEVICES / 10 - 1);
+    CompletionRequest request = {&index, name, kIndexOutput, false, kAudioTypeUnknown};
+    char printed[MAX_PRINTED];
+    if (capture(printFromIndex, &request, printed, sizeof(printed)) != 10) {
+        printf("FAIL \"%s\" should complete ten names:\n%s", name, printed);
+        failures++;
+    }
+}
+
+static UInt64 wallClockNanos(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return (UInt64)now.tv_sec * NANOS_PER_SECOND + now.tv_nsec;
+}
+
+// Puts an index holding only a device the simulated HAL does not have where
+// showCompletions looks for it.
+static void plantIndex(const char *path, SInt64 ageSeconds, UInt64 deviceDigest) {
+    static ASNameIndex index;
+
+    memset(&index, 0, sizeof(index));
+    addEntry(&index, kIndexOutput, "Zebra", "ZebraDevice");
+    sortNameIndex(&index);
+    index.magic = NAME_INDEX_MAGIC;
+    index.version = NAME_INDEX_VERSION;
+    index.builtNanos = wallClockNanos() - ageSeconds * (SInt64)NANOS_PER_SECOND;
+    index.deviceDigest = deviceDigest;
+
+    FILE *file = fopen(path, "wb");
+    if (file == NULL || fwrite(&index, sizeof(index), 1, file) != 1) {
+        printf("FAIL could not write %s\n", path);
+        failures++;
+    }
+    if (file != NULL) fclose(file);
+}
+
+static void expectShown(const char *what, const char *prefix, const char *expected) {
+    CompletionRequest request = {NULL, prefix, 0, false, kAudioTypeOutput};
+    char printed[MAX_PRINTED];
+
+    capture(completeFromFile, &request, printed, sizeof(printed));
+    if (strcmp(printed, expected) != 0) {
+        printf("FAIL %s, completing \"%s\":\n%s  expected\n%s", what, prefix, printed, expected);
+        failures++;
+    }
+}
+
+static void checkRebuildRules(void) {
+    char directory[] = "/tmp/name_index.XXXXXX";
+    char path[sizeof(directory) + 64];
+    UInt64 deviceDigest = 0;
+
+    if (mkdtemp(directory) == NULL) {
+        printf("FAIL could not create a directory for the index\n");
+        failures++;
+        return;
+    }
+    setenv("TMPDIR", directory, 1);
+    snprintf(path, sizeof(path), "%s/SwitchAudioSource.names.%u", directory, (unsigned int)getuid());
+    if (!readSharedDeviceDigest(&deviceDigest)) {
+        deviceDigest = 0;
+    }
+
+    plantIndex(path, 0, deviceDigest);
+    expectShown("a fresh index is used", "Ze", "Zebra\n");
+    expectShown("a fresh index that misses is kept", "Spe", "");
+    expectShown("a fresh index that missed is still there", "Ze", "Zebra\n");
+
+    plantIndex(path, NAME_INDEX_MISS_REBUILD_SECONDS + 3, deviceDigest);
+    expectShown("an index that misses after a moment is rebuilt", "Spe", "Speakers\n");
+    expectShown("the rebuilt index replaced it", "Ze", "");
+
+    plantIndex(path, NAME_INDEX_MAX_AGE_SECONDS + 1, deviceDigest);
+    expectShown("an old index is rebuilt", "Ze", "");
+
+    plantIndex(path, -10, deviceDigest);
+    expectShown("an index from the future is rebuilt", "Ze", "");
+
+    plantIndex(path, 0, deviceDigest + 1);
+    expectShown("an index of another device table is rebuilt", "Ze", "");
+
+    unlink(path);
+    rmdir(directory);
+}
+
+int main(void) {
+    startSimulatedHAL(1, 0, 0);
+
+    checkHandBuiltIndex();
+    checkFullIndex();
+    checkRebuildRules();
+
+    printf("device_name_index: %s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,190 @@
+/*
+ *  device_records_test.c
+ *  AudioSwitcher
+ *
+ *  Encodes device and current records in both record formats, runs them
+ *  back through decodeRecords and checks every field comes out in --fields
+ *  order with the value it went in with, names with commas and quotes and
+ *  names of the full 255 bytes included.  Then lists the simulated HAL's
+ *  devices with -t all and checks the inputs come before the outputs in the
+ *  one listing.  Run by make check.
+ *
+ *  MIT License, see license.txt
+ */
+
+#include "../audio_switch.h"
+#include "../device_records.h"
+#include "../device_hog.h"
+#include "simulated_hal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAX_DECODED 16384
+
+static int failures = 0;
+
+// Runs action with stdout going to a file of its own, and returns the file
+// rewound.
+static FILE *captureStdout(int (*action)(void *), void *context, int *result) {
+    FILE *captured = tmpfile();
+    if (captured == NULL) return NULL;
+
+    fflush(stdout);
+    int savedStdout = dup(STDOUT_FILENO);
+    dup2(fileno(captured), STDOUT_FILENO);
+    *result = action(context);
+    fflush(stdout);
+    dup2(savedStdout, STDOUT_FILENO);
+    close(savedStdout);
+    rewind(captured);
+    return captured;
+}
+
+static int flushWriter(void *context) {
+    return flushRecordWriter((ASRecordWriter *)context);
+}
+
+typedef struct {
+    FILE *input;
+    ASOutputType format;
+} DecodeRequest;
+
+static int decode(void *context) {
+    DecodeRequest *request = context;
+    return decodeRecords(request->input, request->format);
+}
+
+// Decodes what encoded holds into decoded, one JSON line per record.
+static int decodeInto(FILE *encoded, ASOutputType format, char *decoded, size_t decodedSize) {
+    DecodeRequest request = {encoded, format};
+    int result = 1;
+    FILE *output = captureStdout(decode, &request, &result);
+
+    if (output == NULL) return 1;
+    size_t length = fread(decoded, 1, decodedSize - 1, output);
+    decoded[length] = '\0';
+    fclose(output);
+    return result;
+}
+
+static int flushAndDecode(ASRecordWriter *writer, char *decoded, size_t decodedSize) {
+    ASOutputType format = writer->format;
+    int result = 1;
+    FILE *encoded = captureStdout(flushWriter, writer, &result);
+
+    if (encoded == NULL || result != 0) {
+        if (encoded != NULL) fclose(encoded);
+        return 1;
+    }
+    result = decodeInto(encoded, format, decoded, decodedSize);
+    fclose(encoded);
+    return result;
+}
+
+static void expectEqual(const char *what, const char *format, const char *got, const char *expected) {
+    if (strcmp(got, expected) != 0) {
+        printf("FAIL %s (%s):\n  got      %s  expected %s", what, format, got, expected);
+        failures++;
+    }
+}
+
+static void checkRoundTrip(ASOutputType format) {
+    const char *formatName = format == kFormatBinary ? "binary" : "msgpack";
+    ASDeviceInfo speakers, longNamed;
+    ASRecordWriter writer;
+    char decoded[MAX_DECODED];
+    char expected[MAX_DECODED];
+    char longName[256];
+
+    memset(longName, 'n', 255);
+    longName[255] = '\0';
+
+    memset(&speakers, 0, sizeof(speakers));
+    speakers.deviceID = 42;
+    snprintf(speakers.name, sizeof(speakers.name), "Studio \"A\", left");
+    snprintf(speakers.uid, sizeof(speakers.uid), "AppleUSBAudioEngine:Studio,A:1");
+    speakers.sampleRate = 48000;
+    speakers.outputLatency = 512;
+    speakers.isAlive = 1;
+    speakers.hogOwner = kNoHogOwner;
+
+    memset(&longNamed, 0, sizeof(longNamed));
+    longNamed.deviceID = 70000;
+    memcpy(longNamed.name, longName, sizeof(longName));
+    memcpy(longNamed.uid, longName, sizeof(longName));
+    longNamed.sampleRate = 44100.5;
+    longNamed.inputLatency = 7;
+    longNamed.hogOwner = 1234;
+
+    UInt32 fields = kFieldName | kFieldType | kFieldID | kFieldUID | kFieldSampleRate | kFieldLatency | kFieldAlive | kFieldHogOwner;
+
+    initRecordWriter(&writer, format);
+    writeDeviceRecord(&writer, kRecordDevice, &speakers, fields, kAudioTypeOutput);
+    writeDeviceRecord(&writer, kRecordDevice, &longNamed, fields, kAudioTypeInput);
+    writeDeviceRecord(&writer, kRecordCurrent, &speakers, kDefaultDeviceFields, kAudioTypeOutput);
+    if (flushAndDecode(&writer, decoded, sizeof(decoded)) != 0) {
+        printf("FAIL the %s records did not decode\n", formatName);
+        failures++;
+        return;
+    }
+
+    snprintf(expected, sizeof(expected),
+             "{\"kind\": \"device\", \"name\": \"Studio \\\"A\\\", left\", \"type\": \"output\", \"id\": 42, \"uid\": \"AppleUSBAudioEngine:Studio,A:1\", \"sample_rate\": 48000, \"latency\": 512, \"alive\": true, \"hog_owner\": null}\n"
+             "{\"kind\": \"device\", \"name\": \"%s\", \"type\": \"input\", \"id\": 70000, \"uid\": \"%s\", \"sample_rate\": 44100.5, \"latency\": 7, \"alive\": false, \"hog_owner\": 1234}\n"
+             "{\"kind\": \"current\", \"name\": \"Studio \\\"A\\\", left\", \"type\": \"output\", \"id\": 42, \"uid\": \"AppleUSBAudioEngine:Studio,A:1\"}\n",
+             longName, longName);
+    expectEqual("round trip", formatName, decoded, expected);
+}
+
+typedef struct {
+    ASOutputType format;
+} ListRequest;
+
+static int listAll(void *context) {
+    ListRequest *request = context;
+    return showAllDevices(kAudioTypeAll, request->format, kDefaultDeviceFields);
+}
+
+static void checkListing(ASOutputType format) {
+    const char *formatName = format == kFormatBinary ? "binary" : "msgpack";
+    ListRequest request = {format};
+    char decoded[MAX_DECODED];
+    int result = 1;
+    FILE *encoded = captureStdout(listAll, &request, &result);
+
+    if (encoded == NULL || result != 0 || decodeInto(encoded, format, decoded, sizeof(decoded)) != 0) {
+        printf("FAIL -a -t all -f %s did not decode\n", formatName);
+        failures++;
+        if (encoded != NULL) fclose(encoded);
+        return;
+    }
+    fclose(encoded);
+
+    const char *firstOutput = strstr(decoded, "\"type\": \"output\"");
+    const char *lastInput = NULL;
+    for (const char *input = strstr(decoded, "\"type\": \"input\""); input != NULL; input = strstr(input + 1, "\"type\": \"input\"")) {
+        lastInput = input;
+    }
+    if (firstOutput == NULL || lastInput == NULL || lastInput > firstOutput) {
+        printf("FAIL -a -t all -f %s does not list the inputs and then the outputs:\n%s", formatName, decoded);
+        failures++;
+    }
+    if (strstr(decoded, "\"name\": \"Microphone\"") == NULL || strstr(decoded, "\"name\": \"Speakers\"") == NULL) {
+        printf("FAIL -a -t all -f %s left out a device:\n%s", formatName, decoded);
+        failures++;
+    }
+}
+
+int main(void) {
+    startSimulatedHAL(1, 0, 0);
+
+    checkRoundTrip(kFormatBinary);
+    checkRoundTrip(kFormatMsgPack);
+    checkListing(kFormatBinary);
+    checkListing(kFormatMsgPack);
+
+    printf("device_records: %s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
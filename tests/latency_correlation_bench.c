@@ -0,0 +1,59 @@
+/*
+ *  latency_correlation_bench.c
+ *  AudioSwitcher
+ *
+ *  Times findSignalDelay on a 60 second recording, far longer than the
+ *  window --measure-latency searches, to show how the FFT search scales.
+ *  Run by make bench.
+ *
+ *  MIT License, see license.txt
+ */
+
+#include "../latency_correlation.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define SAMPLE_RATE 48000
+#define CAPTURE_SECONDS 60
+#define CAPTURE_LENGTH ((size_t)SAMPLE_RATE * CAPTURE_SECONDS)
+#define BENCH_DELAY ((size_t)SAMPLE_RATE * 41 + 123)
+#define BENCH_RUNS 5
+
+static double nowSeconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+int main(void) {
+    float *signal = malloc(((size_t)1 << LATENCY_MLS_ORDER) * sizeof(float));
+    float *capture = malloc(CAPTURE_LENGTH * sizeof(float));
+    double best = INFINITY;
+    float confidence = 0.0f;
+    long delay = -1;
+
+    if (signal == NULL || capture == NULL) {
+        printf("Could not allocate a %d second recording\n", CAPTURE_SECONDS);
+        return 1;
+    }
+    size_t signalLength = generateMLS(LATENCY_MLS_ORDER, 0.25f, signal);
+    generateDelayedCapture(signal, signalLength, BENCH_DELAY, 0.5f, 0.1f, 1, capture, CAPTURE_LENGTH);
+
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        double start = nowSeconds();
+        delay = findSignalDelay(signal, signalLength, capture, CAPTURE_LENGTH, &confidence);
+        double elapsed = nowSeconds() - start;
+        if (elapsed < best) best = elapsed;
+    }
+
+    printf("latency_correlation: %d s at %d Hz (%zu samples), order %d sequence, best of %d runs\n",
+        CAPTURE_SECONDS, SAMPLE_RATE, CAPTURE_LENGTH, LATENCY_MLS_ORDER, BENCH_RUNS);
+    printf("  findSignalDelay      %8.3f ms  delay %ld (%s), confidence %.1f\n",
+        best * 1e3, delay, delay == (long)BENCH_DELAY ? "correct" : "WRONG", confidence);
+
+    free(signal);
+    free(capture);
+    return delay == (long)BENCH_DELAY ? 0 : 1;
+}
@@ -0,0 +1,88 @@
+/*
+ *  latency_correlation_test.c
+ *  AudioSwitcher
+ *
+ *  Checks that findSignalDelay finds the sequence --measure-latency plays
+ *  at known delays in synthetic recordings: clean, under noise, with the
+ *  polarity inverted, and that recordings of noise alone stay below
+ *  MIN_CORRELATION_CONFIDENCE.  Run by make check.
+ *
+ *  MIT License, see license.txt
+ */
+
+#include "../latency_correlation.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define SAMPLE_RATE 48000
+#define SIGNAL_AMPLITUDE 0.25f
+#define CAPTURE_LENGTH (SAMPLE_RATE * 3 / 2 + (1 << LATENCY_MLS_ORDER))		// the 1.5 s window and the signal
+#define NOISE_SEEDS 20
+
+static int failures = 0;
+
+static void checkDelay(const float *signal, size_t signalLength, float *capture, size_t delay, float gain, float noise, unsigned int seed, const char *what) {
+    float confidence = 0.0f;
+
+    generateDelayedCapture(signal, signalLength, delay, gain, noise, seed, capture, CAPTURE_LENGTH);
+    long found = findSignalDelay(signal, signalLength, capture, CAPTURE_LENGTH, &confidence);
+    if (found != (long)delay || confidence < MIN_CORRELATION_CONFIDENCE) {
+        printf("FAIL %s: delay %zu found at %ld with confidence %.1f\n", what, delay, found, confidence);
+        failures++;
+    }
+}
+
+int main(void) {
+    const size_t delays[] = {0, 1, 37, 480, 4095, 4096, 30000, SAMPLE_RATE, SAMPLE_RATE * 3 / 2 - 1};
+    float *signal = malloc(((size_t)1 << LATENCY_MLS_ORDER) * sizeof(float));
+    float *capture = malloc(CAPTURE_LENGTH * sizeof(float));
+    float highestNoiseConfidence = 0.0f;
+
+    if (signal == NULL || capture == NULL) {
+        printf("Could not allocate the test buffers\n");
+        return 1;
+    }
+    size_t signalLength = generateMLS(LATENCY_MLS_ORDER, SIGNAL_AMPLITUDE, signal);
+
+    // every supported order gives a sequence of the full length, and none
+    // outside them
+    float *sequence = malloc(((size_t)1 << MAX_MLS_ORDER) * sizeof(float));
+    for (unsigned int order = MIN_MLS_ORDER; order <= MAX_MLS_ORDER && sequence; order++) {
+        size_t length = generateMLS(order, 1.0f, sequence);
+        long sum = 0;
+        for (size_t i = 0; i < length; i++) sum += sequence[i] > 0.0f ? 1 : -1;
+        // a maximum length sequence has one more +1 than -1
+        if (length != ((size_t)1 << order) - 1 || sum != 1) {
+            printf("FAIL order %u: %zu samples, balance %ld\n", order, length, sum);
+            failures++;
+        }
+    }
+    if (sequence == NULL || generateMLS(MIN_MLS_ORDER - 1, 1.0f, sequence) != 0 || generateMLS(MAX_MLS_ORDER + 1, 1.0f, sequence) != 0) {
+        printf("FAIL unsupported orders are not rejected\n");
+        failures++;
+    }
+    free(sequence);
+
+    for (size_t i = 0; i < sizeof(delays) / sizeof(delays[0]); i++) {
+        checkDelay(signal, signalLength, capture, delays[i], 1.0f, 0.0f, 1, "clean");
+        // a quiet return under noise twice as loud as the signal
+        checkDelay(signal, signalLength, capture, delays[i], 0.25f, 0.5f, (unsigned int)i + 1, "noisy");
+        checkDelay(signal, signalLength, capture, delays[i], -1.0f, 0.01f, (unsigned int)i + 1, "inverted");
+    }
+
+    for (unsigned int seed = 1; seed <= NOISE_SEEDS; seed++) {
+        float confidence = 0.0f;
+        generateDelayedCapture(signal, signalLength, 0, 0.0f, 0.5f, seed, capture, CAPTURE_LENGTH);
+        findSignalDelay(signal, signalLength, capture, CAPTURE_LENGTH, &confidence);
+        if (confidence > highestNoiseConfidence) highestNoiseConfidence = confidence;
+    }
+    if (highestNoiseConfidence >= MIN_CORRELATION_CONFIDENCE) {
+        printf("FAIL noise alone reached confidence %.1f, the threshold is %.1f\n", highestNoiseConfidence, MIN_CORRELATION_CONFIDENCE);
+        failures++;
+    }
+
+    free(signal);
+    free(capture);
+    printf("latency_correlation: %s (noise alone scores at most %.1f)\n", failures ? "FAILED" : "ok", highestNoiseConfidence);
+    return failures ? 1 : 0;
+}
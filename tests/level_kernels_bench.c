@@ -0,0 +1,66 @@
+/*
+ *  level_kernels_bench.c
+ *  AudioSwitcher
+ *
+ *  Times measureLevels and measureLevelsScalar over a 16M sample buffer,
+ *  far more than any IO cycle, so the figure is the kernels' throughput
+ *  rather than call overhead.  Run by make bench.
+ *
+ *  MIT License, see license.txt
+ */
+
+#include "../level_kernels.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define BENCH_SAMPLES (16 * 1024 * 1024)
+#define BENCH_RUNS 10
+
+typedef void (*ASLevelKernel)(const float *samples, size_t count, float *peak, double *sumSquares);
+
+static double nowSeconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// The best of several runs, which is the least disturbed by everything else.
+static double timeKernel(ASLevelKernel kernel, const float *samples, float *peak, double *sum) {
+    double best = INFINITY;
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        double start = nowSeconds();
+        kernel(samples, BENCH_SAMPLES, peak, sum);
+        double elapsed = nowSeconds() - start;
+        if (elapsed < best) best = elapsed;
+    }
+    return best;
+}
+
+int main(void) {
+    float *samples = malloc(BENCH_SAMPLES * sizeof(float));
+    float peak, scalarPeak;
+    double sum, scalarSum;
+
+    if (samples == NULL) {
+        printf("Could not allocate %d samples\n", BENCH_SAMPLES);
+        return 1;
+    }
+    srand(1);
+    for (size_t i = 0; i < BENCH_SAMPLES; i++) {
+        samples[i] = (float)rand() / RAND_MAX * 2.0f - 1.0f;
+    }
+
+    double vector = timeKernel(measureLevels, samples, &peak, &sum);
+    double scalar = timeKernel(measureLevelsScalar, samples, &scalarPeak, &scalarSum);
+
+    printf("level_kernels: %d samples, best of %d runs\n", BENCH_SAMPLES, BENCH_RUNS);
+    printf("  measureLevels        %8.3f ms  %6.2f GB/s\n", vector * 1e3, BENCH_SAMPLES * sizeof(float) / vector / 1e9);
+    printf("  measureLevelsScalar  %8.3f ms  %6.2f GB/s\n", scalar * 1e3, BENCH_SAMPLES * sizeof(float) / scalar / 1e9);
+    printf("  speedup %.2fx, peak %s, sum of squares differs by %.2e relative\n",
+        scalar / vector, peak == scalarPeak ? "equal" : "DIFFERS", fabs(sum - scalarSum) / scalarSum);
+
+    free(samples);
+    return peak == scalarPeak ? 0 : 1;
+}
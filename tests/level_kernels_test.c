@@ -0,0 +1,100 @@
+/*
+ *  level_kernels_test.c
+ *  AudioSwitcher
+ *
+ *  Checks measureLevels against measureLevelsScalar on blocks of every
+ *  size up to a few vectors, at every alignment, and on random lengths up
+ *  to a large IO buffer.  Run by make check.
+ *
+ *  MIT License, see license.txt
+ */
+
+#include "../level_kernels.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MAX_BLOCK 65536
+#define RANDOM_BLOCKS 2000
+#define SUM_TOLERANCE 1e-5
+
+static int failures = 0;
+
+static float randomSample(void) {
+    return (float)rand() / RAND_MAX * 2.0f - 1.0f;
+}
+
+static void checkBlock(const float *samples, size_t count, const char *what) {
+    float peak, referencePeak;
+    double sum, referenceSum;
+
+    measureLevels(samples, count, &peak, &sum);
+    measureLevelsScalar(samples, count, &referencePeak, &referenceSum);
+
+    // the peak is a comparison, so it is exact; only the sum rounds
+    if (peak != referencePeak || fabs(sum - referenceSum) > SUM_TOLERANCE * (referenceSum + 1e-30)) {
+        printf("FAIL %s, %zu samples: peak %.9g, expected %.9g; sum of squares %.12g, expected %.12g\n", what, count, peak, referencePeak, sum, referenceSum);
+        failures++;
+    }
+}
+
+int main(void) {
+    float *buffer = malloc((MAX_BLOCK + 8) * sizeof(float));
+
+    srand(1);
+    for (size_t i = 0; i < MAX_BLOCK + 8; i++) {
+        buffer[i] = randomSample();
+    }
+
+    // every tail length, at every offset from a vector boundary
+    for (size_t offset = 0; offset < 8; offset++) {
+        for (size_t count = 0; count <= 40; count++) {
+            checkBlock(buffer + offset, count, "short block");
+        }
+    }
+
+    for (int i = 0; i < RANDOM_BLOCKS; i++) {
+        checkBlock(buffer + rand() % 8, rand() % MAX_BLOCK, "random block");
+    }
+
+    // the peak in the last sample, past every full vector, and negative
+    for (size_t count = 1; count <= 19; count++) {
+        for (size_t j = 0; j < count; j++) buffer[j] = 0.25f;
+        buffer[count - 1] = -0.75f;
+        checkBlock(buffer, count, "peak in the tail");
+    }
+
+    // silence, and a full scale square wave
+    for (size_t j = 0; j < 1024; j++) buffer[j] = 0.0f;
+    checkBlock(buffer, 1024, "silence");
+    for (size_t j = 0; j < 1024; j++) buffer[j] = (j & 1) ? -1.0f : 1.0f;
+    checkBlock(buffer, 1024, "full scale");
+
+    // NaN never becomes the peak
+    for (size_t j = 0; j < 64; j++) buffer[j] = 0.5f;
+    buffer[13] = NAN;
+    float peak, referencePeak;
+    double sum, referenceSum;
+    measureLevels(buffer, 64, &peak, &sum);
+    measureLevelsScalar(buffer, 64, &referencePeak, &referenceSum);
+    if (peak != 0.5f || referencePeak != 0.5f) {
+        printf("FAIL NaN sample: peak %g, reference %g, expected 0.5\n", peak, referencePeak);
+        failures++;
+    }
+
+    // one channel out of interleaved stereo
+    float interleaved[16], channel[8];
+    for (int j = 0; j < 16; j++) interleaved[j] = (float)j;
+    deinterleaveChannel(interleaved, 8, 2, 1, channel);
+    for (int j = 0; j < 8; j++) {
+        if (channel[j] != (float)(2 * j + 1)) {
+            printf("FAIL deinterleave: sample %d is %g, expected %d\n", j, channel[j], 2 * j + 1);
+            failures++;
+            break;
+        }
+    }
+
+    free(buffer);
+    printf("level_kernels: %s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,118 @@
+/*
+ *  resolve_stress_test.c
+ *  AudioSwitcher
+ *
+ *  Switches thousands of times by name and by UID against the simulated
+ *  HAL while devices are plugged in and out underneath, with the device
+ *  list notifications arriving late.  Every switch setResolvedDevice
+ *  reports as done must have left the default on a device that is still
+ *  there and is the one asked for.  Run by make check.
+ *
+ *  MIT License, see license.txt
+ */
+
+#include "../audio_switch.h"
+#include "../device_snapshot.h"
+#include "simulated_hal.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define SWITCHES 10000
+#define HOT_PLUG_CHANCE 0.02
+#define MAX_NOTIFY_DELAY_MICROS 500
+#define SWITCH_TIMEOUT_MS 20
+
+typedef struct {
+    char *query;
+    const char *expectedName;
+    ASDeviceType type;
+    ASDeviceResolver resolver;
+} Target;
+
+static const Target targets[] = {
+    {"Headphones", "Headphones", kAudioTypeOutput, getRequestedDeviceID},
+    {"Speakers", "Speakers", kAudioTypeOutput, getRequestedDeviceID},
+    {"USB Interface", "USB Interface", kAudioTypeInput, getRequestedDeviceID},
+    {"Interface", "USB Interface", kAudioTypeOutput, getRequestedDeviceIDFromUIDSubstring},
+    {"BluetoothHeadphones:output", "Headphones", kAudioTypeSystemOutput, getRequestedDeviceIDFromUID},
+    {"BuiltInMicrophoneDevice", "Microphone", kAudioTypeInput, getRequestedDeviceIDFromUID},
+};
+#define TARGET_COUNT (int)(sizeof(targets) / sizeof(targets[0]))
+
+static AudioObjectPropertySelector defaultSelector(ASDeviceType type) {
+    switch (type) {
+        case kAudioTypeInput: return kAudioHardwarePropertyDefaultInputDevice;
+        case kAudioTypeSystemOutput: return kAudioHardwarePropertyDefaultSystemOutputDevice;
+        default: return kAudioHardwarePropertyDefaultOutputDevice;
+    }
+}
+
+int main(void) {
+    char journalDirectory[] = "/tmp/resolve_stress.XXXXXX";
+    char journalPath[sizeof(journalDirectory) + 64];
+    int failures = 0, stale = 0, switched = 0, refused = 0, absent = 0;
+
+    // the journal goes to a directory of its own, and what the switches
+    // print to /dev/null
+    if (mkdtemp(journalDirectory) == NULL) {
+        printf("Could not create a directory for the journal\n");
+        return 1;
+    }
+    setenv("TMPDIR", journalDirectory, 1);
+    fflush(stdout);
+    int savedStdout = dup(STDOUT_FILENO);
+    int devNull = open("/dev/null", O_WRONLY);
+    dup2(devNull, STDOUT_FILENO);
+    close(devNull);
+
+    startSimulatedHAL(1, HOT_PLUG_CHANCE, MAX_NOTIFY_DELAY_MICROS);
+    setSwitchTimeout(SWITCH_TIMEOUT_MS);
+
+    for (int i = 0; i < SWITCHES; i++) {
+        const Target *target = &targets[i % TARGET_COUNT];
+
+        UInt64 generation = trackDeviceListGeneration();
+        AudioDeviceID deviceID = target->resolver(target->query, target->type);
+        if (deviceID == kAudioDeviceUnknown) {
+            absent++;
+            continue;
+        }
+        if (setResolvedDevice(&deviceID, target->type, target->resolver, target->query, generation) != 0) {
+            refused++;
+            continue;
+        }
+        switched++;
+
+        AudioDeviceID current = getSimulatedDefault(defaultSelector(target->type));
+        if (current != deviceID || !isSimulatedDevice(current, target->expectedName)) {
+            if (stale++ < 10) {
+                fprintf(stderr, "FAIL switch %d to %s: reported %u, the default is %u\n", i, target->query, deviceID, current);
+            }
+        }
+    }
+
+    fflush(stdout);
+    dup2(savedStdout, STDOUT_FILENO);
+    close(savedStdout);
+    snprintf(journalPath, sizeof(journalPath), "%s/SwitchAudioSource.journal.%u", journalDirectory, (unsigned int)getuid());
+    unlink(journalPath);
+    rmdir(journalDirectory);
+
+    if (stale > 0) {
+        printf("FAIL %d switches were reported done on a device that is gone or not the one asked for\n", stale);
+        failures++;
+    }
+    if (switched < SWITCHES / 2) {
+        printf("FAIL only %d of %d switches went through\n", switched, SWITCHES);
+        failures++;
+    }
+    if (getSimulatedHotPlugs() < SWITCHES / 10) {
+        printf("FAIL only %u hot plugs happened\n", getSimulatedHotPlugs());
+        failures++;
+    }
+
+    printf("resolve_stress: %s (%d switched, %d gave up, %d absent, %u hot plugs)\n", failures ? "FAILED" : "ok", switched, refused, absent, getSimulatedHotPlugs());
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,385 @@
+/*
+ *  simulated_hal.c
+ *  AudioSwitcher
+ *
+ *  MIT License, see license.txt
+ */
+
+#include "simulated_hal.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MAX_LISTENERS 64
+#define MAX_PENDING 256
+#define FIRST_PLUGGED_ID 100
+
+typedef struct {
+	const char *name;
+	const char *uid;
+	bool output;
+	bool input;
+	bool pluggable;
+	AudioDeviceID deviceID;		// kAudioDeviceUnknown while unplugged
+} SimulatedDevice;
+
+typedef struct {
+	AudioObjectID objectID;
+	AudioObjectPropertySelector selector;
+	AudioObjectPropertyListenerProc proc;
+	void *clientData;
+} SimulatedListener;
+
+typedef struct {
+	AudioObjectID objectID;
+	AudioObjectPropertyAddress address;
+	UInt64 deliverNanos;
+} SimulatedNotification;
+
+static SimulatedDevice devices[] = {
+	{"Speakers", "BuiltInSpeakerDevice", true, false, false, 2},
+	{"Microphone", "BuiltInMicrophoneDevice", false, true, false, 3},
+	{"Headphones", "BluetoothHeadphones:output", true, false, true, FIRST_PLUGGED_ID},
+	{"USB Interface", "AppleUSBAudioEngine:Interface:1", true, true, true, FIRST_PLUGGED_ID + 1},
+};
+#define DEVICE_COUNT (int)(sizeof(devices) / sizeof(devices[0]))
+
+static AudioDeviceID defaultOutput = 2;
+static AudioDeviceID defaultInput = 3;
+static AudioDeviceID defaultSystemOutput = 2;
+static AudioDeviceID nextDeviceID = FIRST_PLUGGED_ID + 2;
+static UInt32 hotPlugs = 0;
+static unsigned int randomState = 1;
+static double plugChance = 0.0;
+static UInt32 maxDelayMicros = 0;
+static pthread_mutex_t stateMutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Listeners are called with listenerMutex held, so that once
+// AudioObjectRemovePropertyListener returns the listener is not running,
+// as the HAL guarantees.
+static SimulatedListener listeners[MAX_LISTENERS];
+static int listenerCount = 0;
+static pthread_mutex_t listenerMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static SimulatedNotification pending[MAX_PENDING];
+static UInt32 pendingHead = 0;
+static UInt32 pendingTail = 0;
+static pthread_mutex_t pendingMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pendingCond = PTHREAD_COND_INITIALIZER;
+
+static UInt64 monotonicNanos(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (UInt64)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+// called with stateMutex held
+static void notify(AudioObjectID objectID, AudioObjectPropertySelector selector) {
+    UInt64 delay = maxDelayMicros ? (UInt64)(rand_r(&randomState) % (maxDelayMicros + 1)) * 1000ULL : 0;
+
+    pthread_mutex_lock(&pendingMutex);
+    if (pendingTail - pendingHead < MAX_PENDING) {
+        SimulatedNotification *notification = &pending[pendingTail++ % MAX_PENDING];
+        notification->objectID = objectID;
+        notification->address = (AudioObjectPropertyAddress){selector, kAudioObjectPropertyScopeGlobal, kAudioObjectPropertyElementMain};
+        notification->deliverNanos = monotonicNanos() + delay;
+        pthread_cond_signal(&pendingCond);
+    }
+    pthread_mutex_unlock(&pendingMutex);
+}
+
+static void *notificationThread(void *context) {
+    for (;;) {
+        pthread_mutex_lock(&pendingMutex);
+        while (pendingHead == pendingTail) {
+            pthread_cond_wait(&pendingCond, &pendingMutex);
+        }
+        SimulatedNotification notification = pending[pendingHead++ % MAX_PENDING];
+        pthread_mutex_unlock(&pendingMutex);
+
+        UInt64 now = monotonicNanos();
+        if (notification.deliverNanos > now) {
+            UInt64 wait = notification.deliverNanos - now;
+            struct timespec pause = {(time_t)(wait / 1000000000ULL), (long)(wait % 1000000000ULL)};
+            nanosleep(&pause, NULL);
+        }
+
+        pthread_mutex_lock(&listenerMutex);
+        for (int i = 0; i < listenerCount; i++) {
+            if (listeners[i].objectID == notification.objectID && listeners[i].selector == notification.address.mSelector) {
+                listeners[i].proc(notification.objectID, 1, &notification.address, listeners[i].clientData);
+            }
+        }
+        pthread_mutex_unlock(&listenerMutex);
+    }
+    return NULL;
+}
+
+// called with stateMutex held
+static SimulatedDevice *findDevice(AudioObjectID objectID) {
+    for (int i = 0; i < DEVICE_COUNT; i++) {
+        if (devices[i].deviceID != kAudioDeviceUnknown && devices[i].deviceID == objectID) return &devices[i];
+    }
+    return NULL;
+}
+
+// Moves a default off a device that went away, to the first remaining
+// device that can take it, as the HAL does.
+static void replaceDefault(AudioDeviceID *defaultDevice, AudioObjectPropertySelector selector, AudioDeviceID removedID, bool output) {
+    if (*defaultDevice != removedID) return;
+    for (int i = 0; i < DEVICE_COUNT; i++) {
+        if (devices[i].deviceID != kAudioDeviceUnknown && (output ? devices[i].output : devices[i].input)) {
+            *defaultDevice = devices[i].deviceID;
+            notify(kAudioObjectSystemObject, selector);
+            return;
+        }
+    }
+}
+
+// Plugs in or unplugs one of the pluggable devices.  A device plugged back
+// in comes back under a new id.
+static void maybeHotPlug(void) {
+    pthread_mutex_lock(&stateMutex);
+    if ((double)rand_r(&randomState) / RAND_MAX < plugChance) {
+        int pluggable[DEVICE_COUNT];
+        int count = 0;
+        for (int i = 0; i < DEVICE_COUNT; i++) {
+            if (devices[i].pluggable) pluggable[count++] = i;
+        }
+        SimulatedDevice *device = &devices[pluggable[rand_r(&randomState) % count]];
+
+        if (device->deviceID == kAudioDeviceUnknown) {
+            device->deviceID = nextDeviceID++;
+        } else {
+            AudioDeviceID removedID = device->deviceID;
+            device->deviceID = kAudioDeviceUnknown;
+            replaceDefault(&defaultOutput, kAudioHardwarePropertyDefaultOutputDevice, removedID, true);
+            replaceDefault(&defaultSystemOutput, kAudioHardwarePropertyDefaultSystemOutputDevice, removedID, true);
+            replaceDefault(&defaultInput, kAudioHardwarePropertyDefaultInputDevice, removedID, false);
+        }
+        hotPlugs++;
+        notify(kAudioObjectSystemObject, kAudioHardwarePropertyDevices);
+    }
+    pthread_mutex_unlock(&stateMutex);
+}
+
+static AudioDeviceID *getDefaultSlot(AudioObjectPropertySelector selector, bool *output) {
+    switch (selector) {
+        case kAudioHardwarePropertyDefaultOutputDevice: *output = true; return &defaultOutput;
+        case kAudioHardwarePropertyDefaultSystemOutputDevice: *output = true; return &defaultSystemOutput;
+        case kAudioHardwarePropertyDefaultInputDevice: *output = false; return &defaultInput;
+        default: return NULL;
+    }
+}
+
+static bool hasStreams(const SimulatedDevice *device, AudioObjectPropertyScope scope, AudioObjectPropertyElement element) {
+    switch (scope) {
+        case kAudioObjectPropertyScopeOutput: return device->output;
+        case kAudioObjectPropertyScopeInput: return device->input;
+        default: return element == kAudioObjectPropertyElementMain ? device->output : device->input;
+    }
+}
+
+// called with stateMutex held; a NULL outData asks for the size only
+static OSStatus getProperty(AudioObjectID objectID, const AudioObjectPropertyAddress *address, UInt32 qualifierSize, const void *qualifier, UInt32 *ioDataSize, void *outData) {
+    bool output;
+
+    if (objectID == kAudioObjectSystemObject) {
+        AudioDeviceID *defaultDevice = getDefaultSlot(address->mSelector, &output);
+        if (defaultDevice != NULL) {
+            if (outData != NULL && *ioDataSize < sizeof(AudioDeviceID)) return kAudioHardwareBadPropertySizeError;
+            if (outData != NULL) *(AudioDeviceID *)outData = *defaultDevice;
+            *ioDataSize = sizeof(AudioDeviceID);
+            return noErr;
+        }
+        if (address->mSelector == kAudioHardwarePropertyDevices) {
+            UInt32 count = 0;
+            for (int i = 0; i < DEVICE_COUNT; i++) {
+                if (devices[i].deviceID == kAudioDeviceUnknown) continue;
+                if (outData != NULL && (count + 1) * sizeof(AudioDeviceID) > *ioDataSize) break;
+                if (outData != NULL) ((AudioDeviceID *)outData)[count] = devices[i].deviceID;
+                count++;
+            }
+            *ioDataSize = count * sizeof(AudioDeviceID);
+            return noErr;
+        }
+        if (address->mSelector == kAudioHardwarePropertyTranslateUIDToDevice) {
+            char uid[256] = "";
+            if (qualifierSize != sizeof(CFStringRef)) return kAudioHardwareBadPropertySizeError;
+            CFStringGetCString(*(const CFStringRef *)qualifier, uid, sizeof(uid), kCFStringEncodingUTF8);
+            if (outData != NULL) {
+                *(AudioDeviceID *)outData = kAudioDeviceUnknown;
+                for (int i = 0; i < DEVICE_COUNT; i++) {
+                    if (devices[i].deviceID != kAudioDeviceUnknown && strcmp(devices[i].uid, uid) == 0) *(AudioDeviceID *)outData = devices[i].deviceID;
+                }
+            }
+            *ioDataSize = sizeof(AudioDeviceID);
+            return noErr;
+        }
+        return kAudioHardwareUnknownPropertyError;
+    }
+
+    SimulatedDevice *device = findDevice(objectID);
+    if (device == NULL) return kAudioHardwareBadObjectError;
+
+    switch (address->mSelector) {
+        case kAudioObjectPropertyName:
+        case kAudioDevicePropertyDeviceUID:
+            if (outData != NULL) *(CFStringRef *)outData = CFStringCreateWithCString(kCFAllocatorDefault, address->mSelector == kAudioObjectPropertyName ? device->name : device->uid, kCFStringEncodingUTF8);
+            *ioDataSize = sizeof(CFStringRef);
+            return noErr;
+        case kAudioDevicePropertyStreams:
+            if (!hasStreams(device, address->mScope, address->mElement)) {
+                *ioDataSize = 0;
+            } else {
+                if (outData != NULL) *(AudioStreamID *)outData = device->deviceID + 1000;
+                *ioDataSize = sizeof(AudioStreamID);
+            }
+            return noErr;
+        case kAudioDevicePropertyDeviceIsAlive:
+            if (outData != NULL) *(UInt32 *)outData = 1;
+            *ioDataSize = sizeof(UInt32);
+            return noErr;
+        default:
+            return kAudioHardwareUnknownPropertyError;
+    }
+}
+
+void startSimulatedHAL(unsigned int seed, double hotPlugChance, UInt32 maxNotifyDelayMicros) {
+    pthread_t thread;
+
+    randomState = seed;
+    plugChance = hotPlugChance;
+    maxDelayMicros = maxNotifyDelayMicros;
+    pthread_create(&thread, NULL, notificationThread, NULL);
+    pthread_detach(thread);
+}
+
+AudioDeviceID getSimulatedDefault(AudioObjectPropertySelector selector) {
+    bool output;
+    pthread_mutex_lock(&stateMutex);
+    AudioDeviceID *defaultDevice = getDefaultSlot(selector, &output);
+    AudioDeviceID deviceID = defaultDevice ? *defaultDevice : kAudioDeviceUnknown;
+    pthread_mutex_unlock(&stateMutex);
+    return deviceID;
+}
+
+bool isSimulatedDevice(AudioDeviceID deviceID, const char *name) {
+    pthread_mutex_lock(&stateMutex);
+    SimulatedDevice *device = findDevice(deviceID);
+    bool matches = device != NULL && strcmp(device->name, name) == 0;
+    pthread_mutex_unlock(&stateMutex);
+    return matches;
+}
+
+UInt32 getSimulatedHotPlugs(void) {
+    pthread_mutex_lock(&stateMutex);
+    UInt32 count = hotPlugs;
+    pthread_mutex_unlock(&stateMutex);
+    return count;
+}
+
+OSStatus AudioObjectGetPropertyDataSize(AudioObjectID objectID, const AudioObjectPropertyAddress *address, UInt32 qualifierSize, const void *qualifier, UInt32 *outDataSize) {
+    maybeHotPlug();
+    pthread_mutex_lock(&stateMutex);
+    *outDataSize = 0;
+    OSStatus status = getProperty(objectID, address, qualifierSize, qualifier, outDataSize, NULL);
+    pthread_mutex_unlock(&stateMutex);
+    return status;
+}
+
+OSStatus AudioObjectGetPropertyData(AudioObjectID objectID, const AudioObjectPropertyAddress *address, UInt32 qualifierSize, const void *qualifier, UInt32 *ioDataSize, void *outData) {
+    maybeHotPlug();
+    pthread_mutex_lock(&stateMutex);
+    OSStatus status = getProperty(objectID, address, qualifierSize, qualifier, ioDataSize, outData);
+    pthread_mutex_unlock(&stateMutex);
+    return status;
+}
+
+// Only the defaults are settable.  A device that is not in the list cannot
+// become the default.
+OSStatus AudioObjectSetPropertyData(AudioObjectID objectID, const AudioObjectPropertyAddress *address, UInt32 qualifierSize, const void *qualifier, UInt32 dataSize, const void *data) {
+    bool output;
+    OSStatus status = noErr;
+
+    maybeHotPlug();
+    pthread_mutex_lock(&stateMutex);
+    AudioDeviceID *defaultDevice = objectID == kAudioObjectSystemObject ? getDefaultSlot(address->mSelector, &output) : NULL;
+    if (defaultDevice == NULL) {
+        status = findDevice(objectID) || objectID == kAudioObjectSystemObject ? kAudioHardwareUnknownPropertyError : kAudioHardwareBadObjectError;
+    } else if (dataSize != sizeof(AudioDeviceID)) {
+        status = kAudioHardwareBadPropertySizeError;
+    } else {
+        SimulatedDevice *device = findDevice(*(const AudioDeviceID *)data);
+        if (device == NULL || !(output ? device->output : device->input)) {
+            status = kAudioHardwareBadDeviceError;
+        } else if (*defaultDevice != device->deviceID) {
+            *defaultDevice = device->deviceID;
+            notify(kAudioObjectSystemObject, address->mSelector);
+        }
+    }
+    pthread_mutex_unlock(&stateMutex);
+    return status;
+}
+
+Boolean AudioObjectHasProperty(AudioObjectID objectID, const AudioObjectPropertyAddress *address) {
+    UInt32 dataSize = 0;
+    return AudioObjectGetPropertyDataSize(objectID, address, 0, NULL, &dataSize) == noErr;
+}
+
+OSStatus AudioObjectIsPropertySettable(AudioObjectID objectID, const AudioObjectPropertyAddress *address, Boolean *outIsSettable) {
+    bool output;
+    maybeHotPlug();
+    *outIsSettable = objectID == kAudioObjectSystemObject && getDefaultSlot(address->mSelector, &output) != NULL;
+    return noErr;
+}
+
+OSStatus AudioObjectAddPropertyListener(AudioObjectID objectID, const AudioObjectPropertyAddress *address, AudioObjectPropertyListenerProc listener, void *clientData) {
+    OSStatus status = noErr;
+
+    pthread_mutex_lock(&listenerMutex);
+    if (listenerCount < MAX_LISTENERS) {
+        listeners[listenerCount++] = (SimulatedListener){objectID, address->mSelector, listener, clientData};
+    } else {
+        status = kAudioHardwareIllegalOperationError;
+    }
+    pthread_mutex_unlock(&listenerMutex);
+    return status;
+}
+
+OSStatus AudioObjectRemovePropertyListener(AudioObjectID objectID, const AudioObjectPropertyAddress *address, AudioObjectPropertyListenerProc listener, void *clientData) {
+    pthread_mutex_lock(&listenerMutex);
+    for (int i = 0; i < listenerCount; i++) {
+        if (listeners[i].objectID == objectID && listeners[i].selector == address->mSelector && listeners[i].proc == listener && listeners[i].clientData == clientData) {
+            listeners[i] = listeners[--listenerCount];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&listenerMutex);
+    return noErr;
+}
+
+OSStatus AudioDeviceCreateIOProcID(AudioObjectID device, AudioDeviceIOProc proc, void *clientData, AudioDeviceIOProcID *outIOProcID) {
+    return kAudioHardwareUnsupportedOperationError;
+}
+
+OSStatus AudioDeviceDestroyIOProcID(AudioObjectID device, AudioDeviceIOProcID ioProcID) {
+    return kAudioHardwareUnsupportedOperationError;
+}
+
+OSStatus AudioDeviceStart(AudioObjectID device, AudioDeviceIOProcID ioProcID) {
+    return kAudioHardwareUnsupportedOperationError;
+}
+
+OSStatus AudioDeviceStop(AudioObjectID device, AudioDeviceIOProcID ioProcID) {
+    return kAudioHardwareUnsupportedOperationError;
+}
+
+OSStatus AudioHardwareCreateAggregateDevice(CFDictionaryRef description, AudioObjectID *outDeviceID) {
+    return kAudioHardwareUnsupportedOperationError;
+}
+
+OSStatus AudioHardwareDestroyAggregateDevice(AudioObjectID deviceID) {
+    return kAudioHardwareUnsupportedOperationError;
+}
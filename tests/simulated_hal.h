@@ -0,0 +1,30 @@
+/*
+ *  simulated_hal.h
+ *  AudioSwitcher
+ *
+ *  A HAL in process for the tests, built in place of shim/core_audio.c.
+ *  It serves a small device list whose hot-pluggable devices come and go
+ *  at random between calls, and delivers property notifications late, from
+ *  a thread of its own, as coreaudiod does.
+ *
+ *  MIT License, see license.txt
+ */
+
+#ifndef SIMULATED_HAL_H
+#define SIMULATED_HAL_H
+
+#include <CoreAudio/CoreAudio.h>
+#include <stdbool.h>
+
+// Every HAL call plugs or unplugs a device first with probability
+// hotPlugChance; notifications arrive up to maxNotifyDelayMicros after the
+// change.
+void startSimulatedHAL(unsigned int seed, double hotPlugChance, UInt32 maxNotifyDelayMicros);
+
+// what the simulation itself holds, read without going through the HAL
+// calls, so it neither plugs devices nor counts as a call
+AudioDeviceID getSimulatedDefault(AudioObjectPropertySelector selector);
+bool isSimulatedDevice(AudioDeviceID deviceID, const char *name);
+UInt32 getSimulatedHotPlugs(void);
+
+#endif
@@ -0,0 +1,71 @@
+#!/bin/sh
+#
+#  startup_bench.sh
+#  AudioSwitcher
+#
+#  Runs -c and -s with --startup-profile a number of times each and sums
+#  up the time to main, the time from main to the first audio system call
+#  and the total time of each command.  -s switches the output to the
+#  device that is already current, unless another one is given, so the
+#  benchmark changes nothing.  Run by make startup-bench.
+#
+#  usage: startup_bench.sh binary [runs] [device]
+#
+#  MIT License, see license.txt
+#
+
+binary=$1
+runs=${2:-50}
+device=$3
+
+if [ ! -x "$binary" ]; then
+    echo "No executable at $binary"
+    exit 1
+fi
+if [ -z "$device" ]; then
+    device=$("$binary" -c -t output)
+fi
+
+profiles=$(mktemp)
+trap 'rm -f "$profiles"' EXIT
+
+# Prints min, median, 90th percentile, mean and max of the numbers on
+# stdin, skipping negative ones (no audio system call was made).
+summarize() {
+    sort -n | awk '
+        $1 >= 0 { value[count++] = $1; sum += $1 }
+        END {
+            if (count == 0) { printf "%10s\n", "-"; exit }
+            printf "%10.3f %10.3f %10.3f %10.3f %10.3f\n", value[0], value[int((count - 1) / 2)], value[int((count - 1) * 0.9)], sum / count, value[count - 1]
+        }'
+}
+
+bench() {
+    name=$1
+    shift
+    failed=0
+    : > "$profiles"
+
+    # one run first, so every timed one finds the binary and libraries cached
+    "$binary" "$@" -f cli > /dev/null 2>&1
+    i=0
+    while [ $i -lt "$runs" ]; do
+        "$binary" "$@" -f cli --startup-profile 2>> "$profiles" > /dev/null || failed=$((failed + 1))
+        i=$((i + 1))
+    done
+
+    printf '%s, %d runs' "$name" "$runs"
+    [ $failed -gt 0 ] && printf ' (%d exited with an error)' "$failed"
+    printf '\n%-24s %10s %10s %10s %10s %10s\n' "ms" "min" "median" "p90" "mean" "max"
+    printf '%-24s ' "time to main";           cut -d, -f1 "$profiles" | summarize
+    printf '%-24s ' "main to first HAL call"; cut -d, -f2 "$profiles" | summarize
+    printf '%-24s ' "wall time";              cut -d, -f3 "$profiles" | summarize
+    echo
+}
+
+bench "-c" -c
+if [ -n "$device" ]; then
+    bench "-s \"$device\"" -t output -s "$device"
+else
+    echo "No current output device to switch to; give one as STARTUP_DEVICE to time -s."
+fi
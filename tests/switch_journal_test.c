@@ -0,0 +1,176 @@
+/*
+ *  switch_journal_test.c
+ *  AudioSwitcher
+ *
+ *  Records several times JOURNAL_SLOTS mutes from several threads at once
+ *  into a journal under a TMPDIR of its own, then checks --history shows
+ *  exactly the last JOURNAL_SLOTS of them: each thread's latest records,
+ *  in the order that thread made them, with every field of a record coming
+ *  from the same call.  Run by make check.
+ *
+ *  MIT License, see license.txt
+ */
+
+#include "../audio_switch.h"
+#include "../switch_journal.h"
+#include "simulated_hal.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define THREADS 4
+#define RECORDS_PER_THREAD (JOURNAL_SLOTS * 3 / 2)
+#define OUTPUT_DEVICE 2
+#define INPUT_DEVICE 3
+
+// the latency of a record says who made it, and which of theirs it is
+static UInt64 encodeLatency(int thread, int record) {
+    return ((UInt64)thread * 100000 + record) * 1000000ULL;
+}
+
+static ASDeviceType threadType(int thread) {
+    return thread % 2 ? kAudioTypeInput : kAudioTypeOutput;
+}
+
+static void *recordMutes(void *context) {
+    int thread = (int)(intptr_t)context;
+    ASDeviceType type = threadType(thread);
+    AudioDeviceID deviceID = type == kAudioTypeInput ? INPUT_DEVICE : OUTPUT_DEVICE;
+
+    for (int i = 0; i < RECORDS_PER_THREAD; i++) {
+        journalMute(type, deviceID, noErr, i & 1, encodeLatency(thread, i));
+    }
+    return NULL;
+}
+
+typedef struct {
+    int lines;
+    int torn;
+    int outOfOrder;
+    int shown[THREADS + 1];         // the last is the record made first
+    int lastRecord[THREADS + 1];
+} HistoryCheck;
+
+// Prints the history to a file of its own and checks every record shown
+// there is whole and comes after the one of the same thread before it.
+static void checkHistory(HistoryCheck *check) {
+    char line[1024];
+
+    memset(check, 0, sizeof(*check));
+    for (int t = 0; t <= THREADS; t++) {
+        check->lastRecord[t] = -1;
+    }
+
+    FILE *history = tmpfile();
+    if (history == NULL) {
+        check->torn++;
+        return;
+    }
+    fflush(stdout);
+    int savedStdout = dup(STDOUT_FILENO);
+    dup2(fileno(history), STDOUT_FILENO);
+    showHistory(kAudioTypeAll, NULL, 0, kFormatCLI);
+    fflush(stdout);
+    dup2(savedStdout, STDOUT_FILENO);
+    close(savedStdout);
+    rewind(history);
+
+    // time,operation,type,old uid,new uid,pid,parent,status,muted,latency
+    while (fgets(line, sizeof(line), history) != NULL) {
+        char *fields[10];
+        int count = 0;
+        for (char *field = strtok(line, ",\n"); field != NULL && count < 10; field = strtok(NULL, ",\n")) {
+            fields[count++] = field;
+        }
+        check->lines++;
+        if (count != 10) {
+            check->torn++;
+            continue;
+        }
+
+        UInt64 latency = (UInt64)(strtod(fields[9], NULL) + 0.5);
+        int thread = (int)(latency / 100000);
+        int record = (int)(latency % 100000);
+        const char *uid = threadType(thread) == kAudioTypeInput ? "BuiltInMicrophoneDevice" : "BuiltInSpeakerDevice";
+        if (thread > THREADS || record >= RECORDS_PER_THREAD ||
+            strcmp(fields[1], "mute") != 0 || strcmp(fields[2], deviceTypeName(threadType(thread))) != 0 ||
+            strcmp(fields[3], uid) != 0 || strcmp(fields[4], uid) != 0 ||
+            atoi(fields[5]) != getpid() || strcmp(fields[7], "ok") != 0 || atoi(fields[8]) != (record & 1)) {
+            if (check->torn++ < 10) fprintf(stderr, "FAIL record mixes fields of different calls: %s,%s,%s,%s,%s,%s,%s\n", fields[1], fields[2], fields[3], fields[4], fields[7], fields[8], fields[9]);
+            continue;
+        }
+
+        // a thread's records are shown oldest first, one after another
+        if (check->lastRecord[thread] >= 0 && record != check->lastRecord[thread] + 1) {
+            if (check->outOfOrder++ < 10) fprintf(stderr, "FAIL thread %d: record %d shown after %d\n", thread, record, check->lastRecord[thread]);
+        }
+        check->lastRecord[thread] = record;
+        check->shown[thread]++;
+    }
+    fclose(history);
+}
+
+int main(void) {
+    char journalDirectory[] = "/tmp/switch_journal.XXXXXX";
+    char journalPath[sizeof(journalDirectory) + 64];
+    pthread_t threads[THREADS];
+    HistoryCheck check;
+    int failures = 0, readsWhileWriting = 0, tornWhileWriting = 0;
+
+    if (mkdtemp(journalDirectory) == NULL) {
+        printf("Could not create a directory for the journal\n");
+        return 1;
+    }
+    setenv("TMPDIR", journalDirectory, 1);
+    startSimulatedHAL(1, 0, 0);
+
+    // the first record creates the journal, so there is one to read while
+    // the threads write
+    journalMute(kAudioTypeOutput, OUTPUT_DEVICE, noErr, 0, encodeLatency(THREADS, 0));
+    for (int t = 0; t < THREADS; t++) {
+        pthread_create(&threads[t], NULL, recordMutes, (void *)(intptr_t)t);
+    }
+
+    // readers must skip records that are being written, never show them
+    // half done; what they skip makes gaps, so only tearing counts here
+    for (int i = 0; i < 20; i++) {
+        checkHistory(&check);
+        tornWhileWriting += check.torn;
+        readsWhileWriting++;
+    }
+    for (int t = 0; t < THREADS; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    checkHistory(&check);
+
+    snprintf(journalPath, sizeof(journalPath), "%s/SwitchAudioSource.journal.%u", journalDirectory, (unsigned int)getuid());
+    unlink(journalPath);
+    rmdir(journalDirectory);
+
+    if (check.lines != JOURNAL_SLOTS) {
+        printf("FAIL %d records shown, not the last %d\n", check.lines, JOURNAL_SLOTS);
+        failures++;
+    }
+    if (check.torn > 0 || tornWhileWriting > 0) {
+        printf("FAIL %d records were torn, %d of them while the threads were writing\n", check.torn + tornWhileWriting, tornWhileWriting);
+        failures++;
+    }
+    if (check.outOfOrder > 0) {
+        printf("FAIL %d records were out of order or missing\n", check.outOfOrder);
+        failures++;
+    }
+    for (int t = 0; t < THREADS; t++) {
+        // the window ends with the last record of every thread
+        if (check.shown[t] > 0 && check.lastRecord[t] != RECORDS_PER_THREAD - 1) {
+            printf("FAIL thread %d: its last record shown is %d, not %d\n", t, check.lastRecord[t], RECORDS_PER_THREAD - 1);
+            failures++;
+        }
+    }
+
+    printf("switch_journal: %s (%d threads, %d records, the last %d shown, %d reads while writing)\n", failures ? "FAILED" : "ok",
+           THREADS, THREADS * RECORDS_PER_THREAD, check.lines, readsWhileWriting);
+    return failures ? 1 : 0;
+}